@@ -0,0 +1,84 @@
+#ifndef __native_arduino_h_
+#define __native_arduino_h_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <pico.h>
+#include <pico/time.h>
+
+#include "native_hal.h"
+
+#define HIGH          1
+#define LOW           0
+
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define INPUT_PULLDOWN 3
+
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+void analogWrite(int pin, int value);
+int analogRead(int pin);
+void analogReadResolution(int bits);
+float analogReadTemp(float vref = 3.3);
+
+template<class T, class L>
+auto min(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (b < a) ? b : a;
+}
+
+template<class T, class L>
+auto max(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (a < b) ? b : a;
+}
+
+class Print {
+  public:
+    virtual ~Print() { };
+    virtual size_t write(uint8_t ch) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len);
+    size_t print(const char *str);
+    size_t print(int value, int base = 10);
+    size_t println(const char *str = "");
+    size_t println(int value, int base = 10);
+    virtual void flush(void) { };
+};
+
+class HardwareSerial : public Print {
+  public:
+    HardwareSerial(FILE *stream) : _stream(stream) { };
+    void begin(unsigned long baud) { (void)baud; };
+    void end(void) { };
+    bool setTX(int pin) { (void)pin; return true; };
+    bool setRX(int pin) { (void)pin; return true; };
+    int available(void) { return 0; };
+    int read(void) { return -1; };
+    size_t write(uint8_t ch);
+    size_t write(const uint8_t *buf, size_t len);
+    void flush(void);
+    operator bool() { return true; };
+
+  private:
+    FILE *_stream;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
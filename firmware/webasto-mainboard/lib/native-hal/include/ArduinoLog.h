@@ -0,0 +1,43 @@
+#ifndef __native_arduinolog_h_
+#define __native_arduinolog_h_
+
+#include <stdarg.h>
+#include <Arduino.h>
+
+#define LOG_LEVEL_SILENT  0
+#define LOG_LEVEL_FATAL   1
+#define LOG_LEVEL_ERROR   2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_NOTICE  4
+#define LOG_LEVEL_TRACE   5
+#define LOG_LEVEL_VERBOSE 6
+
+// Same call surface as Arduino-Log, printing one line per call through the
+// given Print.  The format is handed to vsnprintf, so only the printf subset
+// of Arduino-Log's specifiers (%d %u %x %X %s %c %l) is understood.
+class Logging {
+  public:
+    Logging(void) : _level(LOG_LEVEL_SILENT), _output(0) { };
+    void begin(int level, Print *output, bool showLevel = true);
+    void setLevel(int level) { _level = level; };
+    int getLevel(void) { return _level; };
+
+    void fatal(const char *format, ...)   __attribute__((format(printf, 2, 3)));
+    void error(const char *format, ...)   __attribute__((format(printf, 2, 3)));
+    void warning(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void notice(const char *format, ...)  __attribute__((format(printf, 2, 3)));
+    void info(const char *format, ...)    __attribute__((format(printf, 2, 3)));
+    void trace(const char *format, ...)   __attribute__((format(printf, 2, 3)));
+    void verbose(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  private:
+    void print(int level, const char *format, va_list args);
+
+    int _level;
+    Print *_output;
+    bool _showLevel;
+};
+
+extern Logging Log;
+
+#endif
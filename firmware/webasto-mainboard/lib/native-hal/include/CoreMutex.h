@@ -0,0 +1,34 @@
+#ifndef __native_coremutex_h_
+#define __native_coremutex_h_
+
+#include <pico.h>
+#include <hardware/sync.h>
+
+class CoreMutex {
+  public:
+    CoreMutex(mutex_t *mutex, uint8_t option = 0) : _mutex(mutex), _acquired(false)
+    {
+      (void)option;
+      uint32_t owner;
+      if (!mutex_try_enter(_mutex, &owner)) {
+        if (owner == get_core_num()) {
+          return;   // already ours
+        }
+        mutex_enter_blocking(_mutex);
+      }
+      _acquired = true;
+    };
+
+    ~CoreMutex(void)
+    {
+      if (_acquired) {
+        mutex_exit(_mutex);
+      }
+    };
+
+  private:
+    mutex_t *_mutex;
+    bool _acquired;
+};
+
+#endif
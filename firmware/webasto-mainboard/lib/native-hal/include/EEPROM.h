@@ -0,0 +1,49 @@
+#ifndef __native_eeprom_h_
+#define __native_eeprom_h_
+
+#include <Arduino.h>
+
+#define NATIVE_EEPROM_SIZE  4096
+
+// The RP2040 core emulates EEPROM in a flash sector;  here it is plain RAM,
+// erased (0xFF) at start-up.
+class EEPROMClass {
+  public:
+    EEPROMClass(void) { memset(_data, 0xFF, sizeof(_data)); };
+    void begin(size_t size) { _size = size < sizeof(_data) ? size : sizeof(_data); };
+    bool commit(void) { return true; };
+    bool end(void) { return true; };
+    size_t length(void) { return _size; };
+
+    uint8_t read(int addr) { return (addr >= 0 && (size_t)addr < _size) ? _data[addr] : 0; };
+    void write(int addr, uint8_t value)
+    {
+      if (addr >= 0 && (size_t)addr < _size) {
+        _data[addr] = value;
+      }
+    };
+
+    template<typename T> T &get(int addr, T &t)
+    {
+      if (addr >= 0 && addr + sizeof(T) <= _size) {
+        memcpy(&t, &_data[addr], sizeof(T));
+      }
+      return t;
+    };
+
+    template<typename T> const T &put(int addr, const T &t)
+    {
+      if (addr >= 0 && addr + sizeof(T) <= _size) {
+        memcpy(&_data[addr], &t, sizeof(T));
+      }
+      return t;
+    };
+
+  private:
+    uint8_t _data[NATIVE_EEPROM_SIZE];
+    size_t _size = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
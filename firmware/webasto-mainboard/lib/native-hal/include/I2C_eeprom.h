@@ -0,0 +1,33 @@
+#ifndef __native_i2c_eeprom_h_
+#define __native_i2c_eeprom_h_
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// RAM-backed stand-in for RobTillaart's I2C_eeprom, so the FRAM code runs
+// unchanged.  Contents start erased (0xFF) and last for the process lifetime,
+// across objects for the same address, so a fresh init_fram() reads back
+// what the last update_fram() wrote.
+class I2C_eeprom {
+  public:
+    I2C_eeprom(uint8_t deviceAddress, uint32_t deviceSize, TwoWire *wire = &Wire);
+    ~I2C_eeprom(void);
+
+    bool begin(void) { return true; };
+    bool isConnected(void) { return true; };
+    uint32_t getDeviceSize(void) { return _size; };
+
+    int writeByte(uint16_t memoryAddress, uint8_t value);
+    int writeBlock(uint16_t memoryAddress, const uint8_t *buffer, uint16_t length);
+    int setBlock(uint16_t memoryAddress, uint8_t value, uint16_t length);
+    uint8_t readByte(uint16_t memoryAddress);
+    uint16_t readBlock(uint16_t memoryAddress, uint8_t *buffer, uint16_t length);
+
+  private:
+    uint32_t clip(uint16_t memoryAddress, uint16_t length);
+
+    uint8_t *_data;
+    uint32_t _size;
+};
+
+#endif
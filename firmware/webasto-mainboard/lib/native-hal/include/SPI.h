@@ -0,0 +1,19 @@
+#ifndef __native_spi_h_
+#define __native_spi_h_
+
+#include <Arduino.h>
+
+class SPIClassRP2040 {
+  public:
+    bool setTX(int pin) { (void)pin; return true; };
+    bool setRX(int pin) { (void)pin; return true; };
+    bool setSCK(int pin) { (void)pin; return true; };
+    bool setCS(int pin) { (void)pin; return true; };
+    void begin(bool hwCS = false) { (void)hwCS; };
+    void end(void) { };
+    uint8_t transfer(uint8_t data) { (void)data; return 0xFF; };
+};
+
+extern SPIClassRP2040 SPI;
+
+#endif
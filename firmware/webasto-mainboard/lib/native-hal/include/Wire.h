@@ -0,0 +1,31 @@
+#ifndef __native_wire_h_
+#define __native_wire_h_
+
+#include <Arduino.h>
+
+// An I2C bus with nothing on it:  every address NAKs and reads float high.
+class TwoWire {
+  public:
+    bool setSDA(int pin) { (void)pin; return true; };
+    bool setSCL(int pin) { (void)pin; return true; };
+    void setClock(uint32_t freq) { (void)freq; };
+    void begin(void) { };
+    void end(void) { };
+
+    void beginTransmission(uint8_t address) { (void)address; };
+    uint8_t endTransmission(bool sendStop = true) { (void)sendStop; return 2; };
+    size_t write(uint8_t data) { (void)data; return 1; };
+    size_t write(const uint8_t *data, size_t len) { (void)data; return len; };
+    size_t requestFrom(uint8_t address, size_t len, bool sendStop = true)
+    {
+      (void)address; (void)len; (void)sendStop;
+      return 0;
+    };
+    int available(void) { return 0; };
+    int read(void) { return 0xFF; };
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __native_hardware_gpio_h_
+#define __native_hardware_gpio_h_
+
+#include <stdint.h>
+
+#define GPIO_IRQ_LEVEL_LOW  0x1u
+#define GPIO_IRQ_LEVEL_HIGH 0x2u
+#define GPIO_IRQ_EDGE_FALL  0x4u
+#define GPIO_IRQ_EDGE_RISE  0x8u
+
+// gpio_set_outover()
+#define GPIO_OVERRIDE_NORMAL  0
+#define GPIO_OVERRIDE_INVERT  1
+#define GPIO_OVERRIDE_LOW     2
+#define GPIO_OVERRIDE_HIGH    3
+
+typedef void (*irq_handler_t)(void);
+
+// No interrupts on the host.
+inline void gpio_add_raw_irq_handler(unsigned int gpio, irq_handler_t handler)
+{
+  (void)gpio; (void)handler;
+}
+
+inline uint32_t gpio_get_irq_event_mask(unsigned int gpio)
+{
+  (void)gpio;
+  return 0;
+}
+
+// Forces what the pad drives, whatever is written to the pin (native_hal.cpp)
+void gpio_set_outover(unsigned int gpio, unsigned int value);
+
+#endif
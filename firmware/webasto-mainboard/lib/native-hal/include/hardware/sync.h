@@ -0,0 +1,14 @@
+#ifndef __native_hardware_sync_h_
+#define __native_hardware_sync_h_
+
+#include <stdint.h>
+#include <atomic>
+
+uint32_t get_core_num(void);
+
+inline void __dmb(void)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+#endif
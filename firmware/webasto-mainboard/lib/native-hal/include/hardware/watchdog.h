@@ -0,0 +1,26 @@
+#ifndef __native_hardware_watchdog_h_
+#define __native_hardware_watchdog_h_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The watchdog counts against the (pretend) clock, but nothing resets the
+// host:  see native_watchdog_expired() and native_watchdog_reboot().  The
+// scratch registers survive a native_watchdog_reboot() as they do a real one.
+
+typedef struct {
+  volatile uint32_t ctrl;
+  volatile uint32_t load;
+  volatile uint32_t reason;
+  volatile uint32_t scratch[8];
+  volatile uint32_t tick;
+} watchdog_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+bool watchdog_caused_reboot(void);
+bool watchdog_enable_caused_reboot(void);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __native_hal_h_
+#define __native_hal_h_
+
+#include <stdint.h>
+
+// Controls for the host build that have no equivalent on the RP2040.
+
+#define NATIVE_PIN_COUNT  30
+
+// Clock:  by default time follows the host's steady clock.  In manual mode
+// it only moves when advanced (delay() and semaphore timeouts advance it too),
+// which lets a simulation run much faster than real time.
+void native_clock_set_manual(bool manual);
+bool native_clock_is_manual(void);
+void native_clock_advance_us(uint64_t us);
+void native_clock_set_us(uint64_t us);
+
+// Which "core" the calling thread pretends to be (defaults to 1, the core
+// that owns the FSM and GlobalTimer).
+void native_set_core_num(int core);
+
+// Pin state as last driven by the firmware, and inputs it will read back.
+int native_digital_output(int pin);
+int native_analog_output(int pin);
+bool native_pin_is_output(int pin);
+void native_set_digital_input(int pin, int value);
+void native_set_analog_input(int pin, int value);
+void native_set_internal_temp(float degC);
+
+// Watchdog:  whether it would have bitten by now, and a pretend reset that
+// marks the next boot as caused by it (scratch registers kept, pins back
+// to inputs, overrides dropped).
+bool native_watchdog_expired(void);
+void native_watchdog_reboot(void);
+
+#endif
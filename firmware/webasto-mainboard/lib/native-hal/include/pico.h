@@ -0,0 +1,24 @@
+#ifndef __native_pico_h_
+#define __native_pico_h_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+#include <mutex>
+#include <atomic>
+
+// arduino-pico's CoreMutex treats a mutex already held by the calling core as
+// acquired, so the owner is tracked by (pretend) core number, not by thread.
+typedef struct mutex_s {
+  std::mutex lock;
+  std::atomic<int> owner{-1};
+} mutex_t;
+
+void mutex_init(mutex_t *mtx);
+void mutex_enter_blocking(mutex_t *mtx);
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out);
+void mutex_exit(mutex_t *mtx);
+#endif
+
+#endif
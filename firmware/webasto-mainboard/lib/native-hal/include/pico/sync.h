@@ -0,0 +1,21 @@
+#ifndef __native_pico_sync_h_
+#define __native_pico_sync_h_
+
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+
+#include <pico.h>
+
+typedef struct semaphore_s {
+  std::mutex lock;
+  std::condition_variable cond;
+  int16_t permits;
+  int16_t max_permits;
+} semaphore_t;
+
+void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits);
+bool sem_release(semaphore_t *sem);
+bool sem_acquire_timeout_us(semaphore_t *sem, uint32_t timeout_us);
+
+#endif
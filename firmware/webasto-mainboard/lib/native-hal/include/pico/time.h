@@ -0,0 +1,45 @@
+#ifndef __native_pico_time_h_
+#define __native_pico_time_h_
+
+#include <stdint.h>
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef struct alarm_pool alarm_pool_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+inline void update_us_since_boot(absolute_time_t *t, uint64_t us)
+{
+  *t = us;
+}
+
+inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+  return t;
+}
+
+// There are no hardware alarms on the host:  the pool is never created and
+// GlobalTimer falls back to polling in tick().
+inline alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(unsigned int max_timers)
+{
+  (void)max_timers;
+  return 0;
+}
+
+inline alarm_id_t alarm_pool_add_alarm_at(alarm_pool_t *pool, absolute_time_t time, alarm_callback_t callback,
+                                          void *user_data, bool fire_if_past)
+{
+  (void)pool; (void)time; (void)callback; (void)user_data; (void)fire_if_past;
+  return -1;
+}
+
+inline bool alarm_pool_cancel_alarm(alarm_pool_t *pool, alarm_id_t id)
+{
+  (void)pool; (void)id;
+  return false;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __native_pico_util_queue_h_
+#define __native_pico_util_queue_h_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+// Same semantics as the pico-sdk queue:  fixed-size copies in and out, safe
+// from any core, with the try_ variants never blocking.
+typedef struct {
+  std::mutex lock;
+  uint8_t *data;
+  uint16_t wptr;
+  uint16_t rptr;
+  uint16_t element_size;
+  uint16_t element_count;
+} queue_t;
+
+inline void queue_init(queue_t *q, unsigned int element_size, unsigned int element_count)
+{
+  q->data = (uint8_t *)calloc(element_count + 1, element_size);
+  q->wptr = 0;
+  q->rptr = 0;
+  q->element_size = element_size;
+  q->element_count = element_count;
+}
+
+inline unsigned int queue_get_level(queue_t *q)
+{
+  std::lock_guard<std::mutex> guard(q->lock);
+  int level = q->wptr - q->rptr;
+  return level < 0 ? level + q->element_count + 1 : level;
+}
+
+inline bool queue_try_add(queue_t *q, const void *data)
+{
+  std::lock_guard<std::mutex> guard(q->lock);
+  uint16_t next = q->wptr + 1 > q->element_count ? 0 : q->wptr + 1;
+  if (next == q->rptr) {
+    return false;
+  }
+  memcpy(&q->data[q->wptr * q->element_size], data, q->element_size);
+  q->wptr = next;
+  return true;
+}
+
+inline bool queue_try_remove(queue_t *q, void *data)
+{
+  std::lock_guard<std::mutex> guard(q->lock);
+  if (q->rptr == q->wptr) {
+    return false;
+  }
+  memcpy(data, &q->data[q->rptr * q->element_size], q->element_size);
+  q->rptr = q->rptr + 1 > q->element_count ? 0 : q->rptr + 1;
+  return true;
+}
+
+#endif
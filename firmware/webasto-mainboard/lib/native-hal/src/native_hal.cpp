@@ -0,0 +1,543 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <pico/time.h>
+#include <pico/sync.h>
+#include <hardware/sync.h>
+#include <hardware/gpio.h>
+#include <hardware/watchdog.h>
+#include <ArduinoLog.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include <I2C_eeprom.h>
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#include "native_hal.h"
+
+HardwareSerial Serial(stdout);
+HardwareSerial Serial1(stderr);
+TwoWire Wire;
+TwoWire Wire1;
+SPIClassRP2040 SPI;
+EEPROMClass EEPROM;
+Logging Log;
+
+
+// Clock
+
+static std::atomic<bool> clock_manual(false);
+static std::atomic<uint64_t> clock_manual_us(0);
+static const std::chrono::steady_clock::time_point clock_epoch = std::chrono::steady_clock::now();
+
+void native_clock_set_manual(bool manual)
+{
+  if (manual && !clock_manual) {
+    clock_manual_us = time_us_64();
+  }
+  clock_manual = manual;
+}
+
+bool native_clock_is_manual(void)
+{
+  return clock_manual;
+}
+
+void native_clock_advance_us(uint64_t us)
+{
+  clock_manual_us += us;
+}
+
+void native_clock_set_us(uint64_t us)
+{
+  clock_manual_us = us;
+}
+
+uint64_t time_us_64(void)
+{
+  if (clock_manual) {
+    return clock_manual_us;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now - clock_epoch).count();
+}
+
+uint32_t time_us_32(void)
+{
+  return (uint32_t)time_us_64();
+}
+
+unsigned long millis(void)
+{
+  return (unsigned long)(time_us_64() / 1000);
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)time_us_64();
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  if (clock_manual) {
+    native_clock_advance_us(us);
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+void delay(unsigned long ms)
+{
+  if (clock_manual) {
+    native_clock_advance_us((uint64_t)ms * 1000);
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+
+// Cores
+
+static thread_local int core_num = 1;
+
+void native_set_core_num(int core)
+{
+  core_num = core;
+}
+
+uint32_t get_core_num(void)
+{
+  return core_num;
+}
+
+
+// Pins
+
+static std::atomic<int> pin_mode[NATIVE_PIN_COUNT];
+static std::atomic<int> pin_digital_out[NATIVE_PIN_COUNT];
+static std::atomic<int> pin_analog_out[NATIVE_PIN_COUNT];
+static std::atomic<int> pin_digital_in[NATIVE_PIN_COUNT];
+static std::atomic<int> pin_analog_in[NATIVE_PIN_COUNT];
+static std::atomic<int> analog_bits(10);
+static std::atomic<float> internal_temp(25.0);
+static std::atomic<int> pin_outover[NATIVE_PIN_COUNT];
+
+static inline bool pin_valid(int pin)
+{
+  return pin >= 0 && pin < NATIVE_PIN_COUNT;
+}
+
+void pinMode(int pin, int mode)
+{
+  if (pin_valid(pin)) {
+    pin_mode[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+      pin_digital_in[pin] = HIGH;
+    }
+  }
+}
+
+void digitalWrite(int pin, int value)
+{
+  if (pin_valid(pin)) {
+    pin_digital_out[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(int pin)
+{
+  if (!pin_valid(pin)) {
+    return LOW;
+  }
+
+  if (pin_mode[pin] == OUTPUT) {
+    return pin_digital_out[pin];
+  }
+  return pin_digital_in[pin];
+}
+
+void analogWrite(int pin, int value)
+{
+  if (pin_valid(pin)) {
+    pin_analog_out[pin] = value;
+  }
+}
+
+void analogReadResolution(int bits)
+{
+  analog_bits = bits;
+}
+
+// Analog inputs are set as 12-bit values and scaled to the requested resolution
+int analogRead(int pin)
+{
+  if (!pin_valid(pin)) {
+    return 0;
+  }
+
+  int bits = analog_bits;
+  int value = pin_analog_in[pin];
+  return bits >= 12 ? value << (bits - 12) : value >> (12 - bits);
+}
+
+float analogReadTemp(float vref)
+{
+  (void)vref;
+  return internal_temp;
+}
+
+void gpio_set_outover(unsigned int gpio, unsigned int value)
+{
+  if (pin_valid(gpio)) {
+    pin_outover[gpio] = value;
+  }
+}
+
+int native_digital_output(int pin)
+{
+  if (!pin_valid(pin)) {
+    return LOW;
+  }
+
+  switch (pin_outover[pin]) {
+    case GPIO_OVERRIDE_LOW:
+      return LOW;
+    case GPIO_OVERRIDE_HIGH:
+      return HIGH;
+    case GPIO_OVERRIDE_INVERT:
+      return !pin_digital_out[pin];
+    default:
+      return pin_digital_out[pin];
+  }
+}
+
+// 8-bit analogWrite() value, an override counts as 0 or 255
+int native_analog_output(int pin)
+{
+  if (!pin_valid(pin)) {
+    return 0;
+  }
+
+  switch (pin_outover[pin]) {
+    case GPIO_OVERRIDE_LOW:
+      return 0;
+    case GPIO_OVERRIDE_HIGH:
+      return 255;
+    case GPIO_OVERRIDE_INVERT:
+      return 255 - pin_analog_out[pin];
+    default:
+      return pin_analog_out[pin];
+  }
+}
+
+bool native_pin_is_output(int pin)
+{
+  return pin_valid(pin) && pin_mode[pin] == OUTPUT;
+}
+
+void native_set_digital_input(int pin, int value)
+{
+  if (pin_valid(pin)) {
+    pin_digital_in[pin] = value ? HIGH : LOW;
+  }
+}
+
+void native_set_analog_input(int pin, int value)
+{
+  if (pin_valid(pin)) {
+    pin_analog_in[pin] = value;
+  }
+}
+
+void native_set_internal_temp(float degC)
+{
+  internal_temp = degC;
+}
+
+
+// Watchdog
+
+static watchdog_hw_t watchdog_regs;
+watchdog_hw_t *watchdog_hw = &watchdog_regs;
+
+static std::atomic<bool> watchdog_enabled(false);
+static std::atomic<bool> watchdog_rebooted(false);
+static std::atomic<uint32_t> watchdog_delay_ms(0);
+static std::atomic<uint64_t> watchdog_fed_us(0);
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+  (void)pause_on_debug;
+  watchdog_delay_ms = delay_ms;
+  watchdog_fed_us = time_us_64();
+  watchdog_enabled = true;
+}
+
+void watchdog_update(void)
+{
+  watchdog_fed_us = time_us_64();
+}
+
+bool watchdog_caused_reboot(void)
+{
+  return watchdog_rebooted;
+}
+
+bool watchdog_enable_caused_reboot(void)
+{
+  return watchdog_rebooted;
+}
+
+bool native_watchdog_expired(void)
+{
+  return watchdog_enabled && time_us_64() - watchdog_fed_us >= (uint64_t)watchdog_delay_ms * 1000;
+}
+
+void native_watchdog_reboot(void)
+{
+  watchdog_enabled = false;
+  watchdog_rebooted = true;
+  for (int i = 0; i < NATIVE_PIN_COUNT; i++) {
+    pin_mode[i] = INPUT;
+    pin_outover[i] = GPIO_OVERRIDE_NORMAL;
+  }
+}
+
+
+// Mutexes and semaphores
+
+void mutex_init(mutex_t *mtx)
+{
+  mtx->owner = -1;
+}
+
+void mutex_enter_blocking(mutex_t *mtx)
+{
+  mtx->lock.lock();
+  mtx->owner = get_core_num();
+}
+
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out)
+{
+  if (mtx->lock.try_lock()) {
+    mtx->owner = get_core_num();
+    return true;
+  }
+
+  if (owner_out) {
+    *owner_out = mtx->owner;
+  }
+  return false;
+}
+
+void mutex_exit(mutex_t *mtx)
+{
+  mtx->owner = -1;
+  mtx->lock.unlock();
+}
+
+void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits)
+{
+  sem->permits = initial_permits;
+  sem->max_permits = max_permits;
+}
+
+bool sem_release(semaphore_t *sem)
+{
+  {
+    std::lock_guard<std::mutex> guard(sem->lock);
+    if (sem->permits >= sem->max_permits) {
+      return false;
+    }
+    sem->permits++;
+  }
+  sem->cond.notify_one();
+  return true;
+}
+
+// With the manual clock nothing else will ever move time forward, so a
+// timeout "passes" instantly by advancing the clock instead of blocking.
+bool sem_acquire_timeout_us(semaphore_t *sem, uint32_t timeout_us)
+{
+  std::unique_lock<std::mutex> guard(sem->lock);
+
+  if (sem->permits <= 0 && clock_manual) {
+    native_clock_advance_us(timeout_us);
+    return false;
+  }
+
+  if (!sem->cond.wait_for(guard, std::chrono::microseconds(timeout_us), [sem] { return sem->permits > 0; })) {
+    return false;
+  }
+
+  sem->permits--;
+  return true;
+}
+
+
+// Serial and logging
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+  size_t count = 0;
+  while (len--) {
+    count += write(*buf++);
+  }
+  return count;
+}
+
+size_t Print::print(const char *str)
+{
+  return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::print(int value, int base)
+{
+  char buf[34];
+  snprintf(buf, sizeof(buf), base == 16 ? "%X" : "%d", value);
+  return print(buf);
+}
+
+size_t Print::println(const char *str)
+{
+  return print(str) + print("\n");
+}
+
+size_t Print::println(int value, int base)
+{
+  return print(value, base) + print("\n");
+}
+
+size_t HardwareSerial::write(uint8_t ch)
+{
+  return fputc(ch, _stream) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len)
+{
+  return fwrite(buf, 1, len, _stream);
+}
+
+void HardwareSerial::flush(void)
+{
+  fflush(_stream);
+}
+
+void Logging::begin(int level, Print *output, bool showLevel)
+{
+  _level = level;
+  _output = output;
+  _showLevel = showLevel;
+}
+
+void Logging::print(int level, const char *format, va_list args)
+{
+  static const char level_chars[] = "SFEWNTV";
+  char buf[256];
+
+  if (!_output || level > _level) {
+    return;
+  }
+
+  int len = 0;
+  if (_showLevel) {
+    len = snprintf(buf, sizeof(buf), "%c: ", level_chars[level]);
+  }
+  vsnprintf(&buf[len], sizeof(buf) - len, format, args);
+  _output->println(buf);
+}
+
+#define LOGGING_LEVEL_FUNCTION(name, level) \
+  void Logging::name(const char *format, ...) \
+  { \
+    va_list args; \
+    va_start(args, format); \
+    print(level, format, args); \
+    va_end(args); \
+  }
+
+LOGGING_LEVEL_FUNCTION(fatal, LOG_LEVEL_FATAL)
+LOGGING_LEVEL_FUNCTION(error, LOG_LEVEL_ERROR)
+LOGGING_LEVEL_FUNCTION(warning, LOG_LEVEL_WARNING)
+LOGGING_LEVEL_FUNCTION(notice, LOG_LEVEL_NOTICE)
+LOGGING_LEVEL_FUNCTION(info, LOG_LEVEL_NOTICE)
+LOGGING_LEVEL_FUNCTION(trace, LOG_LEVEL_TRACE)
+LOGGING_LEVEL_FUNCTION(verbose, LOG_LEVEL_VERBOSE)
+
+
+// I2C EEPROM / FRAM
+
+// Like the real part, the contents outlast the object:  one store per
+// device address, erased (0xFF) the first time it is seen
+static uint8_t *eeprom_store[128];
+static uint32_t eeprom_store_size[128];
+
+I2C_eeprom::I2C_eeprom(uint8_t deviceAddress, uint32_t deviceSize, TwoWire *wire)
+{
+  (void)wire;
+  uint8_t address = deviceAddress & 0x7F;
+
+  if (!eeprom_store[address]) {
+    eeprom_store[address] = new uint8_t[deviceSize];
+    eeprom_store_size[address] = deviceSize;
+    memset(eeprom_store[address], 0xFF, deviceSize);
+  }
+
+  _data = eeprom_store[address];
+  _size = min(deviceSize, eeprom_store_size[address]);
+}
+
+I2C_eeprom::~I2C_eeprom(void)
+{
+}
+
+uint32_t I2C_eeprom::clip(uint16_t memoryAddress, uint16_t length)
+{
+  if (memoryAddress >= _size) {
+    return 0;
+  }
+  return min((uint32_t)length, _size - memoryAddress);
+}
+
+int I2C_eeprom::writeByte(uint16_t memoryAddress, uint8_t value)
+{
+  return writeBlock(memoryAddress, &value, 1);
+}
+
+// Like the real library, returns 0 on success
+int I2C_eeprom::writeBlock(uint16_t memoryAddress, const uint8_t *buffer, uint16_t length)
+{
+  uint32_t len = clip(memoryAddress, length);
+  if (len) {
+    memcpy(&_data[memoryAddress], buffer, len);
+  }
+  return 0;
+}
+
+int I2C_eeprom::setBlock(uint16_t memoryAddress, uint8_t value, uint16_t length)
+{
+  uint32_t len = clip(memoryAddress, length);
+  if (len) {
+    memset(&_data[memoryAddress], value, len);
+  }
+  return 0;
+}
+
+uint8_t I2C_eeprom::readByte(uint16_t memoryAddress)
+{
+  uint8_t value = 0;
+  readBlock(memoryAddress, &value, 1);
+  return value;
+}
+
+uint16_t I2C_eeprom::readBlock(uint16_t memoryAddress, uint8_t *buffer, uint16_t length)
+{
+  uint32_t len = clip(memoryAddress, length);
+  if (len) {
+    memcpy(buffer, &_data[memoryAddress], len);
+  }
+  return len;
+}
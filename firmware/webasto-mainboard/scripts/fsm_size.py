@@ -0,0 +1,70 @@
+# Reports the code size of the FSM after a build, to compare the tinyfsm and
+# table (FSM_TABLE_ENGINE) engines.  fsm.cpp holds the states, their vtables
+# or tables and the dispatches made from inside the FSM, fsm_queue.cpp the
+# dispatches made from outside it.
+#
+# As a PlatformIO post: script it runs after the program is linked.  It can
+# also be run by hand:  fsm_size.py <size tool> <object>...
+
+import os
+import subprocess
+import sys
+
+OBJECTS = ["fsm.cpp.o", "fsm_queue.cpp.o"]
+
+
+# Section name prefixes, in the order they are reported.  Unwind tables and
+# the like are left out:  they depend on the toolchain more than the engine.
+SECTIONS = [
+    ("code", (".text",)),
+    ("const", (".rodata", ".data.rel.ro")),
+    ("data", (".data",)),
+    ("bss", (".bss",)),
+]
+
+
+def section_sizes(size_tool, path):
+    # System V format:  one "name size addr" line per section
+    output = subprocess.check_output([size_tool, "-A", "-d", path], universal_newlines=True)
+    sizes = [0] * len(SECTIONS)
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) != 3 or not fields[1].isdigit():
+            continue
+        for i, (_, prefixes) in enumerate(SECTIONS):
+            if fields[0].startswith(prefixes):
+                sizes[i] += int(fields[1])
+                break
+    return sizes
+
+
+def report(size_tool, paths, engine):
+    total = [0] * len(SECTIONS)
+    print("fsm_size: %s engine" % engine)
+    for path in paths:
+        sizes = section_sizes(size_tool, path)
+        total = [a + b for a, b in zip(total, sizes)]
+        print("  %-16s %s" % (os.path.basename(path), format_sizes(sizes)))
+    print("  %-16s %s" % ("total", format_sizes(total)))
+
+
+def format_sizes(sizes):
+    return "  ".join("%s %6d" % (name, size) for (name, _), size in zip(SECTIONS, sizes))
+
+
+def post_build(source, target, env):
+    obj_dir = os.path.join(env.subst("$BUILD_DIR"), "src")
+    size_tool = env.subst("$SIZETOOL") or "size"
+    defines = [d if isinstance(d, str) else d[0] for d in env.get("CPPDEFINES", [])]
+    engine = "table" if "FSM_TABLE_ENGINE" in defines else "tinyfsm"
+    report(size_tool, [os.path.join(obj_dir, name) for name in OBJECTS], engine)
+
+
+try:
+    Import("env")
+    env.AddPostAction("$PROGPATH", post_build)
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) < 3:
+            sys.exit("usage: fsm_size.py <size tool> <object>...")
+        report(sys.argv[1], sys.argv[2:], "given")
@@ -0,0 +1,98 @@
+# Builds the token table for LOG_TOKENIZED builds:  every LOG_*() format
+# string in src/, keyed by the same FNV-1a hash log_token() computes at
+# compile time.  One line per token:
+#
+#   token<TAB>level<TAB>file:line<TAB>format (C escapes kept)
+#
+# As a PlatformIO pre: script it writes $BUILD_DIR/log_tokens.txt.  It can
+# also be run by hand:  log_tokens.py <src dir> <output file>
+
+import os
+import re
+import sys
+
+LOG_CALL = re.compile(r'\bLOG_(FATAL|ERROR|WARNING|NOTICE|TRACE|VERBOSE)\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+
+LEVELS = {
+    "FATAL": 1,
+    "ERROR": 2,
+    "WARNING": 3,
+    "NOTICE": 4,
+    "TRACE": 5,
+    "VERBOSE": 6,
+}
+
+ESCAPES = {
+    "n": "\n", "t": "\t", "r": "\r", "0": "\0",
+    "\\": "\\", "\"": "\"", "'": "'",
+}
+
+
+def unescape(text):
+    out = ""
+    i = 0
+    while i < len(text):
+        if text[i] == "\\" and i + 1 < len(text):
+            if text[i + 1] == "x":
+                match = re.match(r"[0-9a-fA-F]+", text[i + 2:])
+                out += chr(int(match.group(0), 16))
+                i += 2 + len(match.group(0))
+                continue
+            out += ESCAPES.get(text[i + 1], text[i + 1])
+            i += 2
+        else:
+            out += text[i]
+            i += 1
+    return out
+
+
+def log_token(text):
+    token = 2166136261
+    for byte in text.encode("utf-8"):
+        token = ((token ^ byte) * 16777619) & 0xFFFFFFFF
+    return token
+
+
+def scan(src_dir):
+    tokens = {}
+    for name in sorted(os.listdir(src_dir)):
+        if not name.endswith((".cpp", ".h")):
+            continue
+
+        with open(os.path.join(src_dir, name), encoding="utf-8") as f:
+            source = f.read()
+
+        for match in LOG_CALL.finditer(source):
+            escaped = "".join(LITERAL.findall(match.group(2)))
+            token = log_token(unescape(escaped))
+            line = source.count("\n", 0, match.start()) + 1
+            entry = (LEVELS[match.group(1)], "%s:%d" % (name, line), escaped)
+
+            if token == 0:
+                raise ValueError("%s: format hashes to 0, reserved for hexdumps" % entry[1])
+
+            if token in tokens and tokens[token][2] != escaped:
+                raise ValueError("%s: token %08x collides with %s" % (entry[1], token, tokens[token][1]))
+
+            tokens.setdefault(token, entry)
+    return tokens
+
+
+def write_table(src_dir, output):
+    tokens = scan(src_dir)
+    os.makedirs(os.path.dirname(os.path.abspath(output)), exist_ok=True)
+    with open(output, "w", encoding="utf-8") as f:
+        for token, (level, where, escaped) in sorted(tokens.items()):
+            f.write("%08x\t%d\t%s\t%s\n" % (token, level, where, escaped))
+    print("log_tokens: %d formats -> %s" % (len(tokens), output))
+
+
+try:
+    Import("env")
+    write_table(env.subst("$PROJECT_SRC_DIR"), os.path.join(env.subst("$BUILD_DIR"), "log_tokens.txt"))
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) != 3:
+            sys.exit("usage: log_tokens.py <src dir> <output file>")
+        write_table(sys.argv[1], sys.argv[2])
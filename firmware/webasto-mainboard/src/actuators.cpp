@@ -0,0 +1,192 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <ArduinoLog.h>
+#include <CoreMutex.h>
+#include <canbus_ids.h>
+
+#include "project.h"
+#include "actuators.h"
+#include "fsm.h"
+#include "fuel_pump.h"
+#include "sensor_registry.h"
+#include "flight_recorder.h"
+#include "latency_probe.h"
+#include "async_log.h"
+
+const actuator_outputs_t actuators_off = { 0, 0, 0, 0, false, false, false };
+
+actuator_outputs_t actuators_current(void)
+{
+  CoreMutex m(&fsm_mutex);
+
+  actuator_outputs_t outputs;
+  outputs.combustion_fan = combustionFanPercent;
+  outputs.vehicle_fan = vehicleFanPercent;
+  outputs.glow_plug = glowPlugPercent;
+  outputs.fuel_need = fuelNeedRequested;
+  outputs.circulation_pump = circulationPumpOn;
+  outputs.glow_plug_in_enable = glowPlugInEnable;
+  outputs.glow_plug_out_enable = glowPlugOutEnable;
+  return outputs;
+}
+
+// Clamp everything into range and sort out the glow plug enables
+static void actuators_normalize(actuator_outputs_t *outputs)
+{
+  outputs->combustion_fan = clamp<int>(outputs->combustion_fan, 0, 100);
+  outputs->vehicle_fan = clamp<int>(outputs->vehicle_fan, 0, 100);
+  outputs->glow_plug = clamp<int>(outputs->glow_plug, 0, 100);
+
+  if (outputs->fuel_need <= 0) {
+    outputs->fuel_need = 0;
+  } else if (priming) {
+    outputs->fuel_need = clamp<int>(outputs->fuel_need, MIN_FUEL_NEED, MAX_FUEL_NEED_PRIMING);
+  } else {
+    outputs->fuel_need = clamp<int>(outputs->fuel_need, MIN_FUEL_NEED, MAX_FUEL_NEED_BURNING);
+  }
+
+  if (outputs->glow_plug_in_enable && outputs->glow_plug_out_enable) {
+    bool in_new = !glowPlugInEnable;
+    bool out_new = !glowPlugOutEnable;
+
+    if (in_new == out_new) {
+      LOG_WARNING("Glow plug in and out both requested, turning both off");
+      outputs->glow_plug_in_enable = false;
+      outputs->glow_plug_out_enable = false;
+    } else {
+      outputs->glow_plug_in_enable = in_new;
+      outputs->glow_plug_out_enable = out_new;
+    }
+  }
+
+  if (!outputs->glow_plug_out_enable) {
+    outputs->glow_plug = 0;
+  }
+}
+
+static void actuators_write_fuel(int fuel_need)
+{
+  fuelNeedRequested = fuel_need;
+  fuelPumpTimer.setFuelNeed(fuelNeedRequested);
+  latency_probe_output();
+  flight_recorder_output(FLIGHT_OUTPUT_FUEL_PUMP, fuelNeedRequested);
+}
+
+static void actuators_write(const actuator_outputs_t *request, bool force)
+{
+  CoreMutex m(&fsm_mutex);
+
+  actuator_outputs_t want = *request;
+  actuators_normalize(&want);
+
+  bool in_changed = force || want.glow_plug_in_enable != glowPlugInEnable;
+  bool out_changed = force || want.glow_plug_out_enable != glowPlugOutEnable;
+  bool fan_changed = force || want.combustion_fan != combustionFanPercent;
+  bool fuel_changed = force || want.fuel_need != fuelNeedRequested;
+  bool glow_changed = force || want.glow_plug != glowPlugPercent;
+  bool pump_changed = force || want.circulation_pump != circulationPumpOn;
+  bool vehicle_fan_changed = force || want.vehicle_fan != vehicleFanPercent;
+
+  if (!(in_changed || out_changed || fan_changed || fuel_changed || glow_changed || pump_changed ||
+        vehicle_fan_changed)) {
+    return;
+  }
+
+  // Pump and both enables as bits 0-2, the async log only takes 6 arguments
+  int switches = want.circulation_pump | (want.glow_plug_in_enable << 1) | (want.glow_plug_out_enable << 2);
+  LOG_NOTICE("Outputs: CF %d%%, fuel %d, glow %d%%, VF %d%%, switches %X", want.combustion_fan, want.fuel_need,
+             want.glow_plug, want.vehicle_fan, switches);
+
+  // Enables going off
+  if (in_changed && !want.glow_plug_in_enable) {
+    glowPlugInEnable = false;
+    set_open_drain_pin(PIN_GLOW_PLUG_IN_EN, glowPlugInEnable);
+  }
+
+  if (out_changed && !want.glow_plug_out_enable) {
+    glowPlugOutEnable = false;
+    set_open_drain_pin(PIN_GLOW_PLUG_OUT_EN, glowPlugOutEnable);
+  }
+
+  // Less fuel before less air
+  bool fuel_first = fuel_changed && want.fuel_need <= fuelNeedRequested;
+  if (fuel_first) {
+    actuators_write_fuel(want.fuel_need);
+  }
+
+  if (glow_changed) {
+    glowPlugPercent = want.glow_plug;
+    analogWrite(PIN_GLOW_PLUG_OUT, glowPlugPercent * 255 / 100);
+    latency_probe_output();
+    flight_recorder_output(FLIGHT_OUTPUT_GLOW_PLUG, glowPlugPercent);
+  }
+
+  if (fan_changed) {
+    combustionFanPercent = want.combustion_fan;
+    analogWrite(PIN_COMBUSTION_FAN, combustionFanPercent * 255 / 100);
+    latency_probe_output();
+    flight_recorder_output(FLIGHT_OUTPUT_COMBUSTION_FAN, combustionFanPercent);
+  }
+
+  if (fuel_changed && !fuel_first) {
+    actuators_write_fuel(want.fuel_need);
+  }
+
+  if (pump_changed) {
+    circulationPumpOn = want.circulation_pump;
+    digitalWrite(PIN_CIRCULATION_PUMP, circulationPumpOn);
+    latency_probe_output();
+    flight_recorder_output(FLIGHT_OUTPUT_CIRCULATION_PUMP, circulationPumpOn);
+  }
+
+  if (vehicle_fan_changed) {
+    vehicleFanPercent = want.vehicle_fan;
+    RemoteLINBusSensor *vehicleFanActuator = sensorRegistry.get<RemoteLINBusSensor>(CANBUS_ID_VEHICLE_FAN_PERCENT);
+    vehicleFanActuator->send_control_value(vehicleFanPercent, 1);
+    latency_probe_output();
+    flight_recorder_output(FLIGHT_OUTPUT_VEHICLE_FAN, vehicleFanPercent);
+  }
+
+  // Enables coming on, both off by now
+  if (in_changed && want.glow_plug_in_enable) {
+    glowPlugInEnable = true;
+    set_open_drain_pin(PIN_GLOW_PLUG_IN_EN, glowPlugInEnable);
+  }
+
+  if (out_changed && want.glow_plug_out_enable) {
+    glowPlugOutEnable = true;
+    set_open_drain_pin(PIN_GLOW_PLUG_OUT_EN, glowPlugOutEnable);
+  }
+
+  if (in_changed || out_changed) {
+    // The flame LED shows the flame sensor is on
+    flameLed = glowPlugInEnable;
+    digitalWrite(PIN_FLAME_LED, flameLed);
+
+    flight_recorder_output(FLIGHT_OUTPUT_GLOW_PLUG_IN_EN, glowPlugInEnable);
+    flight_recorder_output(FLIGHT_OUTPUT_GLOW_PLUG_OUT_EN, glowPlugOutEnable);
+  }
+}
+
+void actuators_apply(const actuator_outputs_t *outputs)
+{
+  actuators_write(outputs, false);
+}
+
+void actuators_force_off(void)
+{
+  actuators_write(&actuators_off, true);
+}
+
+void init_actuators(void)
+{
+  // The enables are open drain outputs.  default is off = input with pullup
+  pinMode(PIN_GLOW_PLUG_IN_EN, INPUT);
+  pinMode(PIN_GLOW_PLUG_OUT_EN, INPUT);
+  pinMode(PIN_CIRCULATION_PUMP, OUTPUT);
+  pinMode(PIN_COMBUSTION_FAN, OUTPUT);
+  pinMode(PIN_GLOW_PLUG_OUT, OUTPUT);
+  // Fuel pump setup is in the FuelPumpTimer class
+
+  actuators_force_off();
+}
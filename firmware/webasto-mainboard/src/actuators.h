@@ -0,0 +1,44 @@
+#ifndef __actuators_h_
+#define __actuators_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// Every output the FSM drives, as one vector.  A state sets the whole lot
+// in one go:  start from actuators_current(), change what it needs and hand
+// it to actuators_apply(), which works out what actually changed and writes
+// only that, under one fsm_mutex hold.
+//
+// The glow plug in (flame sensing) and out (heating) enables must never
+// both be on.  A vector asking for both keeps whichever one is newly being
+// turned on, or neither if both are.  The glow plug PWM is zeroed whenever
+// the out enable is off.
+//
+// Writes go off before on:  enables being dropped first, fuel before the
+// fan when the fuel is coming down and after it when going up, enables
+// being raised last.  The current values live in the existing globals
+// (combustionFanPercent and friends, fsm.h).
+
+typedef struct {
+  int combustion_fan;         // percent
+  int vehicle_fan;            // percent
+  int glow_plug;              // percent, 0 unless glow_plug_out_enable
+  int fuel_need;              // fuel need * 100, 0 is off
+  bool circulation_pump;
+  bool glow_plug_in_enable;
+  bool glow_plug_out_enable;
+} actuator_outputs_t;
+
+// Everything off
+extern const actuator_outputs_t actuators_off;
+
+actuator_outputs_t actuators_current(void);
+void actuators_apply(const actuator_outputs_t *outputs);
+
+// Everything off, every output written whether it changed or not
+void actuators_force_off(void);
+
+// Pin setup, then actuators_force_off()
+void init_actuators(void);
+
+#endif
@@ -0,0 +1,401 @@
+#include <Beirdo-Utilities.h>
+
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <pico.h>
+#include <pico/time.h>
+#include <hardware/sync.h>
+
+#include "async_log.h"
+
+#define LOG_LINE_SIZE       128
+#define LOG_HEXDUMP_WIDTH   16
+
+// Worst case frame:  header, token, types, six 5-byte varints and a string
+// area's worth of lengths and bytes.  Plus COBS overhead and the delimiter.
+#define LOG_FRAME_SIZE      (1 + 4 + 2 + 5 * LOG_MAX_ARGS + LOG_MAX_ARGS + LOG_DATA_SIZE)
+#define LOG_COBS_SIZE       (LOG_FRAME_SIZE + LOG_FRAME_SIZE / 254 + 2)
+
+AsyncLog asyncLog;
+
+AsyncLog::AsyncLog(void)
+{
+  for (int i = 0; i < LOG_CORE_COUNT; i++) {
+    _head[i] = 0;
+    _tail[i] = 0;
+    _dropped[i] = 0;
+  }
+  _dropped_reported = 0;
+  _output = 0;
+}
+
+logRecord_t *AsyncLog::begin_record(int level)
+{
+  if (level > Log.getLevel()) {
+    return 0;
+  }
+
+  // Producer side, one per core.  Never blocks:  a full ring drops the
+  // message, unless we are the core that drains it anyways.
+  int core = get_core_num();
+  uint32_t head = _head[core];
+
+  if (head - _tail[core] >= LOG_RING_SIZE && core == LOG_DRAIN_CORE) {
+    drain();
+  }
+
+  if (head - _tail[core] >= LOG_RING_SIZE) {
+    _dropped[core]++;
+    return 0;
+  }
+
+  logRecord_t *record = &_records[core][head & (LOG_RING_SIZE - 1)];
+  record->stamp_us = time_us_32();
+  record->level = level;
+  record->count = 0;
+  record->data_len = 0;
+  return record;
+}
+
+void AsyncLog::commit_record(void)
+{
+  int core = get_core_num();
+
+  __dmb();
+  _head[core] = _head[core] + 1;
+}
+
+void AsyncLog::pack(logRecord_t *record, const char *value)
+{
+  if (record->count >= LOG_MAX_ARGS) {
+    return;
+  }
+
+  if (!value) {
+    value = "(null)";
+  }
+
+  // Strings share the data area.  Once it is full, later strings point at
+  // the terminator of the last one and print empty.
+  int space = LOG_DATA_SIZE - record->data_len;
+  int offset = LOG_DATA_SIZE - 1;
+
+  if (space > 0) {
+    int len = min((int)strlen(value), space - 1);
+    offset = record->data_len;
+    memcpy(&record->data[offset], value, len);
+    record->data[offset + len] = '\0';
+    record->data_len += len + 1;
+  }
+
+  record->types[record->count] = LOG_ARG_STRING;
+  record->args[record->count++].str = offset;
+}
+
+void AsyncLog::hexdump(int level, const uint8_t *buf, int len)
+{
+  for (int offset = 0; offset < len; offset += LOG_DATA_SIZE) {
+    logRecord_t *record = begin_record(level);
+    if (!record) {
+      return;
+    }
+
+    int count = min(len - offset, LOG_DATA_SIZE);
+    record->format = 0;
+    record->count = count;
+    record->args[0].i = offset;
+    memcpy(record->data, &buf[offset], count);
+    commit_record();
+  }
+}
+
+uint32_t AsyncLog::dropped(void)
+{
+  uint32_t total = 0;
+  for (int i = 0; i < LOG_CORE_COUNT; i++) {
+    total += _dropped[i];
+  }
+  return total;
+}
+
+#ifndef LOG_TOKENIZED
+// printf semantics, with each conversion applied to the next stored argument.
+// Length modifiers are ignored, as every integer was stored as 32 bits.
+void AsyncLog::format_record(logRecord_t *record, char *buf, int size)
+{
+  int pos = 0;
+  int arg = 0;
+
+  for (const char *p = record->format; *p && pos < size - 1; p++) {
+    if (*p != '%') {
+      buf[pos++] = *p;
+      continue;
+    }
+
+    if (p[1] == '%') {
+      buf[pos++] = '%';
+      p++;
+      continue;
+    }
+
+    char spec[16];
+    int len = 0;
+    spec[len++] = '%';
+
+    const char *q = p + 1;
+    while (*q && strchr("-+ #0123456789.", *q)) {
+      if (len < (int)sizeof(spec) - 2) {
+        spec[len++] = *q;
+      }
+      q++;
+    }
+
+    while (*q && strchr("hlLqjzt", *q)) {
+      q++;
+    }
+
+    char conv = *q;
+    if (!conv) {
+      break;
+    }
+
+    spec[len++] = conv;
+    spec[len] = '\0';
+    p = q;
+
+    bool is_float = strchr("fFeEgGaA", conv);
+    bool is_string = (conv == 's');
+    int remain = size - pos;
+    int count;
+
+    if (arg >= record->count) {
+      count = snprintf(&buf[pos], remain, "?");
+    } else {
+      switch (record->types[arg]) {
+        case LOG_ARG_FLOAT:
+          if (is_float) {
+            count = snprintf(&buf[pos], remain, spec, (double)record->args[arg].f);
+          } else {
+            count = snprintf(&buf[pos], remain, "%d", (int)record->args[arg].f);
+          }
+          break;
+        case LOG_ARG_STRING:
+          count = snprintf(&buf[pos], remain, is_string ? spec : "%s", &record->data[record->args[arg].str]);
+          break;
+        case LOG_ARG_INT:
+        default:
+          if (is_float) {
+            count = snprintf(&buf[pos], remain, spec, (double)record->args[arg].i);
+          } else if (is_string) {
+            count = snprintf(&buf[pos], remain, "%d", (int)record->args[arg].i);
+          } else {
+            count = snprintf(&buf[pos], remain, spec, record->args[arg].i);
+          }
+          break;
+      }
+      arg++;
+    }
+
+    pos += clamp<int>(count, 0, remain - 1);
+  }
+
+  buf[pos] = '\0';
+}
+
+static void log_print_line(int level, const char *line)
+{
+  switch (level) {
+    case LOG_LEVEL_FATAL:
+      Log.fatal("%s", line);
+      break;
+    case LOG_LEVEL_ERROR:
+      Log.error("%s", line);
+      break;
+    case LOG_LEVEL_WARNING:
+      Log.warning("%s", line);
+      break;
+    case LOG_LEVEL_NOTICE:
+      Log.notice("%s", line);
+      break;
+    case LOG_LEVEL_TRACE:
+      Log.trace("%s", line);
+      break;
+    case LOG_LEVEL_VERBOSE:
+    default:
+      Log.verbose("%s", line);
+      break;
+  }
+}
+
+void AsyncLog::print_record(logRecord_t *record)
+{
+  char line[LOG_LINE_SIZE];
+
+  if (record->format) {
+    format_record(record, line, sizeof(line));
+    log_print_line(record->level, line);
+    return;
+  }
+
+  for (int i = 0; i < record->count; i += LOG_HEXDUMP_WIDTH) {
+    int pos = snprintf(line, sizeof(line), "%04X:", (unsigned)(record->args[0].i + i));
+    int count = min(record->count - i, LOG_HEXDUMP_WIDTH);
+
+    for (int j = 0; j < count; j++) {
+      pos += snprintf(&line[pos], sizeof(line) - pos, " %02X", (uint8_t)record->data[i + j]);
+    }
+    log_print_line(record->level, line);
+  }
+}
+
+#else
+
+static int log_put_varint(uint8_t *buf, int pos, uint32_t value)
+{
+  while (value >= 0x80) {
+    buf[pos++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  buf[pos++] = value;
+  return pos;
+}
+
+static int log_put_u32(uint8_t *buf, int pos, uint32_t value)
+{
+  for (int i = 0; i < 4; i++) {
+    buf[pos++] = value >> (8 * i);
+  }
+  return pos;
+}
+
+void AsyncLog::print_record(logRecord_t *record)
+{
+  uint8_t frame[LOG_FRAME_SIZE];
+  int pos = 0;
+
+  if (!record->format) {
+    frame[pos++] = record->level;
+    pos = log_put_u32(frame, pos, 0);
+    pos = log_put_varint(frame, pos, record->args[0].i);
+    memcpy(&frame[pos], record->data, record->count);
+    write_frame(frame, pos + record->count);
+    return;
+  }
+
+  frame[pos++] = record->level | (record->count << 3);
+  pos = log_put_u32(frame, pos, record->format);
+
+  for (int i = 0; i < record->count; i += 4) {
+    uint8_t types = 0;
+    for (int j = i; j < i + 4 && j < record->count; j++) {
+      types |= record->types[j] << (2 * (j - i));
+    }
+    frame[pos++] = types;
+  }
+
+  for (int i = 0; i < record->count; i++) {
+    switch (record->types[i]) {
+      case LOG_ARG_FLOAT:
+        {
+          uint32_t bits;
+          memcpy(&bits, &record->args[i].f, sizeof(bits));
+          pos = log_put_u32(frame, pos, bits);
+        }
+        break;
+      case LOG_ARG_STRING:
+        {
+          const char *str = &record->data[record->args[i].str];
+          int len = strlen(str);
+          pos = log_put_varint(frame, pos, len);
+          memcpy(&frame[pos], str, len);
+          pos += len;
+        }
+        break;
+      case LOG_ARG_INT:
+      default:
+        {
+          int32_t value = record->args[i].i;
+          pos = log_put_varint(frame, pos, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+        }
+        break;
+    }
+  }
+
+  write_frame(frame, pos);
+}
+
+// COBS, so a reader can always find the next frame after a 0x00
+void AsyncLog::write_frame(uint8_t *frame, int len)
+{
+  uint8_t buf[LOG_COBS_SIZE];
+  int code_pos = 0;
+  int pos = 1;
+  uint8_t code = 1;
+
+  for (int i = 0; i < len; i++) {
+    if (frame[i]) {
+      buf[pos++] = frame[i];
+      code++;
+    }
+
+    if (!frame[i] || code == 0xFF) {
+      buf[code_pos] = code;
+      code_pos = pos++;
+      code = 1;
+    }
+  }
+
+  buf[code_pos] = code;
+  buf[pos++] = 0x00;
+
+  if (_output) {
+    _output->write(buf, pos);
+  }
+}
+#endif
+
+void AsyncLog::drain(void)
+{
+  // Consumer side.  Oldest message first across the cores, and no more than
+  // what could have been queued when we started, so a chatty core can't keep
+  // us here.
+  for (int n = 0; n < LOG_CORE_COUNT * LOG_RING_SIZE; n++) {
+    logRecord_t *oldest = 0;
+    int oldest_core = -1;
+
+    for (int core = 0; core < LOG_CORE_COUNT; core++) {
+      uint32_t tail = _tail[core];
+      if (tail == _head[core]) {
+        continue;
+      }
+
+      __dmb();
+      logRecord_t *record = &_records[core][tail & (LOG_RING_SIZE - 1)];
+      if (!oldest || (int32_t)(record->stamp_us - oldest->stamp_us) < 0) {
+        oldest = record;
+        oldest_core = core;
+      }
+    }
+
+    if (!oldest) {
+      break;
+    }
+
+    print_record(oldest);
+    __dmb();
+    _tail[oldest_core] = _tail[oldest_core] + 1;
+  }
+
+  // Queued like any other message, for the next time around
+  uint32_t total = dropped();
+  if (total != _dropped_reported) {
+    int count = total - _dropped_reported;
+    _dropped_reported = total;
+    LOG_WARNING("Log ring full, dropped %d messages", count);
+  }
+}
+
+void update_async_log(void)
+{
+  asyncLog.drain();
+}
@@ -0,0 +1,185 @@
+#ifndef __async_log_h_
+#define __async_log_h_
+
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <hardware/sync.h>
+
+#include <type_traits>
+
+// Deferred logging.  A LOG_*() call copies the format pointer and the raw
+// arguments into a lock-free ring owned by the calling core and returns;
+// update_async_log() on core0 does the formatting and the serial output.  This
+// keeps printf and 115200 baud out of FSM reactions and mutex-held sections.
+//
+// Only the format pointer is kept, so it must be a string literal.  %s
+// arguments are copied (up to LOG_DATA_SIZE bytes per message, shared).  Do
+// not log from interrupt handlers:  each ring has one producer per core.
+//
+// Messages above LOG_COMPILE_LEVEL are compiled out entirely.  Below it,
+// Log's runtime level is still checked before anything is queued.
+//
+// With LOG_TOKENIZED, format strings are not compiled in at all:  each one is
+// replaced by its 32-bit FNV-1a hash, and the drain writes binary frames to
+// the output given to begin() instead of text.  scripts/log_tokens.py builds
+// the token table at build time, and tools/log_decode turns a capture back
+// into text.  Each frame, before COBS encoding and the 0x00 delimiter, is:
+//
+//   level | count << 3     1 byte
+//   token                 4 bytes, little endian (0 for a hexdump)
+//   argument types        2 bits each, first in the low bits, ceil(count / 4) bytes
+//   arguments             int:  zigzag varint, float:  4 bytes LE,
+//                         string:  varint length and the bytes
+//
+// A hexdump has count 0, and carries a varint offset and the raw bytes.
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_VERBOSE
+#endif
+
+// Messages per core (power of 2)
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE   32
+#endif
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+
+#define LOG_MAX_ARGS    6
+#define LOG_DATA_SIZE   32
+#define LOG_CORE_COUNT  2
+#define LOG_DRAIN_CORE  0
+
+constexpr uint32_t log_token(const char *format)
+{
+  uint32_t hash = 2166136261u;
+  while (*format) {
+    hash = (hash ^ (uint8_t)*format++) * 16777619u;
+  }
+  return hash;
+}
+
+#ifdef LOG_TOKENIZED
+typedef uint32_t log_format_t;
+#define LOG_FORMAT(format)  (std::integral_constant<uint32_t, log_token(format)>::value)
+#else
+typedef const char *log_format_t;
+#define LOG_FORMAT(format)  (format)
+#endif
+
+enum {
+  LOG_ARG_INT,
+  LOG_ARG_FLOAT,
+  LOG_ARG_STRING,
+};
+
+typedef struct {
+  log_format_t format;  // 0 for a hexdump
+  uint32_t stamp_us;    // merges the per-core rings back into order
+  uint8_t level;
+  uint8_t count;        // arguments, or bytes of data for a hexdump
+  uint8_t data_len;
+  uint8_t types[LOG_MAX_ARGS];
+  union {
+    int32_t i;
+    float f;
+    uint8_t str;        // offset into data
+  } args[LOG_MAX_ARGS];
+  char data[LOG_DATA_SIZE];
+} logRecord_t;
+
+class AsyncLog {
+  public:
+    AsyncLog(void);
+    void begin(Print *output) { _output = output; };
+
+    template <typename... Args>
+    void post(int level, log_format_t format, Args... args)
+    {
+      static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+
+      logRecord_t *record = begin_record(level);
+      if (!record) {
+        return;
+      }
+
+      record->format = format;
+      (pack(record, args), ...);
+      commit_record();
+    };
+
+    void hexdump(int level, const uint8_t *buf, int len);
+    void drain(void);
+    uint32_t dropped(void);
+
+  private:
+    logRecord_t *begin_record(int level);
+    void commit_record(void);
+    void format_record(logRecord_t *record, char *buf, int size);
+    void print_record(logRecord_t *record);
+    void write_frame(uint8_t *frame, int len);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    pack(logRecord_t *record, T value)
+    {
+      if (record->count < LOG_MAX_ARGS) {
+        record->types[record->count] = LOG_ARG_INT;
+        record->args[record->count++].i = (int32_t)value;
+      }
+    };
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    pack(logRecord_t *record, T value)
+    {
+      if (record->count < LOG_MAX_ARGS) {
+        record->types[record->count] = LOG_ARG_FLOAT;
+        record->args[record->count++].f = (float)value;
+      }
+    };
+
+    void pack(logRecord_t *record, const char *value);
+
+    // One ring per producing core, drained by LOG_DRAIN_CORE
+    logRecord_t _records[LOG_CORE_COUNT][LOG_RING_SIZE];
+    volatile uint32_t _head[LOG_CORE_COUNT];
+    volatile uint32_t _tail[LOG_CORE_COUNT];
+    volatile uint32_t _dropped[LOG_CORE_COUNT];
+    uint32_t _dropped_reported;
+    Print *_output;
+};
+
+extern AsyncLog asyncLog;
+
+// Never called:  lets the compiler check the arguments against the format.
+static inline void log_format_check(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static inline void log_format_check(const char *format, ...) { (void)format; }
+
+#define LOG_AT(level, format, ...) \
+  do { \
+    if ((level) <= LOG_COMPILE_LEVEL) { \
+      if (0) { \
+        log_format_check(format, ##__VA_ARGS__); \
+      } \
+      asyncLog.post(level, LOG_FORMAT(format), ##__VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_FATAL(format, ...)    LOG_AT(LOG_LEVEL_FATAL, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...)    LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define LOG_WARNING(format, ...)  LOG_AT(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#define LOG_NOTICE(format, ...)   LOG_AT(LOG_LEVEL_NOTICE, format, ##__VA_ARGS__)
+#define LOG_TRACE(format, ...)    LOG_AT(LOG_LEVEL_TRACE, format, ##__VA_ARGS__)
+#define LOG_VERBOSE(format, ...)  LOG_AT(LOG_LEVEL_VERBOSE, format, ##__VA_ARGS__)
+
+#define LOG_HEXDUMP(level, buf, len) \
+  do { \
+    if ((level) <= LOG_COMPILE_LEVEL) { \
+      asyncLog.hexdump(level, buf, len); \
+    } \
+  } while (0)
+
+// Format and print everything queued so far.  Call from core0.
+void update_async_log(void);
+
+#endif
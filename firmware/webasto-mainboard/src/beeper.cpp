@@ -8,6 +8,7 @@
 #include "project.h"
 #include "beeper.h"
 #include "global_timer.h"
+#include "async_log.h"
 
 typedef struct {
   int count;
@@ -32,59 +33,72 @@ void Beeper::register_beeper(int count, int toneMs, int silenceMs)
   beep_q.push(&item);
 
   if (!_active) {
-    timer_callback(TIMER_BEEPER, 0);
+    start_next();
   }
 }
 
-void Beeper::timer_callback(int timerId, int delay)
+void Beeper::start_next(void)
 {
-  (void)timerId;
-  (void)delay;
-
-  Log.notice("Received beep timer, active: %d, count: %d, on: %d", _active, _count, _on);
-
-  if (!_active) {
-    beeperItem_t *item = 0;
-    beep_q.pop(&item);
+  beeperItem_t *item = 0;
+  beep_q.pop(&item);
 
-    if (!item) {
-      return;
-    }
+  if (!item) {
+    _active = false;
+    return;
+  }
 
-    _count = item->count;
-    _toneMs = item->toneMs;
-    _silenceMs = item->silenceMs;
-    free(item);
+  _count = item->count;
+  _toneMs = item->toneMs;
+  _silenceMs = item->silenceMs;
+  free(item);
+
+  // One tone + silence per period:  TIMER_BEEPER starts each tone and
+  // TIMER_BEEPER_OFF, offset by the tone length, ends it.
+  int periodMs = _toneMs + _silenceMs;
+  _active = true;
+  _count--;
+  analogWrite(_pin, 0x7F);
+  _on = true;
+
+  globalTimer.register_periodic_timer(TIMER_BEEPER, periodMs, periodMs, &beeperTimerCallback, true);
+  globalTimer.register_periodic_timer(TIMER_BEEPER_OFF, _toneMs, periodMs, &beeperTimerCallback, true);
+}
 
-    _on = false;
-    _active = true;
-  }
+void Beeper::timer_callback(int timerId, int delay)
+{
+  (void)delay;
 
-  int delayMs;
+  LOG_NOTICE("Received beep timer %d, active: %d, count: %d, on: %d", timerId, _active, _count, _on);
 
-  if (!_on) {
-    if (!_count) {
-      delayMs = 2500;
-      _active = false;
-    } else {
+  switch (timerId) {
+    case TIMER_BEEPER:
       _count--;
       analogWrite(_pin, 0x7F);
       _on = true;
-      delayMs = _toneMs;
-    }
-  } else {
-    analogWrite(_pin, 0x00);
-    _on = false;
-    delayMs = _silenceMs;
+      break;
+
+    case TIMER_BEEPER_OFF:
+      analogWrite(_pin, 0x00);
+      _on = false;
+
+      if (_count <= 0) {
+        // Sequence done, leave a gap before the next queued one.
+        globalTimer.cancel_timer_id(TIMER_BEEPER);
+        globalTimer.cancel_timer_id(TIMER_BEEPER_OFF);
+        globalTimer.register_timer(TIMER_BEEPER_GAP, _silenceMs + 2500, &beeperTimerCallback, true);
+      }
+      break;
+
+    case TIMER_BEEPER_GAP:
+      start_next();
+      break;
+
+    default:
+      break;
   }
-
-  globalTimer.register_timer(TIMER_BEEPER, delayMs, &beeperTimerCallback);
 }
 
 void beeperTimerCallback(int timerId, int delay)
 {
-  if (timerId == TIMER_BEEPER) {
-    beeper.timer_callback(timerId, delay);
-  }
+  beeper.timer_callback(timerId, delay);
 }
-
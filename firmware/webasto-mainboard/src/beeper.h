@@ -14,6 +14,9 @@ class Beeper {
     void register_beeper(int count, int toneMs, int silenceMs);
     void timer_callback(int timerId, int delay);
 
+  protected:
+    void start_next(void);
+
   private:
     int _pin;
     int _active;
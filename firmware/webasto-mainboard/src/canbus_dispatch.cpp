@@ -7,7 +7,48 @@
 #include "canbus_dispatch.h"
 #include "wbus.h"
 #include "sensor_registry.h"
+#include "fsm_queue.h"
+#include "latency_probe.h"
+#include "sensor_snapshot.h"
 
+// Digital inputs that are registered as our own GPIO sensors (not
+// RemoteSensors) can also be asserted over CAN:  any non-zero payload byte
+// means asserted.
+static void canbus_digital_input(int id, uint8_t *buf, int len)
+{
+  bool enable = false;
+  for (int i = 0; i < len; i++) {
+    enable |= (buf[i] != 0);
+  }
+
+  sensor_snapshot_publish(id, enable);
+
+  switch (id) {
+    case CANBUS_ID_IGNITION_SENSE:
+      {
+        IgnitionEvent event;
+        event.enable = enable;
+        fsm_post(event);
+      }
+      break;
+    case CANBUS_ID_EMERGENCY_STOP:
+      {
+        EmergencyStopEvent event;
+        event.enable = enable;
+        fsm_post(event);
+      }
+      break;
+    case CANBUS_ID_START_RUN:
+      {
+        StartRunEvent event;
+        event.enable = enable;
+        fsm_post(event);
+      }
+      break;
+    default:
+      break;
+  }
+}
 
 void canbus_dispatch(int id, uint8_t *buf, int len, uint8_t type)
 {
@@ -34,9 +75,6 @@ void canbus_dispatch(int id, uint8_t *buf, int len, uint8_t type)
     case CANBUS_ID_BATTERY_VOLTAGE:
     case CANBUS_ID_COOLANT_TEMP_WEBASTO:
     case CANBUS_ID_EXHAUST_TEMP:
-    case CANBUS_ID_IGNITION_SENSE:
-    case CANBUS_ID_EMERGENCY_STOP:
-    case CANBUS_ID_START_RUN:
 
     // LINBus via CANBus bridge
     case CANBUS_ID_VEHICLE_FAN_SPEED:
@@ -49,6 +87,22 @@ void canbus_dispatch(int id, uint8_t *buf, int len, uint8_t type)
       }
       break;
 
+    case CANBUS_ID_IGNITION_SENSE:
+    case CANBUS_ID_EMERGENCY_STOP:
+    case CANBUS_ID_START_RUN:
+      {
+        latency_probe_dispatch(latency_path_for_id(id));
+
+        RemoteSensor *sensor = sensorRegistry.get<RemoteSensor>(id);
+        if (sensor) {
+          int32_t value = sensor->convert_from_packet(buf, len);
+          sensor->set_value(value);
+        } else {
+          canbus_digital_input(id, buf, len);
+        }
+      }
+      break;
+
     default:
       break;
   }
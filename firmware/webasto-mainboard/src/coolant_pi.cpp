@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <pico.h>
+
+#include "coolant_pi.h"
+#include "throttle_map.h"
+#include "fuel_pump.h"
+#include "project.h"
+
+coolant_pi_tuning_t coolant_pi_tuning = {
+  COOLANT_PI_KP,
+  COOLANT_PI_KI,
+  COOLANT_PI_KD,
+  COOLANT_TARGET_TEMP,
+};
+
+coolant_pi_t coolant_pi;
+
+#define COOLANT_PI_INTEGRAL_LIMIT ((int32_t)MAX_FUEL_NEED_PRIMING << 16)
+
+void coolant_pi_reset(void)
+{
+  memset(&coolant_pi, 0x00, sizeof(coolant_pi));
+}
+
+void coolant_pi_update(int coolant_temp, int outdoor_temp, int exhaust_temp)
+{
+  coolant_pi_tuning_t *tuning = &coolant_pi_tuning;
+  coolant_pi_t *pi = &coolant_pi;
+
+  // Rate of rise, filtered:  the sensor only reports every second or so
+  if (pi->primed) {
+    int32_t rate = (coolant_temp - pi->last_coolant) * 1000 / COOLANT_PI_PERIOD_MS;
+    pi->rate += (rate - pi->rate) >> COOLANT_PI_RATE_SHIFT;
+  }
+  pi->last_coolant = coolant_temp;
+  pi->primed = true;
+
+  throttle_point_t idle = throttle_map_idle(outdoor_temp);
+  throttle_point_t full = throttle_map_full(outdoor_temp);
+
+  int32_t error = clamp<int32_t>(tuning->target - coolant_temp, INT16_MIN, INT16_MAX);
+  int32_t feedforward = throttle_map_lookup(tuning->target, outdoor_temp).fuel;
+  int32_t proportional = ((int64_t)tuning->kp * error) >> 16;
+  int32_t damping = ((int64_t)tuning->kd * pi->rate) >> 16;
+  int32_t fuel = feedforward + proportional + (pi->integral >> 16) - damping;
+
+  // The ceiling comes down from full throttle to idle over the last
+  // COOLANT_PI_EXHAUST_BAND below the exhaust limit
+  int32_t ceiling = full.fuel;
+  int32_t exhaust_over = exhaust_temp - (EXHAUST_IDLE_THRESHOLD - COOLANT_PI_EXHAUST_BAND);
+  if (exhaust_over > 0) {
+    ceiling -= (full.fuel - idle.fuel) * min(exhaust_over, COOLANT_PI_EXHAUST_BAND) / COOLANT_PI_EXHAUST_BAND;
+  }
+
+  uint8_t limited = COOLANT_PI_LIMIT_NONE;
+  if (coolant_temp >= COOLANT_IDLE_THRESHOLD || exhaust_temp > EXHAUST_IDLE_THRESHOLD) {
+    limited = COOLANT_PI_LIMIT_IDLE;
+  } else if (fuel >= ceiling && ceiling < full.fuel) {
+    limited = COOLANT_PI_LIMIT_EXHAUST;
+  } else if (fuel >= full.fuel) {
+    limited = COOLANT_PI_LIMIT_HIGH;
+  } else if (fuel <= idle.fuel) {
+    limited = COOLANT_PI_LIMIT_LOW;
+  }
+
+  // Only integrate when it can move the output
+  bool integrate = limited == COOLANT_PI_LIMIT_NONE ||
+                   ((limited == COOLANT_PI_LIMIT_HIGH || limited == COOLANT_PI_LIMIT_EXHAUST) && error < 0) ||
+                   (limited == COOLANT_PI_LIMIT_LOW && error > 0);
+  if (integrate) {
+    int64_t integral = pi->integral + (int64_t)tuning->ki * error * COOLANT_PI_PERIOD_MS / 1000;
+    pi->integral = clamp<int64_t>(integral, -COOLANT_PI_INTEGRAL_LIMIT, COOLANT_PI_INTEGRAL_LIMIT);
+  }
+
+  if (limited == COOLANT_PI_LIMIT_IDLE) {
+    fuel = idle.fuel;
+  } else {
+    fuel = clamp<int32_t>(fuel, idle.fuel, ceiling);
+  }
+
+  pi->error = error;
+  pi->feedforward = feedforward;
+  pi->proportional = clamp<int32_t>(proportional, INT16_MIN, INT16_MAX);
+  pi->damping = clamp<int32_t>(damping, INT16_MIN, INT16_MAX);
+  pi->fuel = fuel;
+  pi->fan = limited == COOLANT_PI_LIMIT_IDLE ? idle.fan : throttle_map_fan(fuel, outdoor_temp);
+  pi->limited = limited;
+}
+
+bool coolant_pi_set_tuning(int index, int32_t value)
+{
+  switch (index) {
+    case COOLANT_PI_TUNE_KP:
+      coolant_pi_tuning.kp = value < 0 ? 0 : value;
+      break;
+    case COOLANT_PI_TUNE_KI:
+      coolant_pi_tuning.ki = value < 0 ? 0 : value;
+      break;
+    case COOLANT_PI_TUNE_KD:
+      coolant_pi_tuning.kd = value < 0 ? 0 : value;
+      break;
+    case COOLANT_PI_TUNE_TARGET:
+      // Has to stay under the idle threshold, or it's never reached
+      coolant_pi_tuning.target = clamp<int32_t>(value, COOLANT_MIN_THRESHOLD, COOLANT_IDLE_THRESHOLD - 100);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+int32_t coolant_pi_get_tuning(int index)
+{
+  switch (index) {
+    case COOLANT_PI_TUNE_KP:
+      return coolant_pi_tuning.kp;
+    case COOLANT_PI_TUNE_KI:
+      return coolant_pi_tuning.ki;
+    case COOLANT_PI_TUNE_KD:
+      return coolant_pi_tuning.kd;
+    case COOLANT_PI_TUNE_TARGET:
+      return coolant_pi_tuning.target;
+    default:
+      return 0;
+  }
+}
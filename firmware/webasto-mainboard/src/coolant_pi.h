@@ -0,0 +1,90 @@
+#ifndef __coolant_pi_h_
+#define __coolant_pi_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// AutoBurnState's coolant temperature loop:  fuel need (x100) from a
+// feedforward term (the throttle map at the target temperature) plus PI on
+// the coolant error, damped by the coolant's rate of rise.  The combustion
+// fan follows the fuel along the throttle map.  Integer maths only.
+//
+//   fuel = ff + kp * error + integral(ki * error) - kd * d(coolant)/dt
+//
+// Output is limited to the throttle map's idle..full throttle fuel, with the
+// ceiling tapering down to idle as the exhaust nears EXHAUST_IDLE_THRESHOLD.
+// Over that, or over COOLANT_IDLE_THRESHOLD, the burner drops to idle as it
+// always has.  The integral stops while the output is pinned against a limit
+// it is pushing further into, so it doesn't wind up.
+//
+// Gains are tunable at runtime (W-Bus command 0x60).  Everything here is
+// only touched from core1.
+
+// Gains in 1/65536:  fuel (x100) per 1/100 degC of error, per 1/100
+// degC-second of error, and per 1/100 degC/s of rise
+#ifndef COOLANT_PI_KP
+#define COOLANT_PI_KP   19660   // 0.3
+#endif
+#ifndef COOLANT_PI_KI
+#define COOLANT_PI_KI   164     // 0.0025 (Ti ~120s)
+#endif
+#ifndef COOLANT_PI_KD
+#define COOLANT_PI_KD   98304   // 1.5 (Td ~5s)
+#endif
+
+#define COOLANT_PI_PERIOD_MS    500     // TIMER_FUEL_FAN_DELTA
+#define COOLANT_PI_RATE_SHIFT   3       // rate filter:  1/8 per update
+#define COOLANT_PI_EXHAUST_BAND 2000    // 20C taper below EXHAUST_IDLE_THRESHOLD
+
+enum {
+  COOLANT_PI_TUNE_KP,
+  COOLANT_PI_TUNE_KI,
+  COOLANT_PI_TUNE_KD,
+  COOLANT_PI_TUNE_TARGET,
+  COOLANT_PI_TUNE_COUNT,
+};
+
+typedef struct {
+  int32_t kp;
+  int32_t ki;
+  int32_t kd;
+  int32_t target;       // 1/100 degC
+} coolant_pi_tuning_t;
+
+typedef struct {
+  int32_t integral;     // fuel (x100) in 1/65536
+  int32_t rate;         // filtered 1/100 degC/s
+  int32_t last_coolant;
+  bool primed;          // last_coolant is valid
+
+  // Terms of the last update, for W-Bus
+  int16_t error;
+  int16_t feedforward;
+  int16_t proportional;
+  int16_t damping;
+  int16_t fuel;
+  uint8_t fan;
+  uint8_t limited;      // COOLANT_PI_LIMIT_*
+} coolant_pi_t;
+
+enum {
+  COOLANT_PI_LIMIT_NONE,
+  COOLANT_PI_LIMIT_LOW,
+  COOLANT_PI_LIMIT_HIGH,
+  COOLANT_PI_LIMIT_EXHAUST, // under the exhaust taper
+  COOLANT_PI_LIMIT_IDLE,    // exhaust or coolant over its idle threshold
+};
+
+extern coolant_pi_tuning_t coolant_pi_tuning;
+extern coolant_pi_t coolant_pi;
+
+// Start of a burn:  forget the integral and rate
+void coolant_pi_reset(void);
+
+// One TIMER_FUEL_FAN_DELTA period.  Temperatures in 1/100 degC.
+void coolant_pi_update(int coolant_temp, int outdoor_temp, int exhaust_temp);
+
+bool coolant_pi_set_tuning(int index, int32_t value);
+int32_t coolant_pi_get_tuning(int index);
+
+#endif
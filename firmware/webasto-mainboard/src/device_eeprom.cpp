@@ -9,6 +9,7 @@
 #include "project.h"
 // #include "cbor.h"
 #include "eeprom_checksum.h"
+#include "async_log.h"
 
 #define EEPROM_SIZE 4096
 
@@ -54,7 +55,7 @@ void init_device_eeprom(void)
 {
   uint8_t checksum;
 
-  Log.notice("Reading device info from onboard EEPROM");
+  LOG_NOTICE("Reading device info from onboard EEPROM");
   EEPROM.begin(EEPROM_SIZE);
   EEPROM.get(0, checksum);
   EEPROM.get(1, device_length);
@@ -87,12 +88,12 @@ void init_device_eeprom(void)
     }
 
     if (addr == EEPROM_SIZE) {
-      Log.error("EEPROM data > %d bytes, resetting to default", EEPROM_SIZE);
+      LOG_ERROR("EEPROM data > %d bytes, resetting to default", EEPROM_SIZE);
       device_info_valid = false;
     }
 
     if (calc_checksum) {
-      Log.error("EEPROM data has a bad checksum, resetting to default");
+      LOG_ERROR("EEPROM data has a bad checksum, resetting to default");
     }
   }
 
@@ -114,7 +115,7 @@ void init_device_eeprom(void)
 void update_device_eeprom(void)
 {
   if (device_info_dirty && device_info_valid) {
-    Log.notice("Writing back dirty cache to internal EEPROM");
+    LOG_NOTICE("Writing back dirty cache to internal EEPROM");
     uint8_t checksum = 0x00;
 
     EEPROM.begin(EEPROM_SIZE);
@@ -138,7 +139,7 @@ void update_device_eeprom(void)
     }
 
     if (addr == EEPROM_SIZE) {
-      Log.error("EEPROM data > %d bytes!", EEPROM_SIZE);
+      LOG_ERROR("EEPROM data > %d bytes!", EEPROM_SIZE);
       device_info_valid = false;
     }
 
@@ -9,6 +9,7 @@
 #include "display.h"
 #include "project.h"
 #include "oled_display.h"
+#include "async_log.h"
 
 Display *display = 0;
 mutex_t display_mutex;
@@ -19,7 +20,7 @@ Display::Display(uint8_t i2c_address, int columns, int rows) :
   mutex_init(&_mutex);
 
   CoreMutex m(&_mutex);
-  Log.notice("Attempting to connect to %dx%d display at I2C %X", _columns, _rows, _i2c_address);
+  LOG_NOTICE("Attempting to connect to %dx%d display at I2C %X", _columns, _rows, _i2c_address);
 
   isConnected();
 
@@ -48,7 +49,7 @@ volatile bool Display::isConnected(void)
   Wire.beginTransmission(_i2c_address);
   int ret = Wire.endTransmission();
   _connected = !ret;
-  // Log.notice("I2C Probe of %X - %d -> %d", _i2c_address, ret, _connected);
+  // LOG_NOTICE("I2C Probe of %X - %d -> %d", _i2c_address, ret, _connected);
   return (_connected);
 }
 
@@ -261,7 +262,7 @@ void Display::log(void)
       uint16_t word = _cache[getOffset(x, y)];
       buf[offset] = word < 256 ? (uint8_t)word : 0x00FF;
     }
-    Log.notice("Line %d - |%s|", y, &buf[offset - _columns]);
+    LOG_NOTICE("Line %d - |%s|", y, &buf[offset - _columns]);
   }
 
   delete [] buf;
@@ -281,7 +282,7 @@ void init_display(void) {
 
   display = new OLEDDisplay(I2C_ADDR_OLED, 128, 64);
   if (display && display->isConnected()) {
-    Log.notice("OLED found");
+    LOG_NOTICE("OLED found");
   }
 }
 
@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include <pico.h>
+
+#include "flame_slope.h"
+
+typedef struct {
+  uint32_t time_ms;
+  int32_t value;
+} flame_sample_t;
+
+static flame_sample_t flame_samples[FLAME_SLOPE_SAMPLES];
+static int flame_head = 0;
+static int flame_count = 0;
+
+static bool flame_valid = false;
+static int32_t flame_rate = 0;
+static int32_t flame_latest = 0;
+static int32_t flame_peak = INT32_MIN;
+static int32_t flame_fuel = 0;          // 0 until known
+static int32_t flame_fuel_max = 0;
+
+// Least squares over the samples inside the window, times relative to the
+// newest so the sums stay small
+static void flame_slope_fit(void)
+{
+  const flame_sample_t *newest = &flame_samples[(flame_head + FLAME_SLOPE_SAMPLES - 1) % FLAME_SLOPE_SAMPLES];
+  int64_t n = 0, sum_t = 0, sum_v = 0, sum_tt = 0, sum_tv = 0;
+  int32_t span = 0;
+
+  for (int i = 0; i < flame_count; i++) {
+    const flame_sample_t *sample = &flame_samples[(flame_head + FLAME_SLOPE_SAMPLES - 1 - i) % FLAME_SLOPE_SAMPLES];
+    int32_t t = (int32_t)(sample->time_ms - newest->time_ms);     // <= 0
+    if (-t > FLAME_SLOPE_WINDOW_MS) {
+      break;
+    }
+
+    int32_t v = sample->value - newest->value;
+    n++;
+    sum_t += t;
+    sum_v += v;
+    sum_tt += (int64_t)t * t;
+    sum_tv += (int64_t)t * v;
+    span = -t;
+  }
+
+  int64_t den = n * sum_tt - sum_t * sum_t;
+  flame_valid = span >= FLAME_SLOPE_MIN_SPAN_MS && den > 0;
+  flame_rate = flame_valid ? (int32_t)((n * sum_tv - sum_t * sum_v) * 1000 / den) : 0;
+}
+
+void flame_slope_add(uint32_t time_ms, int exhaust_temp)
+{
+  flame_samples[flame_head].time_ms = time_ms;
+  flame_samples[flame_head].value = exhaust_temp;
+  flame_head = (flame_head + 1) % FLAME_SLOPE_SAMPLES;
+  flame_count = min(flame_count + 1, FLAME_SLOPE_SAMPLES);
+
+  flame_latest = exhaust_temp;
+  flame_peak = max(flame_peak, flame_latest);
+  flame_slope_fit();
+}
+
+void flame_slope_mark(void)
+{
+  flame_peak = flame_count ? flame_latest : INT32_MIN;
+  flame_fuel = 0;
+  flame_fuel_max = 0;
+}
+
+void flame_slope_fuel(int fuel_need)
+{
+  flame_fuel = max(fuel_need, 0);
+  flame_fuel_max = max(flame_fuel_max, flame_fuel);
+}
+
+bool flame_slope_valid(void)
+{
+  return flame_valid;
+}
+
+int flame_slope_rate(void)
+{
+  return flame_rate;
+}
+
+bool flame_slope_lit(int baseline)
+{
+  return flame_valid && flame_rate >= FLAME_SLOPE_LIT_RATE && flame_latest - baseline >= FLAME_SLOPE_MARGIN;
+}
+
+bool flame_slope_cold(int baseline)
+{
+  return flame_valid && flame_rate < FLAME_SLOPE_LIT_RATE / 4 && flame_latest - baseline < FLAME_SLOPE_MARGIN;
+}
+
+bool flame_slope_out(int baseline)
+{
+  if (!flame_valid || flame_rate > -FLAME_SLOPE_OUT_RATE || flame_peak == INT32_MIN) {
+    return false;
+  }
+
+  int64_t rise = flame_peak - baseline;
+  if (flame_fuel_max > 0) {
+    rise = rise * flame_fuel / flame_fuel_max;
+  }
+  return flame_latest - baseline < rise / 2;
+}
@@ -0,0 +1,48 @@
+#ifndef __flame_slope_h_
+#define __flame_slope_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// Secondary flame detection from the exhaust temperature's slope, quicker
+// than waiting out FlameMeasureState's timers or AutoBurnState's stage.
+// Every ExhaustTempEvent goes into a short ring, and the slope is a least
+// squares fit over the samples from the last FLAME_SLOPE_WINDOW_MS.  No
+// verdict until the samples span at least FLAME_SLOPE_MIN_SPAN_MS.
+//
+// - lit:   rising at FLAME_SLOPE_LIT_RATE or faster, and already
+//          FLAME_SLOPE_MARGIN over the baseline (exhaustTempStable)
+// - cold:  not rising (under a quarter of FLAME_SLOPE_LIT_RATE), and still
+//          within FLAME_SLOPE_MARGIN of the baseline (exhaustTempPreBurn), so
+//          nothing has caught at all
+// - out:   falling at FLAME_SLOPE_OUT_RATE or faster, and less than half of
+//          the rise over the baseline (exhaustTempPreBurn) to the peak since
+//          flame_slope_mark() is left
+//
+// Throttling back brings the exhaust down with it, so once AutoBurnState
+// reports a lower fuel need through flame_slope_fuel() than the most since
+// the mark, the "out" half of the rise shrinks in proportion.  Settling at
+// idle after full load is not a flameout, going back to the baseline is.
+//
+// Only touched from core1.
+
+#define FLAME_SLOPE_SAMPLES     8
+#define FLAME_SLOPE_WINDOW_MS   6000
+#define FLAME_SLOPE_MIN_SPAN_MS 4000
+#define FLAME_SLOPE_LIT_RATE    100     // 1C/s
+#define FLAME_SLOPE_OUT_RATE    150     // 1.5C/s
+#define FLAME_SLOPE_MARGIN      500     // 5C
+
+void flame_slope_add(uint32_t time_ms, int exhaust_temp);
+void flame_slope_mark(void);            // start tracking the peak afresh
+void flame_slope_fuel(int fuel_need);   // fuel need * 100, as applied
+
+// 1/100 degC per second, and whether there's enough history for it
+bool flame_slope_valid(void);
+int flame_slope_rate(void);
+
+bool flame_slope_lit(int baseline);
+bool flame_slope_cold(int baseline);
+bool flame_slope_out(int baseline);
+
+#endif
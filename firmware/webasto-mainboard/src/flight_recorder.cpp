@@ -0,0 +1,106 @@
+#include <Beirdo-Utilities.h>
+
+#include <Arduino.h>
+#include <pico.h>
+#include <pico/time.h>
+#include <string.h>
+
+#include "flight_recorder.h"
+#include "fsm.h"
+#include "eeprom_checksum.h"
+
+flight_snapshot_t flight_snapshot;
+bool flight_snapshot_dirty = false;
+
+// Only touched from core1
+static flight_record_t flight_records[FLIGHT_RECORDER_SIZE];
+static uint32_t flight_head = 0;
+static int32_t flight_samples[FLIGHT_SAMPLE_COUNT];
+static int flight_outputs[FLIGHT_OUTPUT_COUNT];
+static bool flight_outputs_valid[FLIGHT_OUTPUT_COUNT];
+
+void flight_recorder_add(uint8_t kind, uint8_t id, int value)
+{
+  flight_record_t *record = &flight_records[flight_head & (FLIGHT_RECORDER_SIZE - 1)];
+
+  record->time_us = time_us_32();
+  record->kind = kind;
+  record->id = id;
+  record->value = clamp<int>(value, INT16_MIN, INT16_MAX);
+  flight_head++;
+}
+
+// Outputs are set again and again with the same value, only changes are kept
+void flight_recorder_output(uint8_t output, int value)
+{
+  if (output >= FLIGHT_OUTPUT_COUNT) {
+    return;
+  }
+
+  if (flight_outputs_valid[output] && flight_outputs[output] == value) {
+    return;
+  }
+
+  flight_outputs[output] = value;
+  flight_outputs_valid[output] = true;
+  flight_recorder_add(FLIGHT_OUTPUT, output, value);
+}
+
+void flight_recorder_sample(int sample, int value)
+{
+  if (sample >= 0 && sample < FLIGHT_SAMPLE_COUNT) {
+    flight_samples[sample] = value;
+  }
+}
+
+uint8_t flight_snapshot_checksum(flight_snapshot_t *snapshot)
+{
+  uint8_t saved = snapshot->checksum;
+  snapshot->checksum = 0;
+  uint8_t checksum = eeprom_checksum((uint8_t *)snapshot, sizeof(flight_snapshot_t));
+  snapshot->checksum = saved;
+  return checksum;
+}
+
+bool flight_snapshot_valid(flight_snapshot_t *snapshot)
+{
+  return snapshot->version == FLIGHT_SNAPSHOT_VERSION &&
+         snapshot->count <= FLIGHT_SNAPSHOT_ENTRIES &&
+         snapshot->checksum == flight_snapshot_checksum(snapshot);
+}
+
+// Caller holds fram_mutex
+void flight_snapshot_clear(void)
+{
+  memset(&flight_snapshot, 0x00, sizeof(flight_snapshot));
+  flight_snapshot.version = FLIGHT_SNAPSHOT_VERSION;
+  flight_snapshot.checksum = flight_snapshot_checksum(&flight_snapshot);
+  flight_snapshot_dirty = true;
+}
+
+// Caller holds fram_mutex
+void flight_recorder_freeze(uint8_t error_code)
+{
+  flight_recorder_add(FLIGHT_ERROR, error_code, 0);
+
+  uint16_t sequence = flight_snapshot.sequence + 1;
+  memset(&flight_snapshot, 0x00, sizeof(flight_snapshot));
+
+  flight_snapshot.version = FLIGHT_SNAPSHOT_VERSION;
+  flight_snapshot.error_code = error_code;
+  flight_snapshot.fsm_state = fsm_state;
+  flight_snapshot.fsm_mode = fsm_mode;
+  flight_snapshot.time_us = time_us_32();
+  flight_snapshot.sequence = sequence;
+  memcpy(flight_snapshot.samples, flight_samples, sizeof(flight_samples));
+
+  int count = (int)min(flight_head, (uint32_t)FLIGHT_SNAPSHOT_ENTRIES);
+  uint32_t start = flight_head - count;
+  for (int i = 0; i < count; i++) {
+    flight_snapshot.entries[i] = flight_records[(start + i) & (FLIGHT_RECORDER_SIZE - 1)];
+  }
+  flight_snapshot.count = count;
+
+  flight_snapshot.checksum = flight_snapshot_checksum(&flight_snapshot);
+  flight_snapshot_dirty = true;
+}
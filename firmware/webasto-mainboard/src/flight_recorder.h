@@ -0,0 +1,87 @@
+#ifndef __flight_recorder_h_
+#define __flight_recorder_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "fsm_queue.h"
+
+// Flight recorder:  a RAM ring of the last FLIGHT_RECORDER_SIZE FSM events,
+// state transitions and actuator output changes, each stamped with the low
+// 32 bits of monotonic_us(), plus the latest value of each sensor reading.
+//
+// Every fram_add_error() freezes the newest FLIGHT_SNAPSHOT_ENTRIES records
+// and the readings into flight_snapshot, which lives in its own region at the
+// top of the FRAM.  It survives a reboot and is read back over W-Bus (sensor
+// 0x62).  Only one snapshot is kept:  the newest error overwrites it.
+//
+// Records are only added from core1 (the FSM).  flight_snapshot is guarded
+// by fram_mutex.
+
+#ifndef FLIGHT_RECORDER_SIZE
+#define FLIGHT_RECORDER_SIZE    128
+#endif
+
+static_assert((FLIGHT_RECORDER_SIZE & (FLIGHT_RECORDER_SIZE - 1)) == 0, "FLIGHT_RECORDER_SIZE must be a power of 2");
+
+#define FLIGHT_SNAPSHOT_ENTRIES 18
+#define FLIGHT_SNAPSHOT_VERSION 2
+
+enum {
+  FLIGHT_EVENT,         // id:  FSM_EVENT_*, value:  event value (timer id for timers)
+  FLIGHT_TRANSITION,    // id:  new state, value:  previous state
+  FLIGHT_OUTPUT,        // id:  FLIGHT_OUTPUT_*, value:  new setting
+  FLIGHT_ERROR,         // id:  error code, value:  0
+};
+
+enum {
+  FLIGHT_OUTPUT_COMBUSTION_FAN,     // percent
+  FLIGHT_OUTPUT_GLOW_PLUG,          // percent
+  FLIGHT_OUTPUT_FUEL_PUMP,          // fuel need * 100
+  FLIGHT_OUTPUT_VEHICLE_FAN,        // percent
+  FLIGHT_OUTPUT_CIRCULATION_PUMP,
+  FLIGHT_OUTPUT_GLOW_PLUG_IN_EN,
+  FLIGHT_OUTPUT_GLOW_PLUG_OUT_EN,
+  FLIGHT_OUTPUT_COUNT,
+};
+
+// Readings are indexed by their FSM_EVENT_* coalesced type, and the flame
+// detector (queued, but a reading all the same) goes after them.
+#define FLIGHT_SAMPLE_FLAME_DETECT  FSM_COALESCED_COUNT
+#define FLIGHT_SAMPLE_COUNT         (FSM_COALESCED_COUNT + 1)
+
+typedef struct {
+  uint32_t time_us;
+  uint8_t kind;
+  uint8_t id;
+  int16_t value;        // saturated
+} flight_record_t;
+
+static_assert(sizeof(flight_record_t) == 8, "flight_record_t should pack to 8 bytes");
+
+typedef struct {
+  uint8_t version;
+  uint8_t checksum;     // over the whole snapshot, with this byte as 0
+  uint8_t error_code;
+  uint8_t fsm_state;
+  uint32_t time_us;     // when frozen, on the same clock as the records
+  uint16_t sequence;    // snapshots taken since the FRAM was initialized
+  uint8_t fsm_mode;
+  uint8_t count;        // valid entries
+  int32_t samples[FLIGHT_SAMPLE_COUNT];
+  flight_record_t entries[FLIGHT_SNAPSHOT_ENTRIES];   // oldest first
+} flight_snapshot_t;
+
+extern flight_snapshot_t flight_snapshot;
+extern bool flight_snapshot_dirty;
+
+void flight_recorder_add(uint8_t kind, uint8_t id, int value);
+void flight_recorder_output(uint8_t output, int value);
+void flight_recorder_sample(int sample, int value);
+void flight_recorder_freeze(uint8_t error_code);
+
+uint8_t flight_snapshot_checksum(flight_snapshot_t *snapshot);
+bool flight_snapshot_valid(flight_snapshot_t *snapshot);
+void flight_snapshot_clear(void);
+
+#endif
@@ -12,7 +12,8 @@
 #include "beeper.h"
 #include "eeprom_checksum.h"
 #include "canbus_ids.h"
-#include "sensor_registry.h"
+#include "sensor_snapshot.h"
+#include "async_log.h"
 
 fram_data_t fram_data;
 bool fram_dirty = false;
@@ -21,6 +22,9 @@ mutex_t fram_mutex;
 
 int fram_lengths[] = {
   sizeof(struct fram_v1_s),
+  sizeof(struct fram_v2_s),
+  sizeof(struct fram_v3_s),
+  sizeof(struct fram_v4_s),
 };
 
 void initalize_fram_data(uint8_t version, uint8_t *buf)
@@ -39,6 +43,33 @@ void initalize_fram_data(uint8_t version, uint8_t *buf)
         fram_dirty = true;
       }
       break;
+    case 2:
+      {
+        memset(buf, 0x00, sizeof(fram_data));
+        struct fram_v2_s *data = (struct fram_v2_s *)buf;
+        data->version = 2;
+        data->checksum = eeprom_checksum(buf, fram_lengths[1]);
+        fram_dirty = true;
+      }
+      break;
+    case 3:
+      {
+        memset(buf, 0x00, sizeof(fram_data));
+        struct fram_v3_s *data = (struct fram_v3_s *)buf;
+        data->version = 3;
+        data->checksum = eeprom_checksum(buf, fram_lengths[2]);
+        fram_dirty = true;
+      }
+      break;
+    case 4:
+      {
+        memset(buf, 0x00, sizeof(fram_data));
+        struct fram_v4_s *data = (struct fram_v4_s *)buf;
+        data->version = 4;
+        data->checksum = eeprom_checksum(buf, fram_lengths[3]);
+        fram_dirty = true;
+      }
+      break;
     defaults:
       break;
   }
@@ -61,17 +92,27 @@ void init_fram(void)
   if (!fram->begin()) {
     delete fram;
     fram = 0;
-    Log.error("No onboard FRAM at address %X", CY15E004J_I2C_ADDR);
+    LOG_ERROR("No onboard FRAM at address %X", CY15E004J_I2C_ADDR);
     return;
   }
 
+  LOG_NOTICE("Reading flight recorder snapshot");
+
+  fram->readBlock(FRAM_SNAPSHOT_OFFSET, (uint8_t *)&flight_snapshot, sizeof(flight_snapshot));
+  if (!flight_snapshot_valid(&flight_snapshot)) {
+    LOG_WARNING("No valid flight recorder snapshot, clearing");
+    flight_snapshot_clear();
+  } else if (flight_snapshot.count) {
+    LOG_NOTICE("Flight recorder snapshot #%d for error %X", flight_snapshot.sequence, flight_snapshot.error_code);
+  }
+
   uint8_t *buf = (uint8_t *)&fram_data;
 
-  Log.notice("Reading onboard FRAM");
+  LOG_NOTICE("Reading onboard FRAM");
 
   int len = fram->readBlock(0, buf, max_fram_data);
   if (len < min_fram_data) {
-    Log.warning("Onboard FRAM incomplete (%d bytes read), initializing...", len);
+    LOG_WARNING("Onboard FRAM incomplete (%d bytes read), initializing...", len);
     initalize_fram_data(CURRENT_FRAM_VERSION, buf);
     return;
   }
@@ -85,14 +126,7 @@ void init_fram(void)
   }
 
   if (empty) {
-    Log.warning("Onboard EEPROM is empty, initializing...");
-    initalize_fram_data(CURRENT_FRAM_VERSION, buf);
-    return;
-  }
-
-  // Check the checksum (use same checksum as EEPROMs)
-  if (eeprom_checksum(buf, len)) {
-    Log.warning("Onboard EEPROM has bad checksum, initializing...");
+    LOG_WARNING("Onboard EEPROM is empty, initializing...");
     initalize_fram_data(CURRENT_FRAM_VERSION, buf);
     return;
   }
@@ -100,20 +134,28 @@ void init_fram(void)
   uint8_t version = fram_data.current.version;
 
   if (version > CURRENT_FRAM_VERSION || version < 1) {
-    Log.error("Onboard FRAM has an unsupported version (%d)", version);
+    LOG_ERROR("Onboard FRAM has an unsupported version (%d)", version);
     delete fram;
     fram = 0;
     return;
   }
 
   if (len < fram_lengths[version - 1]) {
-    Log.warning("Onboard FRAM incomplete for v%d (%d of %d bytes read), initializing...", version, len, fram_lengths[version - 1]);
+    LOG_WARNING("Onboard FRAM incomplete for v%d (%d of %d bytes read), initializing...", version, len, fram_lengths[version - 1]);
+    initalize_fram_data(CURRENT_FRAM_VERSION, buf);
+    return;
+  }
+
+  // Check the checksum (use same checksum as EEPROMs) over that version's
+  // layout:  anything past it is left over, or not written yet
+  if (eeprom_checksum(buf, fram_lengths[version - 1])) {
+    LOG_WARNING("Onboard EEPROM has bad checksum, initializing...");
     initalize_fram_data(CURRENT_FRAM_VERSION, buf);
     return;
   }
 
   fram_dirty = false;
-  Log.notice("Found v%d FRAM", version);
+  LOG_NOTICE("Found v%d FRAM", version);
 
   if (version != CURRENT_FRAM_VERSION) {
     upgrade_fram_version(&fram_data);
@@ -123,15 +165,28 @@ void init_fram(void)
 void update_fram(void)
 {
   CoreMutex m(&fram_mutex);
-  if (!fram_dirty || !fram) {
+  if (!fram) {
     return;
   }
 
+  if (flight_snapshot_dirty) {
+    fram->writeBlock(FRAM_SNAPSHOT_OFFSET, (uint8_t *)&flight_snapshot, sizeof(flight_snapshot));
+    flight_snapshot_dirty = false;
+  }
+
+  if (!fram_dirty) {
+    return;
+  }
+
+  // Everything since the last write changed the contents under the
+  // checksum that init_fram() will check
   int version = fram_data.current.version;
   int len = fram_lengths[version - 1];
-  int written = fram->writeBlock(0, (uint8_t *)&fram_data, len);
+  fram_data.current.checksum = 0;
+  fram_data.current.checksum = eeprom_checksum((uint8_t *)&fram_data, len);
 
-  if (written == len) {
+  // 0 on success
+  if (!fram->writeBlock(0, (uint8_t *)&fram_data, len)) {
     fram_dirty = false;
   }
 }
@@ -157,8 +212,28 @@ void upgrade_fram_version(fram_data_t *data)
 {
   CoreMutex m(&fram_mutex);
 
-  Log.notice("Upgrading onboard FRAM contents from version %d to version %d", fram_data.current.version, CURRENT_FRAM_VERSION);
-  /* Currently no upgrade paths to implement */
+  LOG_NOTICE("Upgrading onboard FRAM contents from version %d to version %d", fram_data.current.version, CURRENT_FRAM_VERSION);
+
+  // Each version only appends to the one before, so the old fields are
+  // already in place:  clear the new ones
+  if (data->current.version < 2) {
+    // No throttle map override
+    memset(&data->v2.throttle_map, 0x00, sizeof(data->v2.throttle_map));
+  }
+
+  if (data->current.version < 3) {
+    // No state statistics yet
+    memset(&data->v3.state_stats, 0x00, sizeof(data->v3.state_stats));
+  }
+
+  if (data->current.version < 4) {
+    // Nothing learnt about starting yet
+    memset(&data->v4.start_learn, 0x00, sizeof(data->v4.start_learn));
+  }
+
+  data->current.version = CURRENT_FRAM_VERSION;
+  data->current.checksum = 0;
+  data->current.checksum = eeprom_checksum((uint8_t *)data, fram_lengths[CURRENT_FRAM_VERSION - 1]);
   fram_dirty = true;
 }
 
@@ -185,6 +260,8 @@ void fram_add_error(uint8_t code)
   CoreMutex m(&fram_mutex);
 
   beeper.register_beeper(1, 250, 250);
+  state_stats_error();
+  flight_recorder_freeze(code);
 
   int error_list_len = fram_data.current.error_list_count;
 
@@ -211,16 +288,23 @@ void fram_add_error(uint8_t code)
   item->count++;
   item->status = 0x01;    // Stored
   item->state = (fsm_state << 8);
-  Sensor *externalTempSensor = sensorRegistry.get(CANBUS_ID_EXTERNAL_TEMP);
-  item->temperature = (uint8_t)(((externalTempSensor->get_value() / 50) + 1) / 2 + 50);
 
-  Sensor *batteryVoltageSensor = sensorRegistry.get(CANBUS_ID_BATTERY_VOLTAGE);
-  item->vbat = batteryVoltageSensor->get_value();
+  sensor_snapshot_t snapshot;
+  sensor_snapshot_read(&snapshot);
+  item->temperature = (uint8_t)(((sensor_snapshot_get(&snapshot, CANBUS_ID_EXTERNAL_TEMP) / 50) + 1) / 2 + 50);
+  item->vbat = sensor_snapshot_get(&snapshot, CANBUS_ID_BATTERY_VOLTAGE);
   memcpy((char *)&item->operating_time, (char *)&fram_data.current.total_working_duration, sizeof(time_sensor_t));
 
   fram_dirty = true;
 }
 
+void fram_clear_snapshot(void)
+{
+  CoreMutex m(&fram_mutex);
+
+  flight_snapshot_clear();
+}
+
 void fram_write_co2(uint8_t value)
 {
   CoreMutex m(&fram_mutex);
@@ -7,6 +7,11 @@
 
 #include <I2C_eeprom.h>
 
+#include "flight_recorder.h"
+#include "throttle_map.h"
+#include "state_stats.h"
+#include "start_learn.h"
+
 #define CY15E004J_DEVICE_SIZE 512
 #define CY15E004J_BLOCK_SIZE 8
 #define CY15E004J_I2C_ADDR 0x50
@@ -50,17 +55,95 @@ struct fram_v1_s {
   uint8_t lockdown;
 };
 
+struct fram_v2_s {
+  uint8_t version;
+  uint8_t checksum;
+  time_sensor_t burn_duration_parking_heater[4];
+  time_sensor_t burn_duration_supplemental_heater[4];
+  time_sensor_t working_duration_parking_heater;
+  time_sensor_t working_duration_supplemental_heater;
+  uint16_t start_counter_parking_heater;
+  uint16_t start_counter_supplemental_heater;
+  uint16_t counter_emergency_shutdown;
+  time_sensor_t total_burn_duration;
+  time_sensor_t total_working_duration;
+  uint16_t total_start_counter;
+  uint8_t error_list_count;
+  error_list_item_t error_list[MAX_ERROR_COUNT];
+  uint8_t device_status;
+  uint8_t current_co2;
+  uint8_t minimum_co2;
+  uint8_t maximum_co2;
+  uint8_t lockdown;
+  throttle_map_t throttle_map;
+};
+
+struct fram_v3_s {
+  uint8_t version;
+  uint8_t checksum;
+  time_sensor_t burn_duration_parking_heater[4];
+  time_sensor_t burn_duration_supplemental_heater[4];
+  time_sensor_t working_duration_parking_heater;
+  time_sensor_t working_duration_supplemental_heater;
+  uint16_t start_counter_parking_heater;
+  uint16_t start_counter_supplemental_heater;
+  uint16_t counter_emergency_shutdown;
+  time_sensor_t total_burn_duration;
+  time_sensor_t total_working_duration;
+  uint16_t total_start_counter;
+  uint8_t error_list_count;
+  error_list_item_t error_list[MAX_ERROR_COUNT];
+  uint8_t device_status;
+  uint8_t current_co2;
+  uint8_t minimum_co2;
+  uint8_t maximum_co2;
+  uint8_t lockdown;
+  throttle_map_t throttle_map;
+  state_stats_fram_t state_stats;
+};
+
+struct fram_v4_s {
+  uint8_t version;
+  uint8_t checksum;
+  time_sensor_t burn_duration_parking_heater[4];
+  time_sensor_t burn_duration_supplemental_heater[4];
+  time_sensor_t working_duration_parking_heater;
+  time_sensor_t working_duration_supplemental_heater;
+  uint16_t start_counter_parking_heater;
+  uint16_t start_counter_supplemental_heater;
+  uint16_t counter_emergency_shutdown;
+  time_sensor_t total_burn_duration;
+  time_sensor_t total_working_duration;
+  uint16_t total_start_counter;
+  uint8_t error_list_count;
+  error_list_item_t error_list[MAX_ERROR_COUNT];
+  uint8_t device_status;
+  uint8_t current_co2;
+  uint8_t minimum_co2;
+  uint8_t maximum_co2;
+  uint8_t lockdown;
+  throttle_map_t throttle_map;
+  state_stats_fram_t state_stats;
+  start_learn_fram_t start_learn;
+};
+
 typedef union {
   struct fram_v1_s v1;
-  struct fram_v1_s current;
+  struct fram_v2_s v2;
+  struct fram_v3_s v3;
+  struct fram_v4_s v4;
+  struct fram_v4_s current;
 } fram_data_t;
 
 extern int fram_lengths[];
 
-#define CURRENT_FRAM_VERSION 1
-#define MAX_FRAM_VERSION 1
+#define CURRENT_FRAM_VERSION 4
+#define MAX_FRAM_VERSION 4
+
+// The flight recorder snapshot has the top of the FRAM to itself
+#define FRAM_SNAPSHOT_OFFSET  (CY15E004J_DEVICE_SIZE - sizeof(flight_snapshot_t))
 
-static_assert(sizeof(fram_data_t) <= CY15E004J_DEVICE_SIZE, "Structure fram_data_t is larger than the FRAM!");
+static_assert(sizeof(fram_data_t) <= FRAM_SNAPSHOT_OFFSET, "Structure fram_data_t overlaps the flight recorder snapshot!");
 
 extern fram_data_t fram_data;
 extern bool fram_dirty;
@@ -77,5 +160,6 @@ void fram_unlock(void);
 void fram_clear_error_list(void);
 void fram_add_error(uint8_t code);
 void fram_write_co2(uint8_t value);
+void fram_clear_snapshot(void);
 
 #endif
@@ -6,6 +6,7 @@
 #include "fsm.h"
 #include "fsm_state.h"
 #include "fsm_events.h"
+#include "fsm_queue.h"
 #include "fuel_pump.h"
 #include "global_timer.h"
 #include "webasto.h"
@@ -13,6 +14,18 @@
 #include "beeper.h"
 #include "canbus.h"
 #include "sensor_registry.h"
+#include "async_log.h"
+#include "flight_recorder.h"
+#include "latency_probe.h"
+#include "throttle_map.h"
+#include "coolant_pi.h"
+#include "sensor_snapshot.h"
+#include "actuators.h"
+#include "supervisor.h"
+#include "state_stats.h"
+#include "start_learn.h"
+#include "flame_slope.h"
+#include "monotonic.h"
 
 uint8_t fsm_state = 0x00;
 int fsm_mode = 0;
@@ -29,7 +42,7 @@ bool circulationPumpOn = false;
 int combustionFanPercent = 0;
 int vehicleFanPercent = 0;
 int glowPlugPercent = 0;
-float fuelNeedRequested = 0.0;
+int fuelNeedRequested = 0;
 
 bool glowPlugInEnable = false;   // mutually exclusive with glowPlugOutEnable
 bool glowPlugOutEnable = false;  // mutually exclusive with glowPlugInEnable
@@ -37,7 +50,7 @@ bool glowPlugOutEnable = false;  // mutually exclusive with glowPlugInEnable
 bool flameLed = false;
 bool operatingLed = false;
 
-time_sensor_t ventilation_duration = {0};
+time_sensor_t ventilation_duration = { 0, 0 };
 
 int flameOutCount = 0;
 int exhaustTempPreBurn = 0;
@@ -46,6 +59,29 @@ int exhaustTempStable = 0;
 bool fsm_init = false;
 mutex_t fsm_mutex;
 
+// Caller holds fsm_mutex
+void set_fsm_state(uint8_t state)
+{
+  flight_recorder_add(FLIGHT_TRANSITION, state, fsm_state);
+  fsm_state = state;
+  supervisor_note_state(state);
+  start_learn_transition(state_stats_transition(state));
+}
+
+// Everything from purging through cooldown may have fuel in the chamber
+bool fsm_state_may_be_burning(uint8_t state)
+{
+  switch (state) {
+    case WB_STATE_BO:       // Startup
+    case WB_STATE_BOADR:    // EmergencyOff
+    case WB_STATE_OFF:      // Idle
+    case WB_STATE_LOCK2:    // Lockdown
+      return false;
+    default:
+      return true;
+  }
+}
+
 void set_open_drain_pin(int pinNum, int value)
 {
   // open drain with external pullup, asserted low (negative logic)
@@ -56,49 +92,36 @@ void set_open_drain_pin(int pinNum, int value)
     pinMode(pinNum, OUTPUT);
     digitalWrite(pinNum, LOW);
   }
+  latency_probe_output();
 }
 
 void WebastoControlFSM::react(GlowPlugInEnableEvent const &e)
 {
-  Log.notice("Received GlowPlugInEnableEvent: %d", e.enable);
-  CoreMutex m(&fsm_mutex);
-
-  LedChangeEvent e0;
-  e0.operatingChange = false;
-  e0.flameChange = true;
-  e0.enable = e.enable;
-  dispatch(e0);
+  LOG_NOTICE("Received GlowPlugInEnableEvent: %d", e.enable);
 
-  glowPlugInEnable = e.enable;
-  if (glowPlugInEnable && glowPlugOutEnable) {
-    glowPlugOutEnable = false;
-    set_open_drain_pin(PIN_GLOW_PLUG_OUT_EN, glowPlugOutEnable);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.glow_plug_in_enable = e.enable;
+  if (e.enable) {
+    outputs.glow_plug_out_enable = false;
   }
-  set_open_drain_pin(PIN_GLOW_PLUG_IN_EN, glowPlugInEnable);
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(GlowPlugOutEnableEvent const &e)
 {
-  Log.notice("Received GlowPlugInEnableEvent: %d", e.enable);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received GlowPlugOutEnableEvent: %d", e.enable);
 
-  LedChangeEvent e0;
-  e0.operatingChange = false;
-  e0.flameChange = true;
-  e0.enable = false;
-  dispatch(e0);
-
-  glowPlugOutEnable = e.enable;
-  if (glowPlugOutEnable && glowPlugInEnable) {
-    glowPlugInEnable = false;
-    set_open_drain_pin(PIN_GLOW_PLUG_IN_EN, glowPlugInEnable);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.glow_plug_out_enable = e.enable;
+  if (e.enable) {
+    outputs.glow_plug_in_enable = false;
   }
-  set_open_drain_pin(PIN_GLOW_PLUG_OUT_EN, glowPlugOutEnable);
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(LedChangeEvent const &e)
 {
-  Log.notice("Received LedChangeEvent: Operating: %d, Flame: %d, Enable: %d", e.operatingChange, e.flameChange, e.enable);
+  LOG_NOTICE("Received LedChangeEvent: Operating: %d, Flame: %d, Enable: %d", e.operatingChange, e.flameChange, e.enable);
   CoreMutex m(&fsm_mutex);
 
   int pin;
@@ -120,58 +143,51 @@ void WebastoControlFSM::react(LedChangeEvent const &e)
 
 void WebastoControlFSM::react(CirculationPumpEvent const &e)
 {
-  Log.notice("Received CirculationPumpEvent: %d", e.enable);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received CirculationPumpEvent: %d", e.enable);
 
-  circulationPumpOn = e.enable;
-  digitalWrite(PIN_CIRCULATION_PUMP, circulationPumpOn);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.circulation_pump = e.enable;
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(CombustionFanEvent const &e)
 {
-  Log.notice("Received CombustionFanEvent: %d", e.value);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received CombustionFanEvent: %d", e.value);
 
-  combustionFanPercent = clamp<int>(e.value, 0, 100);
-  analogWrite(PIN_COMBUSTION_FAN, combustionFanPercent * 255 / 100);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.combustion_fan = e.value;
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(GlowPlugOutEvent const &e)
 {
-  Log.notice("Received GlowPlugOutEvent: %d", e.value);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received GlowPlugOutEvent: %d", e.value);
 
-  if (e.value && !glowPlugOutEnable) {
+  actuator_outputs_t outputs = actuators_current();
+  if (e.value && !outputs.glow_plug_out_enable) {
     return;
   }
 
-  glowPlugPercent = clamp<int>(e.value, 0, 100);
-  analogWrite(PIN_GLOW_PLUG_OUT, glowPlugPercent * 255 / 100);
+  outputs.glow_plug = e.value;
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(VehicleFanEvent const &e)
 {
-  Log.notice("Received VehicleFanEvent: %d", e.value);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received VehicleFanEvent: %d", e.value);
 
-  vehicleFanPercent = clamp<int>(e.value, 0, 100);
-  RemoteLINBusSensor *vehicleFanActuator = sensorRegistry.get<RemoteLINBusSensor>(CANBUS_ID_VEHICLE_FAN_PERCENT);
-  vehicleFanActuator->send_control_value(vehicleFanPercent, 1);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.vehicle_fan = e.value;
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(FuelPumpEvent const &e)
 {
-  Log.notice("Received FuelPumpEvent: %f", e.value);
-  CoreMutex m(&fsm_mutex);
+  LOG_NOTICE("Received FuelPumpEvent: %d", e.value);
 
-  if (e.value == 0.0) {
-    fuelNeedRequested = 0.0;
-  } else if (priming) {
-    fuelNeedRequested = clamp<int>(e.value, MIN_FUEL_NEED, MAX_FUEL_NEED_PRIMING);
-  } else {
-    fuelNeedRequested = clamp<int>(e.value, MIN_FUEL_NEED, MAX_FUEL_NEED_BURNING);
-  }
-  fuelPumpTimer.setFuelNeed(fuelNeedRequested);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.fuel_need = e.value;
+  actuators_apply(&outputs);
 }
 
 void WebastoControlFSM::react(TimerEvent const &e)
@@ -179,14 +195,14 @@ void WebastoControlFSM::react(TimerEvent const &e)
   fsmCommonReact(e);
 }
 
-void WebastoControlFSM::react(FlameDetectEvent const &e)
+void WebastoControlFSM::react(FlameDetectEvent const &)
 {
   // We only care in one state, so we will override specifically there, and gobble em up otherwise
 }
 
 void WebastoControlFSM::react(EmergencyStopEvent const &e)
 {
-  Log.notice("Received EmergencyStopEvent: %d", e.enable);
+  LOG_NOTICE("Received EmergencyStopEvent: %d", e.enable);
 
   if (!e.enable) {
     return;
@@ -210,7 +226,7 @@ void WebastoControlFSM::react(EmergencyStopEvent const &e)
 
 void WebastoControlFSM::react(CoolantTempEvent const &e)
 {
-  Log.notice("Received CoolantTempEvent: %d", e.value);
+  LOG_NOTICE("Received CoolantTempEvent: %d", e.value);
   CoreMutex m(&fsm_mutex);
 
   if (e.value > COOLANT_MAX_THRESHOLD) {
@@ -231,7 +247,7 @@ void WebastoControlFSM::react(CoolantTempEvent const &e)
 
 void WebastoControlFSM::react(OutdoorTempEvent const &e)
 {
-  Log.notice("Received OutdoorTempEvent: %d", e.value);
+  LOG_NOTICE("Received OutdoorTempEvent: %d", e.value);
   CoreMutex m(&fsm_mutex);
 
   if (e.value >= SUPPLEMENTAL_MIN_TEMP && e.value <= SUPPLEMENTAL_MAX_TEMP) {
@@ -255,9 +271,11 @@ void WebastoControlFSM::react(OutdoorTempEvent const &e)
 
 void WebastoControlFSM::react(ExhaustTempEvent const &e)
 {
-  Log.notice("Received ExhaustTempEvent: %d", e.value);
+  LOG_NOTICE("Received ExhaustTempEvent: %d", e.value);
   CoreMutex m(&fsm_mutex);
 
+  flame_slope_add((uint32_t)monotonic_ms(), e.value);
+
   if (e.value > EXHAUST_MAX_TEMP && fsm_mode) {
     fram_add_error(0x06);
 
@@ -272,7 +290,7 @@ void WebastoControlFSM::react(ExhaustTempEvent const &e)
 
 void WebastoControlFSM::react(InternalTempEvent const &e)
 {
-  Log.notice("Received InternalTempEvent: %d", e.value);
+  LOG_NOTICE("Received InternalTempEvent: %d", e.value);
 
   CoreMutex m(&fsm_mutex);
 
@@ -290,7 +308,7 @@ void WebastoControlFSM::react(InternalTempEvent const &e)
 
 void WebastoControlFSM::react(BatteryLevelEvent const &e)
 {
-  Log.notice("Received BatteryLevelEvent: %d", e.value);
+  LOG_NOTICE("Received BatteryLevelEvent: %d", e.value);
   CoreMutex m(&fsm_mutex);
 
   if (batteryLow) {
@@ -318,7 +336,7 @@ void WebastoControlFSM::react(BatteryLevelEvent const &e)
 
 void WebastoControlFSM::react(VSYSLevelEvent const &e)
 {
-  Log.notice("Received VSYSLevelEvent: %d", e.value);
+  LOG_NOTICE("Received VSYSLevelEvent: %d", e.value);
   CoreMutex m(&fsm_mutex);
 
   if (vsysLow) {
@@ -347,7 +365,7 @@ void WebastoControlFSM::react(VSYSLevelEvent const &e)
 
 void WebastoControlFSM::react(FlameoutEvent const &e)
 {
-  Log.notice("Received FlameoutEvent: reset: %d", e.resetCount);
+  LOG_NOTICE("Received FlameoutEvent: reset: %d", e.resetCount);
   CoreMutex m(&fsm_mutex);
 
   if (e.resetCount) {
@@ -374,15 +392,15 @@ void WebastoControlFSM::react(FlameoutEvent const &e)
   }
 }
 
-void WebastoControlFSM::react(RestartEvent const &e)
+void WebastoControlFSM::react(RestartEvent const &)
 {
-  Log.notice("Received RestartEvent");
+  LOG_NOTICE("Received RestartEvent");
   transit<PurgingState>();
 }
 
-void WebastoControlFSM::react(OverheatEvent const &e)
+void WebastoControlFSM::react(OverheatEvent const &)
 {
-  Log.notice("Received OverheatEvent");
+  LOG_NOTICE("Received OverheatEvent");
   CoreMutex m(&fsm_mutex);
 
   fram_add_error(0x06);
@@ -398,10 +416,10 @@ void WebastoControlFSM::react(OverheatEvent const &e)
 
 void WebastoControlFSM::react(ShutdownEvent const &e)
 {
-  Log.notice("Received ShutdownEvent: mode %d, emergency:%d, lockdown:%d", e.mode, e.emergency, e.lockdown);
+  LOG_NOTICE("Received ShutdownEvent: mode %d, emergency:%d, lockdown:%d", e.mode, e.emergency, e.lockdown);
   CoreMutex m(&fsm_mutex);
 
-  int new_mode;
+  int new_mode = e.mode;
   int old_mode = fsm_mode;
 
   if (e.lockdown) {
@@ -433,7 +451,7 @@ void WebastoControlFSM::react(ShutdownEvent const &e)
       if (new_mode == fsm_mode) {
         transit<CooldownState>();
       } else {
-        Log.error("Can't shutdown the wrong mode!  %d != %d", e.mode, fsm_mode);
+        LOG_ERROR("Can't shutdown the wrong mode!  %d != %d", e.mode, fsm_mode);
         fram_add_error(0x11);
       }
       break;
@@ -452,7 +470,7 @@ void WebastoControlFSM::react(ShutdownEvent const &e)
       }
       break;
     default:
-      Log.error("Received an unsupported mode: %d", e.mode);
+      LOG_ERROR("Received an unsupported mode: %d", e.mode);
       fsm_mode = old_mode;
       break;
   }
@@ -460,7 +478,7 @@ void WebastoControlFSM::react(ShutdownEvent const &e)
 
 void WebastoControlFSM::react(AddTimeEvent const &e)
 {
-  Log.notice("Received AddTimeEvent: mode %d, %d minutes", e.mode, e.minutes);
+  LOG_NOTICE("Received AddTimeEvent: mode %d, %d minutes", e.mode, e.minutes);
   CoreMutex m(&fsm_mutex);
   int new_mode = e.mode;
   int minutes = e.minutes;
@@ -480,7 +498,7 @@ void WebastoControlFSM::react(AddTimeEvent const &e)
 
 void WebastoControlFSM::react(IgnitionEvent const &e)
 {
-  Log.notice("Received IgnitionEvent: %d", e.enable);
+  LOG_NOTICE("Received IgnitionEvent: %d", e.enable);
 
   CoreMutex m(&fsm_mutex);
 
@@ -502,7 +520,7 @@ void WebastoControlFSM::react(IgnitionEvent const &e)
 
 void WebastoControlFSM::react(StartRunEvent const &e)
 {
-  Log.notice("Received StartRunEvent: %d", e.enable);
+  LOG_NOTICE("Received StartRunEvent: %d", e.enable);
 
   CoreMutex m(&fsm_mutex);
   startRunSignalOn = e.enable;
@@ -522,7 +540,7 @@ void WebastoControlFSM::react(StartRunEvent const &e)
 
 void WebastoControlFSM::react(LockdownEvent const &e)
 {
-  Log.notice("Received LockdownEvent: %d", e.enable);
+  LOG_NOTICE("Received LockdownEvent: %d", e.enable);
 
   if (!e.enable) {
     return;
@@ -542,7 +560,7 @@ void WebastoControlFSM::react(LockdownEvent const &e)
 
 void WebastoControlFSM::react(StartupEvent const &e)
 {
-  Log.notice("Received StartupEvent: mode %d, lockdown: %d", e.mode, lockdown);
+  LOG_NOTICE("Received StartupEvent: mode %d, lockdown: %d", e.mode, lockdown);
   CoreMutex m(&fsm_mutex);
 
   int new_mode = e.mode;
@@ -550,12 +568,12 @@ void WebastoControlFSM::react(StartupEvent const &e)
   int minutes = e.minutes;
 
   if (batteryLow) {
-    Log.warning("Will not start:  battery too low");
+    LOG_WARNING("Will not start:  battery too low");
     return;
   }
 
   if (lockdown) {
-    Log.warning("Will not startup without clearing lockdown (using EmergencyStop while not running)");
+    LOG_WARNING("Will not startup without clearing lockdown (using EmergencyStop while not running)");
     return;
   }
 
@@ -576,7 +594,7 @@ void WebastoControlFSM::react(StartupEvent const &e)
   dispatch(e0);
 
   if (minutes) {
-    globalTimer.register_timer(TIMER_TIMED_SHUT_DOWN, minutes * 60000, &fsmTimerCallback);
+    globalTimer.register_timer(TIMER_TIMED_SHUT_DOWN, minutes * 60000, &fsmTimerCallback, true);
   }
 
   switch(fsm_mode) {
@@ -603,12 +621,21 @@ void WebastoControlFSM::react(StartupEvent const &e)
       }
       break;
     default:
-      Log.error("Received an unsupported mode: %d", e.mode);
+      LOG_ERROR("Received an unsupported mode: %d", e.mode);
       fsm_mode = old_mode;
       break;
   }
 }
 
+void WebastoControlFSM::exit(void)
+{
+  // Anything left queued for the stage we are leaving would otherwise be
+  // delivered as a TimerEvent to whatever state comes next.
+  globalTimer.cancel_timer_id(TIMER_STAGE_COMPLETE);
+  globalTimer.cancel_timer_id(TIMER_STAGE_RETRY);
+  globalTimer.cancel_timer_id(TIMER_FUEL_FAN_DELTA);
+}
+
 void StartupState::entry()
 {
   // Do nothing, we will prime this with a timer event.
@@ -618,7 +645,13 @@ void StartupState::react(TimerEvent const &e)
 {
   switch (e.timerId) {
     case TIMER_FSM_STARTUP:
-      Log.notice("StartupState -> IdleState");
+      if (supervisor_reset.purge) {
+        // The watchdog reset us mid-burn
+        LOG_NOTICE("StartupState -> CooldownState");
+        transit<CooldownState>();
+        break;
+      }
+      LOG_NOTICE("StartupState -> IdleState");
       transit<IdleState>();
       break;
     default:
@@ -629,11 +662,11 @@ void StartupState::react(TimerEvent const &e)
 
 void IdleState::entry()
 {
-  Log.notice("Entering IdleState");
+  LOG_NOTICE("Entering IdleState");
 
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
 
   LedChangeEvent e0;
   e0.operatingChange = true;
@@ -643,8 +676,7 @@ void IdleState::entry()
 
   fsm_mode = 0;
   batteryLow = false;
-  Sensor *ignitionSenseSensor = sensorRegistry.get(CANBUS_ID_IGNITION_SENSE);
-  ignitionOn = ignitionSenseSensor->get_value();
+  ignitionOn = sensor_snapshot_value(CANBUS_ID_IGNITION_SENSE);
 
   // Make sure the vehicle fan is off
   VehicleFanEvent event;
@@ -660,9 +692,8 @@ void PurgingState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-  Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-  int exhaustTemp = exhaustTempSensor->get_value();
+  set_fsm_state(_state_num);
+  int exhaustTemp = sensor_snapshot_value(CANBUS_ID_EXHAUST_TEMP);
 
   if (exhaustTemp > EXHAUST_PURGE_THRESHOLD) {
     // Turn on Combustion Fan at 80%
@@ -671,7 +702,7 @@ void PurgingState::entry()
     dispatch(e1);
 
     // Stay in this state for 3s
-    globalTimer.register_timer(TIMER_STAGE_COMPLETE, 5000, &fsmTimerCallback);
+    globalTimer.register_timer(TIMER_STAGE_COMPLETE, 5000, &fsmTimerCallback, true);
   } else {
     transit<StandbyState>();
   }
@@ -697,32 +728,20 @@ void StandbyState::entry()
 
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-  Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-  exhaustTempPreBurn = exhaustTempSensor->get_value();
+  set_fsm_state(_state_num);
+  exhaustTempPreBurn = sensor_snapshot_value(CANBUS_ID_EXHAUST_TEMP);
 
-  // Turn on the combustion fan - 70%
-  CombustionFanEvent e1;
-  e1.value = 70;
-  dispatch(e1);
-
-  // Turn on the circulation pump
-  CirculationPumpEvent e2;
-  e2.enable = true;
-  dispatch(e2);
-
-  // Set the glow plug to 100%
-  GlowPlugOutEvent e3;
-  e3.value = 100;
-  dispatch(e3);
-
-  // Turn ON the glow plug out.
-  GlowPlugOutEnableEvent e4;
-  e4.enable = true;
-  dispatch(e4);
+  // Combustion fan at 70%, circulation pump on, glow plug out on at 100%
+  actuator_outputs_t outputs = actuators_current();
+  outputs.combustion_fan = 70;
+  outputs.circulation_pump = true;
+  outputs.glow_plug_out_enable = true;
+  outputs.glow_plug_in_enable = false;
+  outputs.glow_plug = 100;
+  actuators_apply(&outputs);
 
   // Stay in this state for 30s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 30000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 30000, &fsmTimerCallback, true);
 
   CoreMutex m1(&fram_mutex);
 
@@ -754,23 +773,19 @@ void PrefuelState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
   priming = true;
 
-  // Turn on Combustion Fan at 15%
-  CombustionFanEvent e1;
-  e1.value = 15;
-  dispatch(e1);
+  // Combustion fan at 15%, fuel pump on to prime
+  int exhaustTemp = sensor_snapshot_value(CANBUS_ID_EXHAUST_TEMP);
 
-  // Turn on Fuel Pump to prime
-  FuelPumpEvent e2;
-  Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-  int exhaustTemp = exhaustTempSensor->get_value();
-  e2.value = map<double>(exhaustTemp, PRIMING_LOW_THRESHOLD, PRIMING_HIGH_THRESHOLD, 3.5, 2.0);
-  dispatch(e2);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.combustion_fan = 15;
+  outputs.fuel_need = map<int>(exhaustTemp, PRIMING_LOW_THRESHOLD, PRIMING_HIGH_THRESHOLD, 350, 200);
+  actuators_apply(&outputs);
 
   // Stay in this state for 3s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 3000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 3000, &fsmTimerCallback, true);
 }
 
 void PrefuelState::react(TimerEvent const &e)
@@ -790,16 +805,16 @@ void FuelOffState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
   priming = false;
 
   // Turn off Fuel Pump
   FuelPumpEvent event;
-  event.value = 0.0;
+  event.value = 0;
   dispatch(event);
 
   // Stay in this stage for 54s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 54000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 54000, &fsmTimerCallback, true);
 }
 
 void FuelOffState::react(TimerEvent const &e)
@@ -818,22 +833,18 @@ void StabilizationState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-  Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-  exhaustTempStable = exhaustTempSensor->get_value();
+  set_fsm_state(_state_num);
+  exhaustTempStable = sensor_snapshot_value(CANBUS_ID_EXHAUST_TEMP);
 
   // Shutdown the glow plug
-  GlowPlugOutEnableEvent e1;
-  e1.enable = false;
-  dispatch(e1);
-
-  GlowPlugOutEvent e2;
-  e2.value = 0;
-  dispatch(e2);
+  actuator_outputs_t outputs = actuators_current();
+  outputs.glow_plug_out_enable = false;
+  outputs.glow_plug = 0;
+  actuators_apply(&outputs);
 
   // Leave Combustion Fan, Fuel Pump and Circulation Pump alone!
   // Stay in this stage for 15s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 2000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 2000, &fsmTimerCallback, true);
 }
 
 void StabilizationState::react(TimerEvent const &e)
@@ -852,22 +863,27 @@ void TestBurnState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-  FuelPumpEvent e1;
-  e1.value = START_FUEL(exhaustTempStable);
-  dispatch(e1);
+  set_fsm_state(_state_num);
 
-  CombustionFanEvent e2;
-  if (combustionFanPercent < START_FAN) {
-    e2.value = combustionFanPercent + 1;
-    globalTimer.register_timer(TIMER_FUEL_FAN_DELTA, 333, &fsmTimerCallback);
+  // New burn:  the coolant loop starts over, and so does the exhaust peak
+  coolant_pi_reset();
+  flame_slope_mark();
+
+  // Start parameters, biased by what earlier starts in this weather taught us
+  int startFan = start_learn_fan(START_FAN);
+
+  actuator_outputs_t outputs = actuators_current();
+  outputs.fuel_need = start_learn_fuel(START_FUEL(exhaustTempStable));
+  if (outputs.combustion_fan < startFan) {
+    outputs.combustion_fan++;
+    globalTimer.register_periodic_timer(TIMER_FUEL_FAN_DELTA, 333, 333, &fsmTimerCallback, true);
   } else {
-    e2.value = START_FAN;
+    outputs.combustion_fan = startFan;
   }
-  dispatch(e2);
+  actuators_apply(&outputs);
 
   // Stay in this state for 15s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 15000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 15000, &fsmTimerCallback, true);
 }
 
 void TestBurnState::react(TimerEvent const &e)
@@ -877,12 +893,14 @@ void TestBurnState::react(TimerEvent const &e)
       {
         CoreMutex m(&fsm_mutex);
 
+        int startFan = start_learn_fan(START_FAN);
+
         CombustionFanEvent event;
-        if (combustionFanPercent < START_FAN) {
+        if (combustionFanPercent < startFan) {
           event.value = combustionFanPercent + 1;
-          globalTimer.register_timer(TIMER_FUEL_FAN_DELTA, 333, &fsmTimerCallback);
         } else {
-          event.value = START_FAN;
+          event.value = startFan;
+          globalTimer.cancel_timer_id(TIMER_FUEL_FAN_DELTA);
         }
         dispatch(event);
       }
@@ -900,7 +918,7 @@ void FlameMeasureState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
 
   // Turn on the Flame Sensor
   GlowPlugInEnableEvent e1;
@@ -908,7 +926,7 @@ void FlameMeasureState::entry()
   dispatch(e1);
 
   // Stay in this state for 20s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 20000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 20000, &fsmTimerCallback, true);
 }
 
 void FlameMeasureState::react(FlameDetectEvent const &e)
@@ -923,6 +941,32 @@ void FlameMeasureState::react(FlameDetectEvent const &e)
   }
 }
 
+void FlameMeasureState::react(ExhaustTempEvent const &e)
+{
+  WebastoControlFSM::react(e);
+
+  CoreMutex m(&fsm_mutex);
+
+  if (fsm_state != _state_num) {
+    // Already shut down for overheating
+    return;
+  }
+
+  // Don't wait out the timers when the exhaust already tells
+  if (flame_slope_lit(exhaustTempStable)) {
+    LOG_NOTICE("Exhaust rising at %d/s, flame established", flame_slope_rate());
+    globalTimer.cancel_timer_id(TIMER_STAGE_RETRY);
+    transit<AutoBurnState>();
+  } else if (flame_slope_cold(exhaustTempPreBurn) || flame_slope_out(exhaustTempPreBurn)) {
+    LOG_NOTICE("Exhaust at %d, %d/s, no flame", e.value, flame_slope_rate());
+    globalTimer.cancel_timer_id(TIMER_STAGE_RETRY);
+
+    FlameoutEvent event;
+    event.resetCount = false;
+    dispatch(event);
+  }
+}
+
 void FlameMeasureState::react(TimerEvent const &e)
 {
   switch (e.timerId) {
@@ -930,16 +974,15 @@ void FlameMeasureState::react(TimerEvent const &e)
       {
         CoreMutex m(&fsm_mutex);
 
-        Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-        int exhaustTemp = exhaustTempSensor->get_value();
-
-        Sensor *flameDetectorSensor = sensorRegistry.get(CANBUS_ID_FLAME_DETECTOR);
-        int flameSensor = flameDetectorSensor->get_value();
+        sensor_snapshot_t snapshot;
+        sensor_snapshot_read(&snapshot);
+        int exhaustTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
+        int flameSensor = sensor_snapshot_get(&snapshot, CANBUS_ID_FLAME_DETECTOR);
 
         if (exhaustTemp - exhaustTempStable >= EXHAUST_TEMP_RISE || flameSensor > FLAME_DETECT_THRESHOLD) {
           transit<AutoBurnState>();
         } else {
-          globalTimer.register_timer(TIMER_STAGE_RETRY, 20000, &fsmTimerCallback);
+          globalTimer.register_timer(TIMER_STAGE_RETRY, 20000, &fsmTimerCallback, true);
         }
       }
       break;
@@ -947,11 +990,10 @@ void FlameMeasureState::react(TimerEvent const &e)
       {
         CoreMutex m(&fsm_mutex);
 
-        Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-        int exhaustTemp = exhaustTempSensor->get_value();
-
-        Sensor *flameDetectorSensor = sensorRegistry.get(CANBUS_ID_FLAME_DETECTOR);
-        int flameSensor = flameDetectorSensor->get_value();
+        sensor_snapshot_t snapshot;
+        sensor_snapshot_read(&snapshot);
+        int exhaustTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
+        int flameSensor = sensor_snapshot_get(&snapshot, CANBUS_ID_FLAME_DETECTOR);
 
         if (exhaustTemp - exhaustTempStable >= EXHAUST_TEMP_RISE || flameSensor > FLAME_DETECT_THRESHOLD) {
           transit<AutoBurnState>();
@@ -962,6 +1004,7 @@ void FlameMeasureState::react(TimerEvent const &e)
           dispatch(event);
         }
       }
+      break;
     default:
       fsmCommonReact(e);
       break;
@@ -972,7 +1015,10 @@ void AutoBurnState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
+
+  // Pick up any throttle map stored in FRAM
+  throttle_map_load();
 
   // Turn off the Flame Sensor
   GlowPlugInEnableEvent e1;
@@ -980,90 +1026,70 @@ void AutoBurnState::entry()
   dispatch(e1);
 
   // Stay in this state for 15s
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 15000, &fsmTimerCallback);
-  globalTimer.register_timer(TIMER_FUEL_FAN_DELTA, 500, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, 15000, &fsmTimerCallback, true);
+  globalTimer.register_periodic_timer(TIMER_FUEL_FAN_DELTA, 500, 500, &fsmTimerCallback, true);
 }
 
-void AutoBurnState::react(TimerEvent const &e)
+void AutoBurnState::react(ExhaustTempEvent const &e)
 {
-  switch (e.timerId) {
-    case TIMER_FUEL_FAN_DELTA:
-      {
-        CoreMutex m(&fsm_mutex);
+  WebastoControlFSM::react(e);
 
-        Sensor *coolantTempSensor = sensorRegistry.get(CANBUS_ID_COOLANT_TEMP_WEBASTO);
-        int coolantTemp = coolantTempSensor->get_value();
+  CoreMutex m(&fsm_mutex);
 
-        Sensor *externalTempSensor = sensorRegistry.get(CANBUS_ID_EXTERNAL_TEMP);
-        int externalTemp = externalTempSensor->get_value();
+  if (fsm_state != _state_num) {
+    // Already shut down for overheating
+    return;
+  }
 
-        Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-        int exhaustTemp = exhaustTempSensor->get_value();
+  // Catch a flameout now rather than at the end of the stage
+  if (flame_slope_out(exhaustTempPreBurn)) {
+    LOG_NOTICE("Exhaust falling at %d/s, flameout", flame_slope_rate());
 
-        int fanRequest = combustionFanPercent;
-        double fuelRequest = fuelNeedRequested;
+    // Counts towards MAX_FLAMEOUT_COUNT, a flame that keeps dying locks out
+    FlameoutEvent event;
+    event.resetCount = false;
+    dispatch(event);
+  }
+}
 
-        if (coolantTemp <= COOLANT_COLD_THRESHOLD) {  // 40C
-          if (fanRequest < THROTTLE_HIGH_FAN) {
-            fanRequest++;
-          }
+void AutoBurnState::react(TimerEvent const &e)
+{
+  switch (e.timerId) {
+    case TIMER_FUEL_FAN_DELTA:
+      {
+        CoreMutex m(&fsm_mutex);
 
-          if (fuelRequest < THROTTLE_HIGH_FUEL(externalTemp)) {
-            fuelRequest++;
-          }
-        } else if (coolantTemp >= COOLANT_IDLE_THRESHOLD || exhaustTemp > EXHAUST_IDLE_THRESHOLD) {
-          fanRequest = THROTTLE_IDLE_FAN;
-          fuelRequest = THROTTLE_IDLE_FUEL;
-        } else {
-          int fanTarget;
-          double fuelTarget;
-
-          if (coolantTemp < COOLANT_MIN_THRESHOLD) {
-            fuelTarget = THROTTLE_HIGH_FUEL(externalTemp);
-            fanTarget = THROTTLE_HIGH_FAN;
-          }
-
-          if (coolantTemp >= COOLANT_MIN_THRESHOLD && coolantTemp < COOLANT_TARGET_TEMP) {
-            fuelTarget = THROTTLE_STEADY_FUEL;
-            fanTarget = THROTTLE_STEADY_FAN;
-          }
-
-          if (coolantTemp >= COOLANT_TARGET_TEMP && coolantTemp < COOLANT_IDLE_THRESHOLD) {
-            fuelTarget = THROTTLE_LOW_FUEL;
-            fanTarget = THROTTLE_LOW_FAN;
-          }
-
-          if (fuelRequest < fuelTarget) {
-            fuelRequest += 0.01;
-          } else if (fuelRequest > fuelTarget) {
-            fuelRequest -= 0.01;
-          }
-
-          if (fanRequest < fanTarget) {
-            fanRequest += 1;
-          } else if (fanRequest > fanTarget) {
-            fanRequest -= 1;
-          }
+        sensor_snapshot_t snapshot;
+        sensor_snapshot_read(&snapshot);
+        int coolantTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_COOLANT_TEMP_WEBASTO);
+        int externalTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXTERNAL_TEMP);
+        int exhaustTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
+
+        coolant_pi_update(coolantTemp, externalTemp, exhaustTemp);
+
+        // Fuel goes straight to the controller's output, the fan catches
+        // up (other than dropping to idle)
+        actuator_outputs_t outputs = actuators_current();
+        outputs.fuel_need = coolant_pi.fuel;
+        flame_slope_fuel(outputs.fuel_need);
+
+        if (coolant_pi.limited == COOLANT_PI_LIMIT_IDLE) {
+          outputs.combustion_fan = coolant_pi.fan;
+        } else if (outputs.combustion_fan < coolant_pi.fan) {
+          outputs.combustion_fan += 1;
+        } else if (outputs.combustion_fan > coolant_pi.fan) {
+          outputs.combustion_fan -= 1;
         }
 
-        CombustionFanEvent e1;
-        e1.value = fanRequest;
-        dispatch(e1);
-
-        FuelPumpEvent e2;
-        e2.value = fuelRequest;
-        dispatch(e2);
-
-        globalTimer.register_timer(TIMER_FUEL_FAN_DELTA, 500, &fsmTimerCallback);
+        actuators_apply(&outputs);
       }
       break;
     case TIMER_STAGE_COMPLETE:
       {
-        Sensor *coolantTempSensor = sensorRegistry.get(CANBUS_ID_COOLANT_TEMP_WEBASTO);
-        int coolantTemp = coolantTempSensor->get_value();
-
-        Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-        int exhaustTemp = exhaustTempSensor->get_value();
+        sensor_snapshot_t snapshot;
+        sensor_snapshot_read(&snapshot);
+        int coolantTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_COOLANT_TEMP_WEBASTO);
+        int exhaustTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
 
         if (exhaustTemp > 4000 && coolantTemp > exhaustTemp) {
           FlameoutEvent event;
@@ -1085,33 +1111,18 @@ void CooldownState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
+  set_fsm_state(_state_num);
   int currentPower = fuelPumpTimer.getBurnPower();
 
-  // Shut off the fuel pump
-  FuelPumpEvent e1;
-  e1.value = 0;
-  dispatch(e1);
-
-  // Turn on the combustion fan at 100%
-  CombustionFanEvent e2;
-  e2.value = 100;
-  dispatch(e2);
-
-  // Ensure the circulation pump is off
-  CirculationPumpEvent e3;
-  e3.enable = false;
-  dispatch(e3);
-
-  // Make sure to shut off the glow plug
-  GlowPlugOutEnableEvent e4;
-  e4.enable = false;
-  dispatch(e4);
-
-  // Make sure to shut off the flame sensor
-  GlowPlugInEnableEvent e5;
-  e5.enable = false;
-  dispatch(e5);
+  // Fuel pump, circulation pump, glow plug and flame sensor off, combustion
+  // fan at 100%
+  actuator_outputs_t outputs = actuators_current();
+  outputs.fuel_need = 0;
+  outputs.combustion_fan = 100;
+  outputs.circulation_pump = false;
+  outputs.glow_plug_out_enable = false;
+  outputs.glow_plug_in_enable = false;
+  actuators_apply(&outputs);
 
   // Clear out the ventilation duration
   ventilation_duration.hours = 0;
@@ -1119,7 +1130,7 @@ void CooldownState::entry()
 
   // Stay in this state for 100s if at partial power, 175s at full power (gonna prorate)
   int timeout = map<int>(currentPower, MIN_POWER, MAX_RATED_POWER, 100000, 175000);
-  globalTimer.register_timer(TIMER_STAGE_COMPLETE, timeout, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_STAGE_COMPLETE, timeout, &fsmTimerCallback, true);
 }
 
 void CooldownState::react(TimerEvent const &e)
@@ -1140,10 +1151,16 @@ void LockdownState::entry()
 {
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-  Log.warning("Entering lockdown mode.  Toggle EmergencyStop to clear");
+  set_fsm_state(_state_num);
+  LOG_WARNING("Entering lockdown mode.  Toggle EmergencyStop to clear");
   beeper.register_beeper(10, 500, 500);
-  globalTimer.register_timer(TIMER_RESTART_BEEPS, 20000, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_RESTART_BEEPS, 20000, &fsmTimerCallback, true);
+}
+
+void LockdownState::exit()
+{
+  WebastoControlFSM::exit();
+  globalTimer.cancel_timer_id(TIMER_RESTART_BEEPS);
 }
 
 void LockdownState::react(TimerEvent const &e)
@@ -1153,7 +1170,7 @@ void LockdownState::react(TimerEvent const &e)
   switch (e.timerId) {
     case TIMER_RESTART_BEEPS:
       beeper.register_beeper(10, 500, 500);
-      globalTimer.register_timer(TIMER_RESTART_BEEPS, 20000, &fsmTimerCallback);
+      globalTimer.register_timer(TIMER_RESTART_BEEPS, 20000, &fsmTimerCallback, true);
       break;
 
     default:
@@ -1165,40 +1182,13 @@ void LockdownState::react(TimerEvent const &e)
 
 void EmergencyOffState::entry()
 {
-  Log.notice("Entering EmergencyOffState");
+  LOG_NOTICE("Entering EmergencyOffState");
   CoreMutex m(&fsm_mutex);
 
-  fsm_state = _state_num;
-
-  // Shut off the fuel pump
-  FuelPumpEvent e1;
-  e1.value = 0;
-  dispatch(e1);
-
-  // Turn off the combustion fan
-  CombustionFanEvent e2;
-  e2.value = 0;
-  dispatch(e2);
-
-  // Ensure the circulation pump is off
-  CirculationPumpEvent e3;
-  e3.enable = false;
-  dispatch(e3);
+  set_fsm_state(_state_num);
 
-  // Make sure to shut off the glow plug
-  GlowPlugOutEnableEvent e4;
-  e4.enable = false;
-  dispatch(e4);
-
-  // Make sure to shut off the flame sensor
-  GlowPlugInEnableEvent e5;
-  e5.enable = false;
-  dispatch(e5);
-
-  // Shut off the vehicle fan
-  VehicleFanEvent e6;
-  e6.value = 0;
-  dispatch(e6);
+  // Everything off, rewriting the pins even if we think they already are
+  actuators_force_off();
 
   LockdownEvent e7;
   e7.enable = true;
@@ -1218,17 +1208,17 @@ void EmergencyOffState::entry()
 
 void fsmTimerCallback(int timer_id, int delay)
 {
-  Log.info("FSM callback: %d", timer_id);
+  LOG_NOTICE("FSM callback: %d", timer_id);
 
   TimerEvent event;
   event.value = delay;
   event.timerId = timer_id;
-  WebastoControlFSM::dispatch(event);
+  fsm_post(event);
 }
 
 void kickRunTimer(void)
 {
-  globalTimer.register_timer(TIMER_RUN_TIME_MINUTE, 60000, &fsmTimerCallback);
+  globalTimer.register_periodic_timer(TIMER_RUN_TIME_MINUTE, 60000, 60000, &fsmTimerCallback, true);
 }
 
 void increment_minutes(time_sensor_t *time)
@@ -1260,12 +1250,12 @@ void fsmCommonReact(TimerEvent const &e)
       {
         CoreMutex m(&fsm_mutex);
         if (!fsm_mode) {
+          globalTimer.cancel_timer_id(TIMER_RUN_TIME_MINUTE);
           break;
         }
 
         CoreMutex m2(&fram_mutex);
 
-        kickRunTimer();
         time_sensor_t *time;
         int currentPower = fuelPumpTimer.getBurnPower();
         int bin = currentPower * 3 / MAX_RATED_POWER;
@@ -1317,7 +1307,7 @@ void fsmCommonReact(TimerEvent const &e)
 
 void init_fsm(void)
 {
-  Log.notice("Starting FSM");
+  LOG_NOTICE("Starting FSM");
   mutex_init(&fsm_mutex);
 
   flameLed = false;
@@ -1328,41 +1318,9 @@ void init_fsm(void)
 
   WebastoControlFSM::start();
 
-  // this is an open drain output.  default is off = input with pullup
-  pinMode(PIN_GLOW_PLUG_IN_EN, INPUT);
-  GlowPlugInEnableEvent e1;
-  e1.enable = false;
-  WebastoControlFSM::dispatch(e1);
-
-  // this is an open drain output.  default is off = input with pullup
-  pinMode(PIN_GLOW_PLUG_OUT_EN, INPUT);
-  GlowPlugOutEnableEvent e2;
-  e2.enable = false;
-  WebastoControlFSM::dispatch(e2);
-
-  pinMode(PIN_CIRCULATION_PUMP, OUTPUT);
-  CirculationPumpEvent e3;
-  e3.enable = false;
-  WebastoControlFSM::dispatch(e3);
-
-  pinMode(PIN_COMBUSTION_FAN, OUTPUT);
-  CombustionFanEvent e4;
-  e4.value = 0;
-  WebastoControlFSM::dispatch(e4);
-
-  pinMode(PIN_GLOW_PLUG_OUT, OUTPUT);
-  GlowPlugOutEvent e5;
-  e5.value = 0;
-  WebastoControlFSM::dispatch(e5);
-
-  // Setup is in the FuelPumpTimer class
-  FuelPumpEvent e6;
-  e6.value = 0.0;
-  WebastoControlFSM::dispatch(e6);
-
-  VehicleFanEvent e7;
-  e7.value = 0;
-  WebastoControlFSM::dispatch(e7);
+  init_actuators();
+  init_state_stats();
+  init_start_learn();
 
   CoreMutex m(&fsm_mutex);
   //CoreMutex m(&fram_mutex);
@@ -1370,7 +1328,11 @@ void init_fsm(void)
   lockdown = false;
 
   fsm_init = true;
-  globalTimer.register_timer(TIMER_FSM_STARTUP, 10, &fsmTimerCallback);
+  globalTimer.register_timer(TIMER_FSM_STARTUP, 10, &fsmTimerCallback, true);
 }
 
 FSM_INITIAL_STATE(WebastoControlFSM, StartupState)
+
+#define FSM_INSTANTIATE_DISPATCH(_EVENT)  FSM_TABLE_INSTANTIATE(WebastoControlFSM, _EVENT)
+FSM_EVENT_TYPES(FSM_INSTANTIATE_DISPATCH)
+#undef FSM_INSTANTIATE_DISPATCH
@@ -1,27 +1,27 @@
 #ifndef __fsm_h_
 #define __fsm_h_
 
-#include "tinyfsm.hpp"
+#include "fsm_engine.h"
 #include "fsm_events.h"
 #include "fuel_pump.h"
 #include "fram.h"
 
-class WebastoControlFSM : public tinyfsm::Fsm<WebastoControlFSM>
+class WebastoControlFSM : public fsm_engine::Fsm<WebastoControlFSM>
 {
   public:
     // default reaction for unhandled events */
-    void react(tinyfsm::Event const &) { };
+    void react(fsm_engine::Event const &) { };
 
-    virtual void react(TimerEvent         const &);
+    FSM_VIRTUAL void react(TimerEvent         const &);
 
-    virtual void react(FlameDetectEvent   const &);
-    virtual void react(EmergencyStopEvent const &);
-    virtual void react(CoolantTempEvent   const &);
-    virtual void react(OutdoorTempEvent   const &);
-    virtual void react(ExhaustTempEvent   const &);
-    virtual void react(InternalTempEvent  const &);
-    virtual void react(BatteryLevelEvent  const &);
-    virtual void react(VSYSLevelEvent     const &);
+    FSM_VIRTUAL void react(FlameDetectEvent   const &);
+    FSM_VIRTUAL void react(EmergencyStopEvent const &);
+    FSM_VIRTUAL void react(CoolantTempEvent   const &);
+    FSM_VIRTUAL void react(OutdoorTempEvent   const &);
+    FSM_VIRTUAL void react(ExhaustTempEvent   const &);
+    FSM_VIRTUAL void react(InternalTempEvent  const &);
+    FSM_VIRTUAL void react(BatteryLevelEvent  const &);
+    FSM_VIRTUAL void react(VSYSLevelEvent     const &);
 
     void react(RestartEvent               const &);
     void react(ShutdownEvent              const &);
@@ -44,10 +44,15 @@ class WebastoControlFSM : public tinyfsm::Fsm<WebastoControlFSM>
     void react(OverheatEvent              const &);
     void react(LedChangeEvent             const &);
 
-    virtual void entry(void)  { };
-    void exit(void)  { };
+    FSM_VIRTUAL void entry(void)  { };
+    FSM_VIRTUAL void exit(void);
 };
 
+// With the table engine, dispatch() is only instantiated in fsm.cpp
+#define FSM_EXTERN_DISPATCH(_EVENT)  FSM_TABLE_EXTERN(WebastoControlFSM, _EVENT)
+FSM_EVENT_TYPES(FSM_EXTERN_DISPATCH)
+#undef FSM_EXTERN_DISPATCH
+
 extern uint8_t fsm_state;
 extern int fsm_mode;
 extern bool batteryLow;
@@ -61,11 +66,15 @@ extern bool circulationPumpOn;
 extern int combustionFanPercent;
 extern int vehicleFanPercent;
 extern int glowPlugPercent;
-extern float fuelNeedRequested;
+extern int fuelNeedRequested;   // fuel need * 100
 
 extern bool glowPlugInEnable;   // mutually exclusive with glowPlugOutEnable
 extern bool glowPlugOutEnable;  // mutually exclusive with glowPlugInEnable
 
+extern bool flameLed;
+extern bool operatingLed;
+extern bool priming;
+
 extern time_sensor_t ventilation_duration;
 
 extern int flameOutCount;
@@ -77,6 +86,8 @@ extern bool fsm_init;
 extern mutex_t fsm_mutex;
 
 
+void set_fsm_state(uint8_t state);
+bool fsm_state_may_be_burning(uint8_t state);
 void set_open_drain_pin(int pinNum, int value);
 void fsmTimerCallback(int timer_id, int delay);
 void fsmCommonReact(TimerEvent const&);
@@ -0,0 +1,31 @@
+#ifndef __fsm_engine_h_
+#define __fsm_engine_h_
+
+// Which FSM engine runs WebastoControlFSM.  The default is tinyfsm (virtual
+// react() overloads), -DFSM_TABLE_ENGINE selects the table-driven one in
+// fsm_table.h.  The state classes are the same for both.
+
+#ifdef FSM_TABLE_ENGINE
+
+#include "fsm_table.h"
+
+namespace fsm_engine = fsmtable;
+
+#define FSM_VIRTUAL
+
+#else
+
+#include "tinyfsm.hpp"
+
+namespace fsm_engine = tinyfsm;
+
+#define FSM_VIRTUAL virtual
+
+// tinyfsm finds the states through the vtable, so none of these are needed
+#define FSM_STATE_LIST(_FSM, ...)
+#define FSM_TABLE_EXTERN(_FSM, _EVENT)
+#define FSM_TABLE_INSTANTIATE(_FSM, _EVENT)
+
+#endif
+
+#endif
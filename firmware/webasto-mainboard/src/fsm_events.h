@@ -1,9 +1,9 @@
 #ifndef __fsm_events_h_
 #define __fsm_events_h_
 
-#include "tinyfsm.hpp"
+#include "fsm_engine.h"
 
-struct BooleanEvent       : tinyfsm::Event {
+struct BooleanEvent       : fsm_engine::Event {
   bool enable;
 };
 struct IgnitionEvent            : BooleanEvent { };
@@ -18,7 +18,7 @@ struct LedChangeEvent           : BooleanEvent {
   bool flameChange;
 };
 
-struct IntegerEvent       : tinyfsm::Event {
+struct IntegerEvent       : fsm_engine::Event {
   int value;
 };
 struct CombustionFanEvent : IntegerEvent { };
@@ -36,18 +36,15 @@ struct TimerEvent         : IntegerEvent {
   int timerId;
 };
 
-struct DoubleEvent       : tinyfsm::Event {
-  double value;
-};
-struct FuelPumpEvent      : DoubleEvent { };
+struct FuelPumpEvent      : IntegerEvent { };   // fuel need * 100
 
-struct FlameoutEvent      : tinyfsm::Event {
+struct FlameoutEvent      : fsm_engine::Event {
   bool resetCount;
 };
-struct RestartEvent       : tinyfsm::Event { };
-struct OverheatEvent      : tinyfsm::Event { };
+struct RestartEvent       : fsm_engine::Event { };
+struct OverheatEvent      : fsm_engine::Event { };
 
-struct ModeChangeEvent    : tinyfsm::Event {
+struct ModeChangeEvent    : fsm_engine::Event {
   int mode;
   int minutes;
 };
@@ -58,5 +55,16 @@ struct ShutdownEvent      : ModeChangeEvent {
 struct StartupEvent       : ModeChangeEvent { };
 struct AddTimeEvent       : ModeChangeEvent { };
 
+// Every event WebastoControlFSM reacts to
+#define FSM_EVENT_TYPES(X) \
+  X(TimerEvent) X(FlameDetectEvent) X(EmergencyStopEvent) X(CoolantTempEvent) \
+  X(OutdoorTempEvent) X(ExhaustTempEvent) X(InternalTempEvent) \
+  X(BatteryLevelEvent) X(VSYSLevelEvent) X(RestartEvent) X(ShutdownEvent) \
+  X(StartupEvent) X(FlameoutEvent) X(AddTimeEvent) X(IgnitionEvent) \
+  X(StartRunEvent) X(GlowPlugInEnableEvent) X(GlowPlugOutEnableEvent) \
+  X(CirculationPumpEvent) X(CombustionFanEvent) X(GlowPlugOutEvent) \
+  X(FuelPumpEvent) X(VehicleFanEvent) X(LockdownEvent) X(OverheatEvent) \
+  X(LedChangeEvent)
+
 #endif
 
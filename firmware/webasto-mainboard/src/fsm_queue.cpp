@@ -0,0 +1,242 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <pico/util/queue.h>
+
+#include "fsm_queue.h"
+#include "fsm.h"
+#include "global_timer.h"
+#include "flight_recorder.h"
+#include "latency_probe.h"
+
+static queue_t fsm_queue;
+static bool fsm_queue_ready = false;
+
+// Written by producers on either core:  treat as approximate
+static volatile uint32_t fsm_queue_posted = 0;
+static volatile uint32_t fsm_queue_dropped = 0;
+static volatile uint16_t fsm_queue_high_water = 0;
+
+static volatile uint32_t fsm_queue_coalesced = 0;
+
+// Only touched by the consumer on core1
+static uint32_t fsm_queue_dispatched = 0;
+
+// One producer per type, the consumer on core1.  The value is written before
+// the pending flag is set, and pending is cleared before the value is read,
+// so the worst a race can do is dispatch the newest value twice.
+typedef struct {
+  volatile int value;
+  volatile bool pending;
+} fsm_coalesce_slot_t;
+
+static fsm_coalesce_slot_t fsm_coalesce_slots[FSM_COALESCED_COUNT];
+
+void fsm_queue_init(void)
+{
+  queue_init(&fsm_queue, sizeof(fsmQueuedEvent_t), FSM_EVENT_QUEUE_SIZE);
+  fsm_queue_ready = true;
+}
+
+static bool fsm_queue_add(fsmQueuedEvent_t *item)
+{
+  if (!fsm_queue_ready || !queue_try_add(&fsm_queue, item)) {
+    fsm_queue_dropped++;
+    return false;
+  }
+
+  fsm_queue_posted++;
+
+  uint16_t level = queue_get_level(&fsm_queue);
+  if (level > fsm_queue_high_water) {
+    fsm_queue_high_water = level;
+  }
+
+  // Core1 may be asleep in globalTimer.wait()
+  globalTimer.wake();
+  return true;
+}
+
+#define FSM_EVENT_POST_IMPL(event_type, member) \
+  bool fsm_post(event_type const &event) \
+  { \
+    fsmQueuedEvent_t item; \
+    item.type = FSM_EVENT_##event_type; \
+    item.member = event; \
+    return fsm_queue_add(&item); \
+  }
+
+FSM_QUEUED_EVENTS(FSM_EVENT_POST_IMPL)
+
+static bool fsm_coalesce(int slot_num, int value)
+{
+  fsm_coalesce_slot_t *slot = &fsm_coalesce_slots[slot_num];
+
+  slot->value = value;
+  __dmb();
+
+  if (slot->pending) {
+    fsm_queue_coalesced++;
+  } else {
+    slot->pending = true;
+    fsm_queue_posted++;
+  }
+
+  globalTimer.wake();
+  return true;
+}
+
+#define FSM_EVENT_COALESCE_IMPL(event_type, member) \
+  bool fsm_post(event_type const &event) \
+  { \
+    return fsm_coalesce(FSM_EVENT_##event_type, event.value); \
+  }
+
+FSM_COALESCED_EVENTS(FSM_EVENT_COALESCE_IMPL)
+
+static bool fsm_take_coalesced(int slot_num, int *value)
+{
+  fsm_coalesce_slot_t *slot = &fsm_coalesce_slots[slot_num];
+
+  if (!slot->pending) {
+    return false;
+  }
+
+  slot->pending = false;
+  __dmb();
+  *value = slot->value;
+  return true;
+}
+
+// What the flight recorder keeps of each dispatched event.  The fuel/fan
+// ramp timer is left out:  it fires several times a second, and the output
+// changes it causes are recorded anyways.
+static inline void fsm_record_event(int type, IntegerEvent const &e)
+{
+  flight_recorder_add(FLIGHT_EVENT, type, e.value);
+}
+
+static inline void fsm_record_event(int type, BooleanEvent const &e)
+{
+  flight_recorder_add(FLIGHT_EVENT, type, e.enable);
+}
+
+static inline void fsm_record_event(int type, ModeChangeEvent const &e)
+{
+  flight_recorder_add(FLIGHT_EVENT, type, e.mode);
+}
+
+static inline void fsm_record_event(int type, TimerEvent const &e)
+{
+  if (e.timerId != TIMER_FUEL_FAN_DELTA) {
+    flight_recorder_add(FLIGHT_EVENT, type, e.timerId);
+  }
+}
+
+static inline void fsm_record_event(int, FlameDetectEvent const &e)
+{
+  flight_recorder_sample(FLIGHT_SAMPLE_FLAME_DETECT, e.value);
+}
+
+// Which latency path (if any) a queued event closes
+static inline int fsm_latency_path(fsm_engine::Event const &)
+{
+  return -1;
+}
+
+static inline int fsm_latency_path(EmergencyStopEvent const &)
+{
+  return LATENCY_PATH_EMERGENCY_STOP;
+}
+
+static inline int fsm_latency_path(IgnitionEvent const &)
+{
+  return LATENCY_PATH_IGNITION;
+}
+
+static inline int fsm_latency_path(StartRunEvent const &)
+{
+  return LATENCY_PATH_START_RUN;
+}
+
+#define FSM_EVENT_DISPATCH(event_type, member) \
+  case FSM_EVENT_##event_type: \
+    fsm_record_event(FSM_EVENT_##event_type, item.member); \
+    latency_probe_react(fsm_latency_path(item.member)); \
+    WebastoControlFSM::dispatch(item.member); \
+    latency_probe_react_done(); \
+    break;
+
+#define FSM_EVENT_DISPATCH_COALESCED(event_type, member) \
+  { \
+    event_type event; \
+    if (fsm_take_coalesced(FSM_EVENT_##event_type, &event.value)) { \
+      flight_recorder_sample(FSM_EVENT_##event_type, event.value); \
+      WebastoControlFSM::dispatch(event); \
+      fsm_queue_dispatched++; \
+      count++; \
+    } \
+  }
+
+int fsm_process_events(void)
+{
+  // Producers can keep the queue topped up, so bound the work per call.
+  int count;
+  fsmQueuedEvent_t item;
+
+  if (!fsm_queue_ready || !fsm_init) {
+    return 0;
+  }
+
+  for (count = 0; count < FSM_EVENT_QUEUE_SIZE && queue_try_remove(&fsm_queue, &item); count++) {
+    switch (item.type) {
+      FSM_QUEUED_EVENTS(FSM_EVENT_DISPATCH)
+      default:
+        break;
+    }
+    fsm_queue_dispatched++;
+  }
+
+  // Then the newest of each analogue reading
+  FSM_COALESCED_EVENTS(FSM_EVENT_DISPATCH_COALESCED)
+
+  return count;
+}
+
+int fsm_queue_depth(void)
+{
+  return fsm_queue_ready ? queue_get_level(&fsm_queue) : 0;
+}
+
+// Anything for fsm_process_events() to do, queued or coalesced
+bool fsm_events_pending(void)
+{
+  if (fsm_queue_depth()) {
+    return true;
+  }
+
+  for (int i = 0; i < FSM_COALESCED_COUNT; i++) {
+    if (fsm_coalesce_slots[i].pending) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void fsm_queue_get_stats(fsm_queue_stats_t *stats)
+{
+  stats->posted = fsm_queue_posted;
+  stats->dispatched = fsm_queue_dispatched;
+  stats->dropped = fsm_queue_dropped;
+  stats->coalesced = fsm_queue_coalesced;
+  stats->high_water = fsm_queue_high_water;
+}
+
+void fsm_queue_reset_stats(void)
+{
+  fsm_queue_posted = 0;
+  fsm_queue_dispatched = 0;
+  fsm_queue_dropped = 0;
+  fsm_queue_coalesced = 0;
+  fsm_queue_high_water = fsm_queue_depth();
+}
@@ -0,0 +1,82 @@
+#ifndef __fsm_queue_h_
+#define __fsm_queue_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "fsm_events.h"
+
+// Events from outside the FSM (sensors, CAN, W-Bus, timers) are posted here
+// and dispatched one at a time on core1 by fsm_process_events().  Posting
+// never blocks on FSM work, and never blocks at all:  a full queue drops the
+// event and counts it.  Reactions dispatching further events from inside the
+// FSM still do so synchronously.
+//
+// Periodic analogue readings don't go through the queue:  each type has a
+// single slot, and a new sample overwrites one not yet dispatched, so a burst
+// collapses into one reaction with the newest value.  Everything else (edges,
+// commands, timers) is queued losslessly.
+#ifndef FSM_EVENT_QUEUE_SIZE
+#define FSM_EVENT_QUEUE_SIZE  32
+#endif
+
+// Every event type that is queued, and its member in fsmQueuedEvent_t
+#define FSM_QUEUED_EVENTS(X) \
+  X(TimerEvent,         timer) \
+  X(FlameDetectEvent,   flameDetect) \
+  X(EmergencyStopEvent, emergencyStop) \
+  X(IgnitionEvent,      ignition) \
+  X(StartRunEvent,      startRun) \
+  X(ShutdownEvent,      shutdown) \
+  X(StartupEvent,       startup) \
+  X(AddTimeEvent,       addTime)
+
+// Every event type that is coalesced (all IntegerEvents)
+#define FSM_COALESCED_EVENTS(X) \
+  X(CoolantTempEvent,   coolantTemp) \
+  X(OutdoorTempEvent,   outdoorTemp) \
+  X(ExhaustTempEvent,   exhaustTemp) \
+  X(InternalTempEvent,  internalTemp) \
+  X(BatteryLevelEvent,  batteryLevel) \
+  X(VSYSLevelEvent,     vsysLevel)
+
+#define FSM_EVENT_ENUM(event_type, member)   FSM_EVENT_##event_type,
+#define FSM_EVENT_MEMBER(event_type, member) event_type member;
+#define FSM_EVENT_POST(event_type, member)   bool fsm_post(event_type const &event);
+
+enum {
+  FSM_QUEUED_EVENTS(FSM_EVENT_ENUM)
+  FSM_EVENT_COUNT,
+};
+
+enum {
+  FSM_COALESCED_EVENTS(FSM_EVENT_ENUM)
+  FSM_COALESCED_COUNT,
+};
+
+typedef struct {
+  uint8_t type;
+  union {
+    FSM_QUEUED_EVENTS(FSM_EVENT_MEMBER)
+  };
+} fsmQueuedEvent_t;
+
+typedef struct {
+  uint32_t posted;
+  uint32_t dispatched;
+  uint32_t dropped;
+  uint32_t coalesced;   // samples overwritten before they were dispatched
+  uint16_t high_water;
+} fsm_queue_stats_t;
+
+void fsm_queue_init(void);
+FSM_QUEUED_EVENTS(FSM_EVENT_POST)
+FSM_COALESCED_EVENTS(FSM_EVENT_POST)
+int fsm_process_events(void);
+
+int fsm_queue_depth(void);
+bool fsm_events_pending(void);
+void fsm_queue_get_stats(fsm_queue_stats_t *stats);
+void fsm_queue_reset_stats(void);
+
+#endif
@@ -1,8 +1,13 @@
 #ifndef __fsm_state_h_
 #define __fsm_state_h_
 
-#include "tinyfsm.hpp"
+#include "fsm_engine.h"
 #include "fsm.h"
+#include "state_names.h"
+
+// Each state reports itself over W-Bus as _state_num, and that is also what
+// fsm_state holds.  Anything outside the FSM that needs to tell the states
+// apart uses the same WB_STATE_* names.
 
 class StartupState : public WebastoControlFSM
 {
@@ -10,7 +15,7 @@ class StartupState : public WebastoControlFSM
     void entry();
     void react(TimerEvent const &e);
   protected:
-    const static uint8_t _state_num = 0x00;
+    const static uint8_t _state_num = WB_STATE_BO;
 
 };
 
@@ -19,7 +24,7 @@ class IdleState : public WebastoControlFSM
   public:
     void entry();
   protected:
-    const static uint8_t _state_num = 0x04;
+    const static uint8_t _state_num = WB_STATE_OFF;
 
 };
 
@@ -30,7 +35,7 @@ class PurgingState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x23;
+    const static uint8_t _state_num = WB_STATE_PURGE;
 };
 
 class StandbyState : public WebastoControlFSM
@@ -40,7 +45,7 @@ class StandbyState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x3D;
+    const static uint8_t _state_num = WB_STATE_PRES;
 };
 
 class PrefuelState : public WebastoControlFSM
@@ -50,7 +55,7 @@ class PrefuelState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x2D;
+    const static uint8_t _state_num = WB_STATE_PSFS;
 };
 
 class FuelOffState : public WebastoControlFSM
@@ -60,7 +65,7 @@ class FuelOffState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x3e;
+    const static uint8_t _state_num = WB_STATE_PREIGN;
 };
 
 class StabilizationState : public WebastoControlFSM
@@ -70,7 +75,7 @@ class StabilizationState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x25;
+    const static uint8_t _state_num = WB_STATE_STAB;
 };
 
 class TestBurnState : public WebastoControlFSM
@@ -80,7 +85,7 @@ class TestBurnState : public WebastoControlFSM
     void react(TimerEvent       const &e);
 
   protected:
-    const static uint8_t _state_num = 0x40;
+    const static uint8_t _state_num = WB_STATE_FSTAB;
 };
 
 class FlameMeasureState : public WebastoControlFSM
@@ -89,9 +94,10 @@ class FlameMeasureState : public WebastoControlFSM
     void entry();
     void react(TimerEvent const &e);
     void react(FlameDetectEvent const &e);
+    void react(ExhaustTempEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x11;
+    const static uint8_t _state_num = WB_STATE_FDM;
 };
 
 class AutoBurnState : public WebastoControlFSM
@@ -99,9 +105,10 @@ class AutoBurnState : public WebastoControlFSM
   public:
     void entry();
     void react(TimerEvent       const &e);
+    void react(ExhaustTempEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x41;
+    const static uint8_t _state_num = WB_STATE_PH;
 };
 
 class CooldownState : public WebastoControlFSM
@@ -111,17 +118,18 @@ class CooldownState : public WebastoControlFSM
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x1C;
+    const static uint8_t _state_num = WB_STATE_VENT;
 };
 
 class LockdownState : public WebastoControlFSM
 {
   public:
     void entry();
+    void exit();
     void react(TimerEvent const &e);
 
   protected:
-    const static uint8_t _state_num = 0x28;
+    const static uint8_t _state_num = WB_STATE_LOCK2;
 };
 
 class EmergencyOffState : public WebastoControlFSM
@@ -130,8 +138,13 @@ class EmergencyOffState : public WebastoControlFSM
     void entry();
 
   protected:
-    const static uint8_t _state_num = 0x02;
+    const static uint8_t _state_num = WB_STATE_BOADR;
 };
 
+// The table engine numbers the states in this order
+FSM_STATE_LIST(WebastoControlFSM, StartupState, IdleState, PurgingState,
+               StandbyState, PrefuelState, FuelOffState, StabilizationState,
+               TestBurnState, FlameMeasureState, AutoBurnState, CooldownState,
+               LockdownState, EmergencyOffState)
 
 #endif
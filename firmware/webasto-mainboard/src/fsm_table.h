@@ -0,0 +1,166 @@
+#ifndef __fsm_table_h_
+#define __fsm_table_h_
+
+#include <stdint.h>
+#include <type_traits>
+
+// Table-driven stand-in for tinyfsm::Fsm, selected with -DFSM_TABLE_ENGINE
+// (see fsm_engine.h).  Same surface (start, dispatch, transit, is_in_state,
+// state, FSM_INITIAL_STATE) and the same state classes, but nothing is
+// virtual and nothing needs RTTI:
+//
+// - the states are numbered by their position in FSM_STATE_LIST(), and the
+//   current state is that number
+// - each event type has a constexpr table, one entry per state, of plain
+//   functions calling that state's own react() overload if it declares one,
+//   and the base class's otherwise.  dispatch() is one indexed call, or a
+//   direct call to the base class when no state overrides the event, which
+//   is most of them.
+// - entry() and exit() go through tables the same way
+//
+// dispatch() needs the complete state list, so it is only instantiated in
+// the file that has it (FSM_TABLE_INSTANTIATE), and declared extern
+// everywhere else (FSM_TABLE_EXTERN).
+
+namespace fsmtable {
+
+struct Event { };
+
+template <typename... S>
+struct StateList {
+  static constexpr int count = sizeof...(S);
+};
+
+// Specialized by FSM_STATE_LIST() with the states of machine F
+template <typename F>
+struct States;
+
+template <typename S, typename List>
+struct StateIndex;
+
+template <typename S, typename... Rest>
+struct StateIndex<S, StateList<S, Rest...>> {
+  static constexpr uint8_t value = 0;
+};
+
+template <typename S, typename T, typename... Rest>
+struct StateIndex<S, StateList<T, Rest...>> {
+  static constexpr uint8_t value = 1 + StateIndex<S, StateList<Rest...>>::value;
+};
+
+template <typename S>
+struct Instance {
+  static S value;
+};
+
+template <typename S>
+S Instance<S>::value;
+
+// S::react(E) if S declares it, the base class's F::react(E) otherwise.  The
+// base class has no state of its own, so every state that leaves an event
+// to it shares one entry, called on F's instance.
+// The class declaring the react(E) that &S::react finds
+template <typename E, typename C>
+C react_owner(void (C::*)(E const &));
+
+template <typename F, typename S, typename E, typename = void>
+struct Reactor {
+  static void call(E const &event) { Instance<F>::value.F::react(event); }
+  typedef Reactor<F, F, E> shared;
+};
+
+template <typename F, typename S, typename E>
+struct Reactor<F, S, E, typename std::enable_if<std::is_same<decltype(react_owner<E>(&S::react)), S>::value>::type> {
+  static void call(E const &event) { Instance<S>::value.react(event); }
+  typedef Reactor<F, S, E> shared;
+};
+
+template <typename S>
+struct Stage {
+  static void entry(void) { Instance<S>::value.entry(); }
+  static void exit(void) { Instance<S>::value.exit(); }
+};
+
+template <typename F, typename E, typename List = typename States<F>::list>
+struct ReactTable;
+
+template <typename F, typename E, typename... S>
+struct ReactTable<F, E, StateList<S...>> {
+  static constexpr bool overridden = (!std::is_same<typename Reactor<F, S, E>::shared, Reactor<F, F, E>>::value || ...);
+  static constexpr void (*react[sizeof...(S)])(E const &) = { &Reactor<F, S, E>::shared::call... };
+};
+
+template <typename F, typename List = typename States<F>::list>
+struct StageTable;
+
+template <typename F, typename... S>
+struct StageTable<F, StateList<S...>> {
+  static constexpr void (*entry[sizeof...(S)])(void) = { &Stage<S>::entry... };
+  static constexpr void (*exit[sizeof...(S)])(void) = { &Stage<S>::exit... };
+};
+
+template <typename F>
+class Fsm {
+  public:
+    template <typename S>
+    static S &state(void) { return Instance<S>::value; };
+
+    template <typename S>
+    static bool is_in_state(void) { return _current == StateIndex<S, typename States<F>::list>::value; };
+
+    static void set_initial_state(void);
+    static void enter(void) { StageTable<F>::entry[_current](); };
+    static void start(void) { set_initial_state(); enter(); };
+
+    template <typename E>
+    static void dispatch(E const &event);
+
+  protected:
+    template <typename S>
+    void transit(void)
+    {
+      StageTable<F>::exit[_current]();
+      _current = StateIndex<S, typename States<F>::list>::value;
+      StageTable<F>::entry[_current]();
+    };
+
+    template <typename S>
+    static void set_current(void) { _current = StateIndex<S, typename States<F>::list>::value; };
+
+  private:
+    static uint8_t _current;
+};
+
+template <typename F>
+uint8_t Fsm<F>::_current = 0;
+
+template <typename F>
+template <typename E>
+void Fsm<F>::dispatch(E const &event)
+{
+  if constexpr (ReactTable<F, E>::overridden) {
+    ReactTable<F, E>::react[_current](event);
+  } else {
+    Reactor<F, F, E>::call(event);
+  }
+}
+
+}
+
+#define FSM_STATE_LIST(_FSM, ...) \
+  namespace fsmtable { \
+    template <> struct States<_FSM> { typedef StateList<__VA_ARGS__> list; }; \
+  }
+
+#define FSM_INITIAL_STATE(_FSM, _STATE) \
+  namespace fsmtable { \
+    template <> void Fsm<_FSM>::set_initial_state(void) { set_current<_STATE>(); } \
+  }
+
+#define FSM_TABLE_EXTERN(_FSM, _EVENT) \
+  extern template void fsmtable::Fsm<_FSM>::dispatch<_EVENT>(_EVENT const &);
+
+#define FSM_TABLE_INSTANTIATE(_FSM, _EVENT) \
+  template void fsmtable::Fsm<_FSM>::dispatch<_EVENT>(_EVENT const &);
+
+#endif
@@ -15,21 +15,37 @@ void FuelPumpTimer::abort(void) {
 }
 
 void FuelPumpTimer::timerCallback(int timer_id, int delayed) {
-  (void)timer_id;
-  if (_next_level) {
+  (void)delayed;
+
+  // Two periodic timers with the same period, offset by the pulse length:
+  // TIMER_FUEL_PUMP raises the pin, TIMER_FUEL_PUMP_OFF drops it.
+  if (timer_id == TIMER_FUEL_PUMP_OFF) {
+    digitalWrite(PIN_FUEL_PUMP, LOW);
+    return;
+  }
+
+  // Period changes are only picked up on a rising edge.
+  if (_next_period != _period) {
     _period = _next_period;
     if (!_period) {
-      digitalWrite(PIN_FUEL_PUMP, LOW);
-      _enabled = false;
+      stop();
       return;
     }
-    digitalWrite(PIN_FUEL_PUMP, HIGH);
-    globalTimer.register_timer(TIMER_FUEL_PUMP, FUEL_PUMP_PULSE_LEN, _cb);
-  } else {
-    digitalWrite(PIN_FUEL_PUMP, LOW);
-    globalTimer.register_timer(TIMER_FUEL_PUMP, _period - FUEL_PUMP_PULSE_LEN, _cb);
+    globalTimer.set_timer_period(_on_handle, _period);
+    globalTimer.set_timer_period(_off_handle, _period);
   }
-  _next_level = !_next_level;
+
+  digitalWrite(PIN_FUEL_PUMP, HIGH);
+}
+
+void FuelPumpTimer::stop(void) {
+  digitalWrite(PIN_FUEL_PUMP, LOW);
+  globalTimer.cancel_timer(_on_handle);
+  globalTimer.cancel_timer(_off_handle);
+  _on_handle = TIMER_HANDLE_NONE;
+  _off_handle = TIMER_HANDLE_NONE;
+  _period = 0;
+  _enabled = false;
 }
 
 int FuelPumpTimer::getFuelPumpFrequency(void) {
@@ -54,15 +70,18 @@ void FuelPumpTimer::setBurnPower(int watts) {
   setPeriod(periodMs);
 }
 
-void FuelPumpTimer::setFuelNeed(double need) {
-  if(need == 0.0) {
+void FuelPumpTimer::setFuelNeed(int need) {
+  // need is fuel need * 100
+  if (need <= 0) {
     setPeriod(0);
+    return;
   }
 
-  double numerator = double(DIESEL_VOL_COMB_ENERGY * FUEL_PUMP_DOSE_ML);
-  double denominator = double(FUEL_PUMP_PULSE_LEN) + double(1000 * FUEL_PUMP_DOSE_ML) / (double(60) * need);
-  double periodMs = numerator / denominator;
-  setPeriod(int(periodMs));
+  // period = E * dose / (pulse + 1000 * dose / (60 * need / 100)), with the
+  // division folded out
+  uint64_t numerator = (uint64_t)DIESEL_VOL_COMB_ENERGY * FUEL_PUMP_DOSE_ML * 60 * need;
+  uint64_t denominator = (uint64_t)FUEL_PUMP_PULSE_LEN * 60 * need + 1000 * FUEL_PUMP_DOSE_ML * 100;
+  setPeriod((int)(numerator / denominator));
 }
 
 int FuelPumpTimer::getBurnPower(void)
@@ -84,9 +103,18 @@ int FuelPumpTimer::getBurnPower(void)
 
 void FuelPumpTimer::setPeriod(int periodMs) {
   _next_period = periodMs;
-  if (!_enabled) {
-    _enabled = true;
-    _next_level = true;
-    timerCallback(0, 0);
+  if (_enabled) {
+    return;
+  }
+
+  if (!periodMs) {
+    digitalWrite(PIN_FUEL_PUMP, LOW);
+    return;
   }
+
+  _enabled = true;
+  _period = periodMs;
+  digitalWrite(PIN_FUEL_PUMP, HIGH);
+  _on_handle = globalTimer.register_periodic_timer(TIMER_FUEL_PUMP, _period, _period, _cb, true);
+  _off_handle = globalTimer.register_periodic_timer(TIMER_FUEL_PUMP_OFF, FUEL_PUMP_PULSE_LEN, _period, _cb, true);
 }
@@ -13,9 +13,10 @@
 #define MAX_RATED_POWER         5200    // Stated rating for my Thermatop C
 #define FUEL_PUMP_DOSE_ML       22
 
-#define MIN_FUEL_NEED           (double)(0.6)     // At idle - about 1300W
-#define MAX_FUEL_NEED_BURNING   (double)(2.464)   // MAX rated power of 5200W
-#define MAX_FUEL_NEED_PRIMING   (double)(3.5)     // for priming only. - about 7200W!
+// Fuel need is in hundredths throughout
+#define MIN_FUEL_NEED           60      // At idle - about 1300W
+#define MAX_FUEL_NEED_BURNING   246     // MAX rated power of 5200W
+#define MAX_FUEL_NEED_PRIMING   350     // for priming only. - about 7200W!
 
 #define FUEL_PUMP_PULSE_LEN     9       // ms high for the pulse
 #define FUEL_PUMP_MIN_PERIOD  (DIESEL_VOL_COMB_ENERGY * FUEL_PUMP_DOSE_ML / MAX_RATED_POWER)
@@ -31,6 +32,9 @@ class FuelPumpTimer {
       _cb = cb;
       pinMode(PIN_FUEL_PUMP, OUTPUT);
       _enabled = false;
+      _period = 0;
+      _on_handle = TIMER_HANDLE_NONE;
+      _off_handle = TIMER_HANDLE_NONE;
       abort();
     }
 
@@ -40,16 +44,18 @@ class FuelPumpTimer {
     uint8_t getFuelPumpFrequencyKline(void);
     void setBurnPower(int watts);
     int getBurnPower(void);
-    void setFuelNeed(double need);
+    void setFuelNeed(int need);
 
   protected:
     void setPeriod(int periodMs);
+    void stop(void);
 
   private:
     bool _enabled;
     int _period;
     int _next_period;
-    bool _next_level;
+    timer_handle_t _on_handle;
+    timer_handle_t _off_handle;
     timer_callback _cb;
 };
 
@@ -4,125 +4,550 @@
 #include <CoreMutex.h>
 
 #include "global_timer.h"
+#include "monotonic.h"
+#include "timer_stats.h"
+#include "async_log.h"
 
 GlobalTimer globalTimer;
 
+static inline uint32_t saturate_us(uint64_t value)
+{
+  return value > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)value;
+}
+
 GlobalTimer::GlobalTimer(void)
 {
-  _head = 0;
-  _last_run = 0;
+  _sequence = 0;
+  _heap_count = 0;
+
+  for (int i = 0; i < GLOBAL_TIMER_POOL_SIZE; i++) {
+    _items[i].heap_index = -1;
+    _items[i].next_free = i + 1;
+    _items[i].next_same_id = -1;
+    _items[i].generation = 1;
+  }
+  _items[GLOBAL_TIMER_POOL_SIZE - 1].next_free = -1;
+  _free_head = 0;
+
+  for (int i = 0; i < TIMER_COUNT; i++) {
+    _id_head[i] = -1;
+  }
+
+  _alarm_pool = 0;
+  _alarm_id = 0;
+  _alarm_target_us = 0;
+
   mutex_init(&_mutex);
+  sem_init(&_wake, 0, 1);
+}
+
+void GlobalTimer::begin(void)
+{
+  // Must be called from core1:  the alarm IRQ is bound to the core that
+  // creates the pool, and that is the core we want woken up.
+  CoreMutex m(&_mutex);
+
+  _alarm_pool = alarm_pool_create_with_unused_hardware_alarm(4);
+  if (!_alarm_pool) {
+    LOG_ERROR("No free hardware alarm, GlobalTimer will poll");
+    return;
+  }
+
+  rearm();
+}
+
+int64_t GlobalTimer::alarm_callback(alarm_id_t id, void *user_data)
+{
+  (void)id;
+
+  // IRQ context:  just wake up core1 so tick() runs the callbacks there.
+  GlobalTimer *timer = (GlobalTimer *)user_data;
+  sem_release(&timer->_wake);
+  return 0;
+}
+
+void GlobalTimer::rearm(void)
+{
+  // Called with _mutex held whenever the head of the heap may have changed.
+  if (!_alarm_pool) {
+    return;
+  }
+
+  uint64_t target_us = _heap_count ? _items[_heap[0]].target_us : 0;
+  if (_alarm_id > 0 && target_us == _alarm_target_us) {
+    return;
+  }
+
+  if (_alarm_id > 0) {
+    alarm_pool_cancel_alarm(_alarm_pool, _alarm_id);
+    _alarm_id = 0;
+  }
+
+  _alarm_target_us = target_us;
+  if (!_heap_count) {
+    return;
+  }
+
+  absolute_time_t target;
+  update_us_since_boot(&target, target_us);
+  _alarm_id = alarm_pool_add_alarm_at(_alarm_pool, target, &GlobalTimer::alarm_callback, this, true);
 }
 
-void GlobalTimer::register_timer(int timer_id, int delay_ms, timer_callback cb)
+void GlobalTimer::wait(int max_ms)
+{
+  if (max_ms <= 0) {
+    return;
+  }
+
+  // Never sleep past the head of the heap, even if the alarm was lost.
+  uint64_t timeout_us = (uint64_t)max_ms * 1000;
+
+  mutex_enter_blocking(&_mutex);
+  if (_heap_count) {
+    uint64_t now = monotonic_us();
+    uint64_t target = _items[_heap[0]].target_us;
+    timeout_us = target > now ? min(timeout_us, target - now) : 0;
+  }
+  mutex_exit(&_mutex);
+
+  if (!timeout_us) {
+    return;
+  }
+
+  sem_acquire_timeout_us(&_wake, (uint32_t)timeout_us);
+}
+
+void GlobalTimer::wake(void)
+{
+  // Safe from IRQ context and from either core.
+  sem_release(&_wake);
+}
+
+timer_handle_t GlobalTimer::register_timer(int timer_id, int delay_ms, timer_callback cb, bool replace)
 {
   if (delay_ms <= 0 || !cb) {
+    return TIMER_HANDLE_NONE;
+  }
+
+  LOG_NOTICE("Registering timer: %d -> %dms", timer_id, delay_ms);
+
+  return register_timer_us(timer_id, (uint32_t)delay_ms * 1000, cb, replace);
+}
+
+timer_handle_t GlobalTimer::register_timer_us(int timer_id, uint32_t delay_us, timer_callback cb, bool replace)
+{
+  if (!delay_us || !cb) {
+    return TIMER_HANDLE_NONE;
+  }
+
+  return add_item(timer_id, delay_us, 0, cb, replace);
+}
+
+timer_handle_t GlobalTimer::register_periodic_timer(int timer_id, int delay_ms, int period_ms, timer_callback cb, bool replace)
+{
+  if (delay_ms <= 0 || period_ms <= 0 || !cb) {
+    return TIMER_HANDLE_NONE;
+  }
+
+  LOG_NOTICE("Registering periodic timer: %d -> %dms, every %dms", timer_id, delay_ms, period_ms);
+
+  return add_item(timer_id, (uint64_t)delay_ms * 1000, (uint64_t)period_ms * 1000, cb, replace);
+}
+
+timer_handle_t GlobalTimer::add_item(int timer_id, uint64_t delay_us, uint64_t period_us, timer_callback cb, bool replace)
+{
+  if (timer_id < 0 || timer_id >= TIMER_COUNT) {
+    LOG_ERROR("Invalid timer id %d", timer_id);
+    return TIMER_HANDLE_NONE;
+  }
+
+  if (is_remote_core()) {
+    // The handle is only known once core1 picks this up, so there is none
+    // to give back.  Core0 callers cancel by id instead.
+    timerRequest_t request = { TIMER_REQUEST_ADD, replace, timer_id, TIMER_HANDLE_NONE, delay_us, period_us, cb };
+    queue_request(&request);
+    return TIMER_HANDLE_NONE;
+  }
+
+  return do_add_item(timer_id, delay_us, period_us, cb, replace);
+}
+
+bool GlobalTimer::set_timer_period(timer_handle_t handle, int period_ms)
+{
+  if (period_ms <= 0) {
+    return false;
+  }
+
+  if (is_remote_core()) {
+    timerRequest_t request = { TIMER_REQUEST_SET_PERIOD, false, 0, handle, 0, (uint64_t)period_ms * 1000, 0 };
+    return queue_request(&request);
+  }
+
+  return do_set_period(handle, (uint64_t)period_ms * 1000);
+}
+
+bool GlobalTimer::reschedule_timer(timer_handle_t handle, int delay_ms)
+{
+  if (delay_ms <= 0) {
+    return false;
+  }
+
+  if (is_remote_core()) {
+    timerRequest_t request = { TIMER_REQUEST_RESCHEDULE, false, 0, handle, (uint64_t)delay_ms * 1000, 0, 0 };
+    return queue_request(&request);
+  }
+
+  return do_reschedule(handle, (uint64_t)delay_ms * 1000);
+}
+
+bool GlobalTimer::cancel_timer(timer_handle_t handle)
+{
+  if (is_remote_core()) {
+    timerRequest_t request = { TIMER_REQUEST_CANCEL, false, 0, handle, 0, 0, 0 };
+    return queue_request(&request);
+  }
+
+  return do_cancel(handle);
+}
+
+int GlobalTimer::cancel_timer_id(int timer_id)
+{
+  if (timer_id < 0 || timer_id >= TIMER_COUNT) {
+    return 0;
+  }
+
+  if (is_remote_core()) {
+    timerRequest_t request = { TIMER_REQUEST_CANCEL_ID, false, timer_id, TIMER_HANDLE_NONE, 0, 0, 0 };
+    queue_request(&request);
+    return 0;
+  }
+
+  return do_cancel_id(timer_id);
+}
+
+void GlobalTimer::adjust_timer(int timer_id, int delay_ms)
+{
+  if (delay_ms <= 0) {
+    return;
+  }
+
+  if (is_remote_core()) {
+    timerRequest_t request = { TIMER_REQUEST_ADJUST, false, timer_id, TIMER_HANDLE_NONE, (uint64_t)delay_ms * 1000, 0, 0 };
+    queue_request(&request);
     return;
   }
 
-  Log.notice("Registering timer: %d -> %dms", timer_id, delay_ms);
+  do_adjust(timer_id, (uint64_t)delay_ms * 1000);
+}
+
+bool GlobalTimer::queue_request(timerRequest_t *request)
+{
+  // Producer side, core0 only.  Never blocks:  if core1 has fallen this far
+  // behind, the request is dropped.
+  if (!_requests.push(*request)) {
+    LOG_ERROR("Timer request queue full, dropping request %d for timer %d", request->op, request->timer_id);
+    return false;
+  }
+
+  wake();
+  return true;
+}
+
+void GlobalTimer::process_requests(void)
+{
+  // Consumer side, core1 only.
+  timerRequest_t *request;
+  while ((request = _requests.front())) {
+    switch (request->op) {
+      case TIMER_REQUEST_ADD:
+        do_add_item(request->timer_id, request->delay_us, request->period_us, request->cb, request->replace);
+        break;
+      case TIMER_REQUEST_CANCEL:
+        do_cancel(request->handle);
+        break;
+      case TIMER_REQUEST_CANCEL_ID:
+        do_cancel_id(request->timer_id);
+        break;
+      case TIMER_REQUEST_RESCHEDULE:
+        do_reschedule(request->handle, request->delay_us);
+        break;
+      case TIMER_REQUEST_SET_PERIOD:
+        do_set_period(request->handle, request->period_us);
+        break;
+      case TIMER_REQUEST_ADJUST:
+        do_adjust(request->timer_id, request->delay_us);
+        break;
+      default:
+        break;
+    }
+
+    _requests.pop();
+  }
+}
+
+timer_handle_t GlobalTimer::do_add_item(int timer_id, uint64_t delay_us, uint64_t period_us, timer_callback cb, bool replace)
+{
+  CoreMutex m(&_mutex);
 
-  timerItem_t *item = (timerItem_t *)malloc(sizeof(timerItem_t));
+  if (replace) {
+    remove_id(timer_id);
+  }
+
+  int slot = allocate_item();
+  if (slot < 0) {
+    LOG_ERROR("Timer pool exhausted, dropping timer %d", timer_id);
+    rearm();
+    return TIMER_HANDLE_NONE;
+  }
 
+  timerItem_t *item = &_items[slot];
   item->timer_id = timer_id;
-  item->start_ms = millis();
-  item->target_ms = item->start_ms + delay_ms;
+  item->start_us = monotonic_us();
+  item->target_us = item->start_us + delay_us;
+  item->period_us = period_us;
+  item->sequence = _sequence++;
   item->cb = cb;
-  item->next = 0;
 
-  insert_item(item, false);
+  item->next_same_id = _id_head[timer_id];
+  _id_head[timer_id] = slot;
+
+  heap_insert(slot);
+  rearm();
+
+  return make_handle(slot);
 }
 
-timerItem_t *GlobalTimer::remove_item(int timer_id, bool locked)
+bool GlobalTimer::do_set_period(timer_handle_t handle, uint64_t period_us)
 {
-  if (!locked) {
-    mutex_enter_blocking(&_mutex);
+  CoreMutex m(&_mutex);
+
+  int slot = find_handle(handle);
+  if (slot < 0 || !_items[slot].period_us) {
+    return false;
   }
 
-  timerItem_t *curr, *prev;
-  for (curr = _head, prev = 0; curr; prev = curr, curr = curr->next) {
-    if (curr->timer_id == timer_id) {
-      if (!prev) {
-        _head = curr->next;
-      } else {
-        prev->next = curr->next;
-      }
-      break;
-    }
+  // Takes effect when the timer is next rearmed.  From inside the timer's
+  // own callback, that is the rearm following this very expiry.
+  _items[slot].period_us = period_us;
+  return true;
+}
+
+bool GlobalTimer::do_reschedule(timer_handle_t handle, uint64_t delay_us)
+{
+  CoreMutex m(&_mutex);
+
+  int slot = find_handle(handle);
+  if (slot < 0) {
+    return false;
   }
 
-  if (!locked) {
-   mutex_exit(&_mutex);
+  // Reschedule is relative to now, not to the original start.
+  timerItem_t *item = &_items[slot];
+  item->start_us = monotonic_us();
+  item->target_us = item->start_us + delay_us;
+  item->sequence = _sequence++;
+  heap_sift_down(item->heap_index);
+  heap_sift_up(item->heap_index);
+  rearm();
+  return true;
+}
+
+bool GlobalTimer::do_cancel(timer_handle_t handle)
+{
+  CoreMutex m(&_mutex);
+
+  int slot = find_handle(handle);
+  if (slot < 0) {
+    return false;
   }
 
-  return curr;
+  remove_item(slot);
+  rearm();
+  return true;
 }
 
-timerItem_t *GlobalTimer::find_item(int timer_id, bool locked)
+int GlobalTimer::do_cancel_id(int timer_id)
 {
-  if (!locked) {
-    mutex_enter_blocking(&_mutex);
+  CoreMutex m(&_mutex);
+
+  int count = remove_id(timer_id);
+  if (count) {
+    rearm();
   }
+  return count;
+}
 
-  timerItem_t *curr, *prev;
-  for (curr = _head, prev = 0; curr; prev = curr, curr = curr->next) {
-    if (curr->timer_id == timer_id) {
-      break;
-    }
+void GlobalTimer::do_adjust(int timer_id, uint64_t delay_us)
+{
+  CoreMutex m(&_mutex);
+
+  int slot = find_item(timer_id);
+
+  if (slot >= 0) {
+    timerItem_t *item = &_items[slot];
+    item->target_us += delay_us;
+    heap_sift_down(item->heap_index);
+    rearm();
   }
+}
 
-  if (!locked) {
-   mutex_exit(&_mutex);
+timer_handle_t GlobalTimer::make_handle(int slot)
+{
+  return (timer_handle_t)(((_items[slot].generation & 0x7FFFFF) << 8) | slot);
+}
+
+int GlobalTimer::find_handle(timer_handle_t handle)
+{
+  if (handle == TIMER_HANDLE_NONE) {
+    return -1;
   }
 
-  return curr;
+  int slot = handle & 0xFF;
+  if (slot >= GLOBAL_TIMER_POOL_SIZE || _items[slot].heap_index < 0 || make_handle(slot) != handle) {
+    return -1;
+  }
+
+  return slot;
 }
 
+int GlobalTimer::allocate_item(void)
+{
+  int slot = _free_head;
+  if (slot >= 0) {
+    _free_head = _items[slot].next_free;
+    _items[slot].next_free = -1;
+  }
+  return slot;
+}
 
-void GlobalTimer::insert_item(timerItem_t *item, bool locked)
+void GlobalTimer::free_item(int slot)
 {
-  int key = item->target_ms;
+  timerItem_t *item = &_items[slot];
 
-  if (!locked) {
-    mutex_enter_blocking(&_mutex);
+  // Unlink from the per-id chain.  This is normally a single entry.
+  int *link = &_id_head[item->timer_id];
+  while (*link >= 0 && *link != slot) {
+    link = &_items[*link].next_same_id;
+  }
+  if (*link == slot) {
+    *link = item->next_same_id;
   }
 
-  item->next = 0;
-  if (!_head) {
-    _head = item;
-  } else {
-    timerItem_t *curr, *prev;
-    for (curr = _head, prev = 0; curr; prev = curr, curr = curr->next) {
-      if (curr->target_ms > key) {
-        item->next = curr;
-        if (!prev) {
-          _head = item;
-        } else {
-          prev->next = item;
-        }
-        break;
-      }
-    }
+  item->next_same_id = -1;
+  item->heap_index = -1;
+  item->cb = 0;
+  item->generation = (item->generation + 1) & 0x7FFFFF;
+  if (!item->generation) {
+    item->generation = 1;
+  }
+  item->next_free = _free_head;
+  _free_head = slot;
+}
 
-    if (!curr) {
-      prev->next = item;
+void GlobalTimer::remove_item(int slot)
+{
+  heap_remove(_items[slot].heap_index);
+  free_item(slot);
+}
+
+int GlobalTimer::remove_id(int timer_id)
+{
+  int count = 0;
+  while (_id_head[timer_id] >= 0) {
+    remove_item(_id_head[timer_id]);
+    count++;
+  }
+  return count;
+}
+
+int GlobalTimer::find_item(int timer_id)
+{
+  if (timer_id < 0 || timer_id >= TIMER_COUNT) {
+    return -1;
+  }
+
+  // Earliest matching entry wins, same as the old sorted list.
+  int found = -1;
+  for (int slot = _id_head[timer_id]; slot >= 0; slot = _items[slot].next_same_id) {
+    if (found < 0 || heap_less(slot, found)) {
+      found = slot;
     }
   }
+  return found;
+}
 
-  if (!locked) {
-    mutex_exit(&_mutex);
+bool GlobalTimer::heap_less(int a, int b)
+{
+  timerItem_t *itemA = &_items[a];
+  timerItem_t *itemB = &_items[b];
+
+  if (itemA->target_us != itemB->target_us) {
+    return itemA->target_us < itemB->target_us;
   }
+  return (int32_t)(itemA->sequence - itemB->sequence) < 0;
 }
 
-void GlobalTimer::adjust_timer(int timer_id, int delay_ms)
+void GlobalTimer::heap_swap(int a, int b)
 {
-  CoreMutex m(&_mutex);
+  int slot = _heap[a];
+  _heap[a] = _heap[b];
+  _heap[b] = slot;
 
-  timerItem_t *item = remove_item(timer_id);
+  _items[_heap[a]].heap_index = a;
+  _items[_heap[b]].heap_index = b;
+}
 
-  if (item && delay_ms > 0) {
-    item->target_ms += delay_ms;
-    insert_item(item);
+void GlobalTimer::heap_sift_up(int index)
+{
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (!heap_less(_heap[index], _heap[parent])) {
+      break;
+    }
+    heap_swap(index, parent);
+    index = parent;
+  }
+}
+
+void GlobalTimer::heap_sift_down(int index)
+{
+  while (true) {
+    int left = 2 * index + 1;
+    int right = left + 1;
+    int smallest = index;
+
+    if (left < _heap_count && heap_less(_heap[left], _heap[smallest])) {
+      smallest = left;
+    }
+
+    if (right < _heap_count && heap_less(_heap[right], _heap[smallest])) {
+      smallest = right;
+    }
+
+    if (smallest == index) {
+      break;
+    }
+
+    heap_swap(index, smallest);
+    index = smallest;
+  }
+}
+
+void GlobalTimer::heap_insert(int slot)
+{
+  int index = _heap_count++;
+  _heap[index] = slot;
+  _items[slot].heap_index = index;
+  heap_sift_up(index);
+}
+
+void GlobalTimer::heap_remove(int index)
+{
+  int last = --_heap_count;
+  if (index != last) {
+    heap_swap(index, last);
+    heap_sift_down(index);
+    heap_sift_up(index);
   }
 }
 
@@ -130,11 +555,13 @@ int GlobalTimer::get_remaining_time(int timer_id)
 {
   CoreMutex m(&_mutex);
 
-  timerItem_t *item = find_item(timer_id);
+  int slot = find_item(timer_id);
   int remaining = 0;
 
-  if (item) {
-    remaining = max(0, item->target_ms - millis());
+  if (slot >= 0) {
+    uint64_t now = monotonic_us();
+    uint64_t target = _items[slot].target_us;
+    remaining = target > now ? (int)((target - now) / 1000) : 0;
   }
 
   return remaining;
@@ -143,31 +570,59 @@ int GlobalTimer::get_remaining_time(int timer_id)
 
 void GlobalTimer::tick(void)
 {
-  int now = millis();
-  if (now == _last_run) {
-    return;
-  }
+  process_requests();
 
-  _last_run = now;
+  uint64_t now = monotonic_us();
 
-  mutex_enter_blocking(&_mutex);
-  timerItem_t *curr, *old_head = _head, *new_head;
-  for (curr = _head; curr; curr = curr->next) {
-    if (curr->target_ms > now) {
+  // Handle one expired entry at a time and run its callback unlocked, so the
+  // callback may register new timers and a cancel issued by one callback
+  // (e.g. a state exit) takes effect on anything else that expired with it.
+  while (true) {
+    timerItem_t curr;
+    timer_handle_t handle;
+
+    mutex_enter_blocking(&_mutex);
+    if (!_heap_count || _items[_heap[0]].target_us > now) {
+      mutex_exit(&_mutex);
       break;
     }
-    _head = curr->next;
-  }
-  new_head = _head;
-  mutex_exit(&_mutex);
 
-  timerItem_t *next;
-  for (curr = old_head; curr && curr != new_head; curr = next) {
-    int elapsed = now - curr->start_ms;
-    Log.notice("Calling callback: %d, %dms", curr->timer_id, elapsed);
-    (*curr->cb)(curr->timer_id, elapsed);
+    int slot = _heap[0];
+    curr = _items[slot];
+    handle = make_handle(slot);
+
+    if (!curr.period_us) {
+      remove_item(slot);
+      rearm();
+    }
+    mutex_exit(&_mutex);
+
+    int elapsed = (int)((now - curr.start_us) / 1000);
+    LOG_NOTICE("Calling callback: %d, %dms", curr.timer_id, elapsed);
 
-    next = curr->next;
-    free(curr);
+    uint64_t started = monotonic_us();
+    (*curr.cb)(curr.timer_id, elapsed);
+    uint64_t finished = monotonic_us();
+
+    timer_stats_record(curr.timer_id, saturate_us(started - curr.target_us), saturate_us(finished - started));
+
+    if (!curr.period_us) {
+      continue;
+    }
+
+    // Periodic:  rearm from the previous target, not from now, so lateness
+    // in servicing one expiry does not accumulate.  Skip it if the callback
+    // cancelled or rescheduled the timer itself.
+    mutex_enter_blocking(&_mutex);
+    slot = find_handle(handle);
+    if (slot >= 0 && _items[slot].target_us == curr.target_us) {
+      timerItem_t *item = &_items[slot];
+      item->start_us = item->target_us;
+      item->target_us += item->period_us;
+      item->sequence = _sequence++;
+      heap_sift_down(item->heap_index);
+      rearm();
+    }
+    mutex_exit(&_mutex);
   }
 }
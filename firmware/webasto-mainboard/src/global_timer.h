@@ -4,47 +4,149 @@
 #include <Arduino.h>
 #include <pico.h>
 #include <CoreMutex.h>
+#include <pico/time.h>
+#include <pico/sync.h>
+#include <hardware/sync.h>
+
+#include "spsc_ring.h"
+
+// Maximum number of simultaneously live timers.  The pool is statically
+// allocated, so registering a timer never touches the heap.
+#ifndef GLOBAL_TIMER_POOL_SIZE
+#define GLOBAL_TIMER_POOL_SIZE  32
+#endif
+
+static_assert(GLOBAL_TIMER_POOL_SIZE <= 256, "Timer handles only carry 8 bits of slot number");
+
+// Core that owns the heap.  Calls from the other core are queued to it.
+#define GLOBAL_TIMER_CORE 1
+
+// Depth of the lock-free core0 -> core1 request ring (power of 2)
+#ifndef GLOBAL_TIMER_REQUEST_QUEUE_SIZE
+#define GLOBAL_TIMER_REQUEST_QUEUE_SIZE 16
+#endif
 
 typedef void (*timer_callback)(int timer_id, int delay_ms);
 
-struct timerItem_s;
-typedef struct timerItem_s {
+// Opaque reference to one registered timer.  The low 8 bits are the pool
+// slot, the rest is a per-slot generation so stale handles are rejected.
+typedef int32_t timer_handle_t;
+
+#define TIMER_HANDLE_NONE 0
+
+typedef struct {
   int timer_id;
-  int start_ms;
-  int target_ms;
+  uint64_t start_us;
+  uint64_t target_us;
+  uint64_t period_us;   // 0 for one-shot, otherwise rearmed at target + period
+  uint32_t sequence;    // tie-breaker to keep FIFO order for equal targets
   timer_callback cb;
-  struct timerItem_s *next;
+  int heap_index;       // position in _heap, -1 when the slot is free
+  int next_free;
+  int next_same_id;     // next slot registered with the same timer_id
+  uint32_t generation;
 } timerItem_t;
 
+enum {
+  TIMER_REQUEST_ADD,
+  TIMER_REQUEST_CANCEL,
+  TIMER_REQUEST_CANCEL_ID,
+  TIMER_REQUEST_RESCHEDULE,
+  TIMER_REQUEST_SET_PERIOD,
+  TIMER_REQUEST_ADJUST,
+};
+
+typedef struct {
+  uint8_t op;
+  bool replace;
+  int timer_id;
+  timer_handle_t handle;
+  uint64_t delay_us;
+  uint64_t period_us;
+  timer_callback cb;
+} timerRequest_t;
+
 enum {
   TIMER_FUEL_PUMP,
+  TIMER_FUEL_PUMP_OFF,
   TIMER_TIMED_SHUT_DOWN,
   TIMER_STAGE_COMPLETE,
   TIMER_STAGE_RETRY,
   TIMER_RUN_TIME_MINUTE,
   TIMER_FUEL_FAN_DELTA,
   TIMER_BEEPER,
+  TIMER_BEEPER_OFF,
+  TIMER_BEEPER_GAP,
   TIMER_RESTART_BEEPS,
   TIMER_FSM_STARTUP,
   TIMER_OLED_LOGO,
+  TIMER_STATE_STATS,
+  TIMER_COUNT,
 };
 
 class GlobalTimer {
   public:
     GlobalTimer(void);
-    void register_timer(int timer_id, int delay_ms, timer_callback cb);
+    void begin(void);
+    timer_handle_t register_timer(int timer_id, int delay_ms, timer_callback cb, bool replace = false);
+    timer_handle_t register_timer_us(int timer_id, uint32_t delay_us, timer_callback cb, bool replace = false);
+    timer_handle_t register_periodic_timer(int timer_id, int delay_ms, int period_ms, timer_callback cb, bool replace = false);
+    bool set_timer_period(timer_handle_t handle, int period_ms);
     void adjust_timer(int timer_id, int delay_ms);
+    bool reschedule_timer(timer_handle_t handle, int delay_ms);
+    bool cancel_timer(timer_handle_t handle);
+    int cancel_timer_id(int timer_id);
     void tick(void);
+    void wait(int max_ms);
+    void wake(void);
     int get_remaining_time(int timer_id);
 
   private:
-    timerItem_t *find_item(int timer_id, bool locked = true);
-    timerItem_t *remove_item(int timer_id, bool locked = true);
-    void insert_item(timerItem_t *item, bool locked = true);
+    timer_handle_t add_item(int timer_id, uint64_t delay_us, uint64_t period_us, timer_callback cb, bool replace);
+    int find_item(int timer_id);
+    int find_handle(timer_handle_t handle);
+    timer_handle_t make_handle(int slot);
+    int allocate_item(void);
+    void free_item(int slot);
+    void remove_item(int slot);
+    int remove_id(int timer_id);
+
+    bool heap_less(int a, int b);
+    void heap_swap(int a, int b);
+    void heap_sift_up(int index);
+    void heap_sift_down(int index);
+    void heap_insert(int slot);
+    void heap_remove(int index);
+    void rearm(void);
 
-    int _last_run;
-    timerItem_t *_head;
+    bool queue_request(timerRequest_t *request);
+    void process_requests(void);
+    inline bool is_remote_core(void) { return get_core_num() != GLOBAL_TIMER_CORE; };
+
+    timer_handle_t do_add_item(int timer_id, uint64_t delay_us, uint64_t period_us, timer_callback cb, bool replace);
+    bool do_reschedule(timer_handle_t handle, uint64_t delay_us);
+    bool do_set_period(timer_handle_t handle, uint64_t period_us);
+    bool do_cancel(timer_handle_t handle);
+    int do_cancel_id(int timer_id);
+    void do_adjust(int timer_id, uint64_t delay_us);
+
+    static int64_t alarm_callback(alarm_id_t id, void *user_data);
+
+    uint32_t _sequence;
+    timerItem_t _items[GLOBAL_TIMER_POOL_SIZE];
+    int _heap[GLOBAL_TIMER_POOL_SIZE];
+    int _heap_count;
+    int _free_head;
+    int _id_head[TIMER_COUNT];
     mutex_t _mutex;
+
+    alarm_pool_t *_alarm_pool;
+    alarm_id_t _alarm_id;
+    uint64_t _alarm_target_us;
+    semaphore_t _wake;
+
+    // Single producer (core0), single consumer (core1)
+    SpscRing<timerRequest_t, GLOBAL_TIMER_REQUEST_QUEUE_SIZE> _requests;
 };
 
 extern GlobalTimer globalTimer;
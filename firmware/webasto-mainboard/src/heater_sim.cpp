@@ -0,0 +1,364 @@
+#ifdef NATIVE_BUILD
+
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <canbus_ids.h>
+#include <webasto.h>
+#include <native_hal.h>
+
+#include <chrono>
+
+#include "heater_sim.h"
+#include "global_timer.h"
+#include "monotonic.h"
+#include "sensor_registry.h"
+#include "fuel_pump.h"
+#include "fsm.h"
+#include "fsm_state.h"
+#include "fsm_queue.h"
+#include "async_log.h"
+#include "coolant_pi.h"
+
+// Model constants.  These are picked to give plausible shapes (warm-up of a
+// few minutes, exhaust in the 100-300C range), not fitted to a real heater.
+#define SIM_WATTS_PER_FUEL_NEED (MAX_RATED_POWER / (double)MAX_FUEL_NEED_BURNING)
+#define SIM_COOLANT_J_PER_K     15000.0   // coolant loop heat capacity
+#define SIM_COOLANT_LOSS_W_K    20.0      // loss to ambient, vehicle fan off
+#define SIM_VEHICLE_FAN_W_K     0.6       // extra loss per % vehicle fan
+#define SIM_COOLANT_SHARE       0.8       // fraction of the heat reaching coolant
+#define SIM_EXHAUST_C_PER_W     0.045
+#define SIM_GLOW_MAX_C          1100.0
+#define SIM_GLOW_HEAT_TAU_S     10.0
+#define SIM_GLOW_COOL_TAU_S     15.0
+#define SIM_IGNITE_C            900.0     // at 0C outdoor and above
+#define SIM_IGNITE_COLD_C_PER_K 4.0       // harder to light below 0C
+#define SIM_WICK_TAU_S          30.0      // primed fuel burns off over this
+#define SIM_WICK_DRAIN_TAU_S    180.0     // and evaporates over this when unlit
+#define SIM_WICK_MAX_W          1500.0
+#define SIM_MIN_FLAME_W         80.0
+
+static inline float approach(float value, float target, float dt_s, float tau_s)
+{
+  return value + (target - value) * (1.0 - expf(-dt_s / tau_s));
+}
+
+float HeaterSimulator::jitter(float range)
+{
+  // xorshift32:  repeatable per seed, no dependency on the host's rand()
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  return range * (((float)(_seed & 0xFFFF) / 32768.0) - 1.0);
+}
+
+void HeaterSimulator::reset(float outdoor_c, uint32_t seed)
+{
+  _seed = seed ? seed : 1;
+  _outdoor_c = outdoor_c;
+  _coolant_c = outdoor_c;
+  _exhaust_c = outdoor_c;
+  _glow_c = outdoor_c;
+  _wick_j = 0.0;
+  _heat_w = 0.0;
+  _lit = false;
+  _ignite_c = SIM_IGNITE_C + max(0.0, -outdoor_c) * SIM_IGNITE_COLD_C_PER_K + jitter(40.0);
+}
+
+void HeaterSimulator::step(float dt_s)
+{
+  float fan = combustionFanPercent / 100.0;
+  float pump_w = fuelNeedRequested * SIM_WATTS_PER_FUEL_NEED;
+  float glow = glowPlugOutEnable ? glowPlugPercent / 100.0 : 0.0;
+
+  if (!_lit) {
+    // Unburnt fuel soaks the wick and slowly evaporates away
+    _wick_j += pump_w * dt_s;
+    _wick_j -= _wick_j * dt_s / SIM_WICK_DRAIN_TAU_S;
+
+    if (_glow_c >= _ignite_c && fan > 0.02 && (_wick_j > 2000.0 || pump_w > 0.0)) {
+      _lit = true;
+    }
+  }
+
+  _heat_w = 0.0;
+  if (_lit) {
+    float wick_w = min(_wick_j / SIM_WICK_TAU_S, (float)SIM_WICK_MAX_W);
+    _wick_j -= wick_w * dt_s;
+    _heat_w = pump_w + wick_w;
+
+    if (_heat_w < SIM_MIN_FLAME_W || fan < 0.02) {
+      _lit = false;
+      _heat_w = 0.0;
+    }
+  }
+
+  // Glow plug:  electrically heated (less so with cold air blowing over it),
+  // or heated by the flame, otherwise it settles at chamber temperature.
+  float glow_target = _exhaust_c;
+  if (glow > 0.0) {
+    glow_target = SIM_GLOW_MAX_C * glow - 120.0 * fan - 1.5 * (20.0 - _outdoor_c);
+  }
+  if (_lit) {
+    glow_target = max(glow_target, 700.0 + _heat_w * 0.04);
+  }
+  _glow_c = approach(_glow_c, glow_target, dt_s, glow_target > _glow_c ? SIM_GLOW_HEAT_TAU_S : SIM_GLOW_COOL_TAU_S);
+
+  // Exhaust/chamber:  hotter with more heat, cooled by more air
+  float exhaust_target = _outdoor_c + (_coolant_c - _outdoor_c) * 0.3;
+  if (_lit) {
+    exhaust_target = _coolant_c + _heat_w * SIM_EXHAUST_C_PER_W * (1.2 - 0.4 * fan);
+  }
+  _exhaust_c = approach(_exhaust_c, exhaust_target, dt_s, 10.0 / (0.5 + fan));
+
+  // Coolant loop
+  float loss_w_k = SIM_COOLANT_LOSS_W_K + SIM_VEHICLE_FAN_W_K * vehicleFanPercent;
+  float net_w = _heat_w * SIM_COOLANT_SHARE - loss_w_k * (_coolant_c - _outdoor_c);
+  _coolant_c += net_w * dt_s / SIM_COOLANT_J_PER_K;
+}
+
+int HeaterSimulator::flameResistance(void)
+{
+  // Glow plug resistance rises with its temperature:  ~400mOhm cold
+  return (int)(400.0 + max(_glow_c, 0.0f) * 1.2);
+}
+
+static void report_remote(int id, int32_t value)
+{
+  // Same path as a frame arriving in canbus_dispatch()
+  RemoteSensor *sensor = sensorRegistry.get<RemoteSensor>(id);
+  if (sensor) {
+    sensor->set_value(value);
+  }
+}
+
+void HeaterSimulator::report(void)
+{
+  report_remote(CANBUS_ID_EXTERNAL_TEMP, (int32_t)(_outdoor_c * 100.0));
+  report_remote(CANBUS_ID_BATTERY_VOLTAGE, 12600);
+  report_remote(CANBUS_ID_COOLANT_TEMP_WEBASTO, (int32_t)(_coolant_c * 100.0));
+  report_remote(CANBUS_ID_EXHAUST_TEMP, (int32_t)(_exhaust_c * 100.0));
+
+  // The INA219 only measures while the glow plug is switched to sensing
+  if (glowPlugInEnable) {
+    FlameDetectEvent event;
+    event.value = flameResistance();
+    fsm_post(event);
+  }
+}
+
+// Run the timers and the model together on the manual clock until done()
+// says so or limit_ms passes.  Returns false on timeout.
+typedef bool (*sim_done_func)(void *data);
+
+static bool sim_run(HeaterSimulator *sim, int limit_ms, sim_done_func done, void *data)
+{
+  const uint64_t step_us = HEATER_SIM_STEP_MS * 1000;
+  const uint64_t report_us = HEATER_SIM_REPORT_MS * 1000;
+
+  uint64_t now = monotonic_us();
+  uint64_t end_us = now + (uint64_t)limit_ms * 1000;
+  uint64_t next_step_us = now + step_us;
+  uint64_t next_report_us = now;
+
+  while (now < end_us) {
+    globalTimer.tick();
+    fsm_process_events();
+
+    now = monotonic_us();
+    if (now >= next_step_us) {
+      sim->step(HEATER_SIM_STEP_MS / 1000.0);
+      next_step_us += step_us;
+    }
+
+    if (now >= next_report_us) {
+      sim->report();
+      next_report_us += report_us;
+    }
+
+    fsm_process_events();
+    update_async_log();
+
+    if (done && done(data)) {
+      return true;
+    }
+
+    uint64_t next_us = min(next_step_us, next_report_us);
+    if (next_us > now) {
+      globalTimer.wait((next_us - now + 999) / 1000);
+    }
+    now = monotonic_us();
+  }
+
+  return false;
+}
+
+typedef struct {
+  heater_sim_result_t *result;
+  HeaterSimulator *sim;
+  uint64_t start_us;
+  uint8_t last_state;
+  bool left_idle;
+} sim_cycle_t;
+
+static bool sim_cycle_done(void *data)
+{
+  sim_cycle_t *cycle = (sim_cycle_t *)data;
+  heater_sim_result_t *result = cycle->result;
+
+  result->max_coolant_c = max(result->max_coolant_c, cycle->sim->coolantC());
+  result->max_exhaust_c = max(result->max_exhaust_c, cycle->sim->exhaustC());
+
+  // How long the coolant loop takes to reach its target, and how far it
+  // wanders once there
+  if (WebastoControlFSM::is_in_state<AutoBurnState>() || WebastoControlFSM::is_in_state<FlameMeasureState>()) {
+    float coolant_c = cycle->sim->coolantC();
+    float target_c = coolant_pi_tuning.target / 100.0;
+
+    if (!result->settled && fabsf(coolant_c - target_c) <= HEATER_SIM_SETTLE_C) {
+      result->settled = true;
+      result->settle_time_s = elapsed_ms_since(cycle->start_us) / 1000;
+      result->min_settled_c = coolant_c;
+      result->max_settled_c = coolant_c;
+    }
+
+    if (result->settled) {
+      result->min_settled_c = min(result->min_settled_c, coolant_c);
+      result->max_settled_c = max(result->max_settled_c, coolant_c);
+    }
+  }
+
+  if (fsm_state != cycle->last_state) {
+    cycle->last_state = fsm_state;
+
+    if (WebastoControlFSM::is_in_state<StandbyState>()) {
+      if (cycle->left_idle) {
+        result->restarts++;
+      }
+      cycle->left_idle = true;
+    }
+
+    if (WebastoControlFSM::is_in_state<AutoBurnState>() && !result->started) {
+      result->started = true;
+      result->start_time_s = elapsed_ms_since(cycle->start_us) / 1000;
+    }
+  }
+
+  if (WebastoControlFSM::is_in_state<LockdownState>() || WebastoControlFSM::is_in_state<EmergencyOffState>()) {
+    result->lockdown = true;
+    return true;
+  }
+
+  if (cycle->left_idle && WebastoControlFSM::is_in_state<IdleState>()) {
+    result->completed = true;
+    return true;
+  }
+
+  return false;
+}
+
+heater_sim_result_t heater_sim_cycle(HeaterSimulator *sim, float outdoor_c, int run_minutes, uint32_t seed)
+{
+  heater_sim_result_t result = {};
+  sim_cycle_t cycle;
+
+  sim->reset(outdoor_c, seed);
+  sim->report();
+
+  cycle.result = &result;
+  cycle.sim = sim;
+  cycle.start_us = monotonic_us();
+  cycle.last_state = fsm_state;
+  cycle.left_idle = false;
+
+  result.max_coolant_c = sim->coolantC();
+  result.max_exhaust_c = sim->exhaustC();
+
+  StartupEvent event;
+  event.mode = WEBASTO_MODE_PARKING_HEATER;
+  event.minutes = run_minutes;
+  fsm_post(event);
+
+  sim_run(sim, HEATER_SIM_MAX_CYCLE_S * 1000, &sim_cycle_done, &cycle);
+  result.cycle_time_s = elapsed_ms_since(cycle.start_us) / 1000;
+  return result;
+}
+
+static bool sim_fsm_idle(void *data)
+{
+  (void)data;
+  return WebastoControlFSM::is_in_state<IdleState>();
+}
+
+// Lockdown can only be cleared from the front panel, so start the FSM over.
+static void sim_restart_fsm(HeaterSimulator *sim)
+{
+  globalTimer.cancel_timer_id(TIMER_RESTART_BEEPS);
+  globalTimer.cancel_timer_id(TIMER_TIMED_SHUT_DOWN);
+  globalTimer.cancel_timer_id(TIMER_RUN_TIME_MINUTE);
+  init_fsm();
+  sim_run(sim, 1000, &sim_fsm_idle, NULL);
+}
+
+void heater_sim_sweep(int low_c, int high_c, int step_c, int cycles)
+{
+  HeaterSimulator sim;
+  uint32_t seed = 1;
+
+  sim.reset(low_c, seed);
+  sim_run(&sim, 1000, &sim_fsm_idle, NULL);
+
+  printf("%8s %7s %7s %9s %9s %9s %9s %9s %9s %9s\n", "outdoor", "cycles", "starts", "start_s", "restarts",
+         "lockdown", "coolant", "exhaust", "settle_s", "swing");
+
+  auto wall_start = std::chrono::steady_clock::now();
+  uint64_t sim_start_us = monotonic_us();
+
+  for (int outdoor_c = low_c; outdoor_c <= high_c; outdoor_c += step_c) {
+    int starts = 0;
+    int lockdowns = 0;
+    int restarts = 0;
+    long start_time_s = 0;
+    float max_coolant_c = outdoor_c;
+    float max_exhaust_c = outdoor_c;
+    int settled = 0;
+    long settle_time_s = 0;
+    float swing_c = 0.0;
+
+    for (int i = 0; i < cycles; i++) {
+      heater_sim_result_t result = heater_sim_cycle(&sim, outdoor_c, HEATER_SIM_RUN_MINUTES, seed++);
+
+      if (result.started) {
+        starts++;
+        start_time_s += result.start_time_s;
+      }
+      restarts += result.restarts;
+      max_coolant_c = max(max_coolant_c, result.max_coolant_c);
+      max_exhaust_c = max(max_exhaust_c, result.max_exhaust_c);
+
+      if (result.settled) {
+        settled++;
+        settle_time_s += result.settle_time_s;
+        swing_c = max(swing_c, result.max_settled_c - result.min_settled_c);
+      }
+
+      if (!result.completed) {
+        lockdowns += result.lockdown;
+        sim_restart_fsm(&sim);
+      }
+    }
+
+    printf("%7dC %7d %6d%% %9ld %9.2f %9d %8.1fC %8.1fC", outdoor_c, cycles, starts * 100 / cycles,
+           starts ? start_time_s / starts : 0L, (float)restarts / cycles, lockdowns, max_coolant_c, max_exhaust_c);
+    if (settled) {
+      printf(" %9ld %8.1fC\n", settle_time_s / settled, swing_c);
+    } else {
+      printf(" %9s %9s\n", "-", "-");
+    }
+  }
+
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  double sim_s = (monotonic_us() - sim_start_us) / 1000000.0;
+  printf("simulated %.0fs in %.2fs wall clock (%.0fx)\n", sim_s, wall_s, wall_s > 0 ? sim_s / wall_s : 0.0);
+}
+
+#endif
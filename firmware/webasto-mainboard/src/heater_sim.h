@@ -0,0 +1,70 @@
+#ifndef __heater_sim_h_
+#define __heater_sim_h_
+
+// Host-only:  a lumped thermal model of the heater (glow plug, combustion
+// chamber, exhaust and coolant loop) closed around the real FSM.  The FSM's
+// outputs (fan %, fuel pump rate, glow plug, circulation/vehicle fan) drive
+// the model, and the model feeds temperatures back in as sensor readings.
+
+#ifdef NATIVE_BUILD
+
+#include <stdint.h>
+
+#define HEATER_SIM_STEP_MS      100
+#define HEATER_SIM_REPORT_MS    1000    // how often the remote sensors report
+#define HEATER_SIM_RUN_MINUTES  20      // timed run before the FSM shuts down
+#define HEATER_SIM_MAX_CYCLE_S  3600    // give up on a cycle after this long
+#define HEATER_SIM_SETTLE_C     1.0     // coolant within this of the target
+
+typedef struct {
+  bool started;             // reached AutoBurn at least once
+  bool completed;           // back in Idle after a cooldown
+  bool lockdown;
+  int start_time_s;         // from StartupEvent to first AutoBurn
+  int restarts;             // FlameMeasure/AutoBurn -> Purging
+  int cycle_time_s;
+  float max_coolant_c;
+  float max_exhaust_c;
+  bool settled;             // coolant came within HEATER_SIM_SETTLE_C of target
+  int settle_time_s;        // from StartupEvent
+  float min_settled_c;      // coolant range once settled, while burning
+  float max_settled_c;
+} heater_sim_result_t;
+
+class HeaterSimulator {
+  public:
+    void reset(float outdoor_c, uint32_t seed);
+    void step(float dt_s);
+    void report(void);
+
+    float coolantC(void) { return _coolant_c; };
+    float exhaustC(void) { return _exhaust_c; };
+    bool isLit(void) { return _lit; };
+
+  protected:
+    int flameResistance(void);
+    float jitter(float range);
+
+  private:
+    float _outdoor_c;
+    float _coolant_c;
+    float _exhaust_c;
+    float _glow_c;
+    float _wick_j;      // primed fuel soaked into the burner wick
+    float _heat_w;
+    float _ignite_c;    // glow plug temperature needed to light the wick
+    bool _lit;
+    uint32_t _seed;
+};
+
+// Run one complete cycle (start, timed run, cooldown) at the given outdoor
+// temperature.  The FSM must already be initialized and idle.
+heater_sim_result_t heater_sim_cycle(HeaterSimulator *sim, float outdoor_c, int run_minutes, uint32_t seed);
+
+// Run cycles across outdoor temperatures and print a start-reliability table.
+// Each cycle gets a different seed, which jitters the ignition behaviour.
+void heater_sim_sweep(int low_c, int high_c, int step_c, int cycles);
+
+#endif
+
+#endif
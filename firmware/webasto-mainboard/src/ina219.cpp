@@ -5,7 +5,10 @@
 
 #include "ina219.h"
 #include "fsm.h"
+#include "fsm_queue.h"
 #include "canbus.h"
+#include "async_log.h"
+#include "sensor_snapshot.h"
 
 void INA219Sensor::init(void)
 {
@@ -19,11 +22,11 @@ void INA219Sensor::init(void)
   }
 
   if (!_valid){
-    Log.error("INA219@%X/I2C not configured correctly", _i2c_address);
+    LOG_ERROR("INA219@%X/I2C not configured correctly", _i2c_address);
     return;
   }
 
-  Log.notice("Setting up INA219@%X/I2C", _i2c_address);
+  LOG_NOTICE("Setting up INA219@%X/I2C", _i2c_address);
 
   // Send the chip a reset, clearing all values to factory defaults
   i2c_write_register_word(0x00, 0x8000);
@@ -96,9 +99,10 @@ int32_t INA219Sensor::convert(int32_t reading)
 
 void INA219Sensor::do_feedback(void)
 { 
+  sensor_snapshot_publish(_id, _value);
   canbus_output_value(_id, _value, _data_bytes);
   
   FlameDetectEvent event;
   event.value = (int)_value;
-  WebastoControlFSM::dispatch(event);       
+  fsm_post(event);       
 }
@@ -7,7 +7,10 @@
 #include "project.h"
 #include "internal_adc.h"
 #include "fsm.h"
+#include "fsm_queue.h"
 #include "canbus.h"
+#include "async_log.h"
+#include "sensor_snapshot.h"
 
 void InternalADCSensor::init(void)
 {
@@ -16,11 +19,11 @@ void InternalADCSensor::init(void)
   }
 
   if (!_valid){
-    Log.error("InternalADC@%d not configured correctly", _channel);
+    LOG_ERROR("InternalADC@%d not configured correctly", _channel);
     return;
   }
 
-  Log.info("Setting up InternalADC@%d", _channel);
+  LOG_NOTICE("Setting up InternalADC@%d", _channel);
 
   // Set the resolution
   analogReadResolution(_bits);
@@ -33,7 +36,7 @@ int32_t InternalADCSensor::get_raw_value(void)
   }
 
 #ifdef VERBOSE_LOGGING
-  Log.notice("Reading Internal ADC Channel %d", _channel);
+  LOG_NOTICE("Reading Internal ADC Channel %d", _channel);
 #endif
   if (_channel == 4) {
     float vref = mainboardDetected ? 3.3 : 3.3; //3.0 for onboard once I put parts on there;
@@ -51,7 +54,7 @@ int32_t InternalADCSensor::convert(int32_t reading)
     int32_t vref = mainboardDetected ? 3300 : 3300; // 3000 once onboard connected
     int32_t retval = (reading * vref * 3) >> _bits;
 #ifdef VERBOSE_LOGGING
-    Log.notice("VSYS = %dmV", retval);
+    LOG_NOTICE("VSYS = %dmV", retval);
 #endif
     return retval;
   }
@@ -66,6 +69,7 @@ int32_t InternalADCSensor::convert(int32_t reading)
 
 void InternalADCSensor::do_feedback(void)
 { 
+  sensor_snapshot_publish(_id, _value);
   canbus_output_value(_id, _value, _data_bytes);
   
   switch (_id) {
@@ -73,7 +77,7 @@ void InternalADCSensor::do_feedback(void)
       {
         InternalTempEvent event;
         event.value = (int)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
 
@@ -81,7 +85,7 @@ void InternalADCSensor::do_feedback(void)
       {
         VSYSLevelEvent event;
         event.value = _value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
 
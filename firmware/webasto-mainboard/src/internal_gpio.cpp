@@ -3,6 +3,7 @@
 
 #include "internal_gpio.h"
 #include "fsm.h"
+#include "sensor_snapshot.h"
 
 
 void InternalGPIODigitalSensor::init(void)
@@ -26,3 +27,8 @@ int32_t InternalGPIODigitalSensor::convert(int32_t reading)
     return !(!reading);
   }
 }
+
+void InternalGPIODigitalSensor::do_feedback(void)
+{
+  sensor_snapshot_publish(_id, _value);
+}
@@ -12,6 +12,7 @@ class InternalGPIODigitalSensor : public LocalSensor {
   protected:
     int32_t get_raw_value(void);
     int32_t convert(int32_t reading);
+    void do_feedback(void);
 
     int _pin;
     bool _active_low;
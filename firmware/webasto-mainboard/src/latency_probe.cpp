@@ -0,0 +1,143 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <pico/time.h>
+#include <canbus_ids.h>
+#include <string.h>
+
+#include "latency_probe.h"
+#include "async_log.h"
+
+latency_stats_t latency_stats[LATENCY_PATH_COUNT];
+
+static const uint32_t latency_slo_us[LATENCY_PATH_COUNT] = {
+  LATENCY_SLO_EMERGENCY_STOP_US,
+  0,
+  0,
+};
+
+// Written from the interrupt, read on core1
+static volatile uint32_t latency_irq_us = 0;
+static volatile bool latency_irq_valid = false;
+
+// Only touched from core1
+typedef struct {
+  uint32_t irq_us;
+  uint32_t dispatch_us;
+  bool has_irq;
+  bool valid;
+} latency_pending_t;
+
+static latency_pending_t latency_pending[LATENCY_PATH_COUNT];
+
+static latency_pending_t latency_active;
+static int latency_active_path = -1;
+static uint32_t latency_react_us;
+static uint32_t latency_output_us;
+static bool latency_has_output;
+
+int latency_path_for_id(int canbus_id)
+{
+  switch (canbus_id) {
+    case CANBUS_ID_EMERGENCY_STOP:
+      return LATENCY_PATH_EMERGENCY_STOP;
+    case CANBUS_ID_IGNITION_SENSE:
+      return LATENCY_PATH_IGNITION;
+    case CANBUS_ID_START_RUN:
+      return LATENCY_PATH_START_RUN;
+    default:
+      return -1;
+  }
+}
+
+void latency_probe_can_irq(void)
+{
+  // Frames are read in bulk, so only the first edge until the next poll counts
+  if (!latency_irq_valid) {
+    latency_irq_us = time_us_32();
+    latency_irq_valid = true;
+  }
+}
+
+void latency_probe_can_rx_done(void)
+{
+  latency_irq_valid = false;
+}
+
+void latency_probe_dispatch(int path)
+{
+  if (path < 0 || path >= LATENCY_PATH_COUNT) {
+    return;
+  }
+
+  latency_pending_t *pending = &latency_pending[path];
+  pending->dispatch_us = time_us_32();
+  pending->has_irq = latency_irq_valid;
+  pending->irq_us = latency_irq_us;
+  pending->valid = true;
+}
+
+void latency_probe_react(int path)
+{
+  if (path < 0 || path >= LATENCY_PATH_COUNT || !latency_pending[path].valid) {
+    return;
+  }
+
+  latency_active = latency_pending[path];
+  latency_pending[path].valid = false;
+  latency_active_path = path;
+  latency_react_us = time_us_32();
+  latency_has_output = false;
+}
+
+void latency_probe_output(void)
+{
+  if (latency_active_path < 0 || latency_has_output) {
+    return;
+  }
+
+  latency_output_us = time_us_32();
+  latency_has_output = true;
+}
+
+void latency_probe_react_done(void)
+{
+  int path = latency_active_path;
+  if (path < 0) {
+    return;
+  }
+  latency_active_path = -1;
+
+  latency_stats_t *stats = &latency_stats[path];
+  latency_pending_t *trace = &latency_active;
+
+  if (trace->has_irq) {
+    timer_histogram_add(&stats->segments[LATENCY_SEGMENT_IRQ_TO_DISPATCH], trace->dispatch_us - trace->irq_us);
+  }
+  timer_histogram_add(&stats->segments[LATENCY_SEGMENT_DISPATCH_TO_REACT], latency_react_us - trace->dispatch_us);
+
+  if (!latency_has_output) {
+    return;
+  }
+
+  uint32_t start_us = trace->has_irq ? trace->irq_us : trace->dispatch_us;
+  uint32_t total_us = latency_output_us - start_us;
+
+  timer_histogram_add(&stats->segments[LATENCY_SEGMENT_REACT_TO_OUTPUT], latency_output_us - latency_react_us);
+  timer_histogram_add(&stats->segments[LATENCY_SEGMENT_END_TO_END], total_us);
+
+  uint32_t slo_us = latency_slo_us[path];
+  if (slo_us && total_us > slo_us) {
+    stats->slo_misses++;
+    LOG_WARNING("Latency path %d took %dus, over its %dus budget", path, total_us, slo_us);
+  }
+}
+
+uint32_t latency_slo(int path)
+{
+  return path >= 0 && path < LATENCY_PATH_COUNT ? latency_slo_us[path] : 0;
+}
+
+void latency_stats_reset(void)
+{
+  memset(latency_stats, 0x00, sizeof(latency_stats));
+}
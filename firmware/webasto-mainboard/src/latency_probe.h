@@ -0,0 +1,66 @@
+#ifndef __latency_probe_h_
+#define __latency_probe_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "timer_stats.h"
+
+// End-to-end latency of the digital inputs that arrive over CAN, from the
+// CAN interrupt to the first output pin written in reaction to them.  Each
+// path is stamped at four points:
+//
+//   CAN IRQ      can_int_wake(), the first edge since the last RX poll
+//   dispatch     canbus_dispatch() handing the frame to the FSM queue
+//   react        fsm_process_events() starting the FSM reaction
+//   output       the first set_open_drain_pin()/digitalWrite()/analogWrite()
+//                (or fuel pump setting) made during that reaction
+//
+// and every completed reaction adds one sample per segment.  A reaction
+// that writes no output only gets the first two segments.  Frames polled
+// without an interrupt (native build) start at dispatch, and their
+// end-to-end time is measured from there.
+//
+// Everything but the IRQ stamp is only touched from core1.  Read back over
+// W-Bus (sensor 0x63).
+
+enum {
+  LATENCY_PATH_EMERGENCY_STOP,
+  LATENCY_PATH_IGNITION,
+  LATENCY_PATH_START_RUN,
+  LATENCY_PATH_COUNT,
+};
+
+enum {
+  LATENCY_SEGMENT_IRQ_TO_DISPATCH,
+  LATENCY_SEGMENT_DISPATCH_TO_REACT,
+  LATENCY_SEGMENT_REACT_TO_OUTPUT,
+  LATENCY_SEGMENT_END_TO_END,
+  LATENCY_SEGMENT_COUNT,
+};
+
+// End-to-end budget for an emergency stop.  Misses are counted and logged.
+#ifndef LATENCY_SLO_EMERGENCY_STOP_US
+#define LATENCY_SLO_EMERGENCY_STOP_US  5000
+#endif
+
+typedef struct {
+  timer_histogram_t segments[LATENCY_SEGMENT_COUNT];
+  uint32_t slo_misses;  // end-to-end over latency_slo()
+} latency_stats_t;
+
+extern latency_stats_t latency_stats[LATENCY_PATH_COUNT];
+
+int latency_path_for_id(int canbus_id);
+
+void latency_probe_can_irq(void);
+void latency_probe_can_rx_done(void);
+void latency_probe_dispatch(int path);
+void latency_probe_react(int path);
+void latency_probe_react_done(void);
+void latency_probe_output(void);
+
+uint32_t latency_slo(int path);     // 0:  no budget
+void latency_stats_reset(void);
+
+#endif
@@ -5,6 +5,7 @@
 #include <Wire.h>
 #include <ArduinoLog.h>
 #include <CoreMutex.h>
+#include <hardware/gpio.h>
 #include <cppQueue.h>
 #include <canbus_mcp2517fd.h>
 #include <canbus.h>
@@ -12,10 +13,15 @@
 #include "project.h"
 #include "wbus.h"
 #include "global_timer.h"
+#include "monotonic.h"
 #include "fram.h"
 #include "device_eeprom.h"
 #include "display.h"
 #include "fsm.h"
+#include "fsm_queue.h"
+#include "async_log.h"
+#include "latency_probe.h"
+#include "supervisor.h"
 
 
 bool mainboardDetected;
@@ -23,9 +29,22 @@ mutex_t startup_mutex;
 
 cppQueue onboard_led_q(sizeof(bool), 4, FIFO);
 
+void can_int_wake(void)
+{
+  // Raw handler that runs ahead of the CAN driver's own pin interrupt.  It
+  // deliberately does not acknowledge the event, it only wakes up core1.
+  if (gpio_get_irq_event_mask(PIN_CAN_INT) & GPIO_IRQ_EDGE_FALL) {
+    latency_probe_can_irq();
+    globalTimer.wake();
+  }
+}
+
 
 void setup() 
 {
+  // Straight back to purging if the watchdog reset us mid-burn
+  supervisor_boot();
+
   mutex_init(&startup_mutex);
 
   mutex_enter_blocking(&startup_mutex);
@@ -51,6 +70,7 @@ void setup()
 
   logSerial->begin(115200);
   Log.begin(LOG_LEVEL_VERBOSE, logSerial);
+  asyncLog.begin(logSerial);
 
   pinMode(PIN_CAN_SOF, INPUT);
 
@@ -65,20 +85,21 @@ void setup()
 
   // Give user time to open a terminal to see first log messages
   delay(10000);
-  Log.notice("Rebooted.");
-  Log.notice("Starting Core 0");
+  LOG_NOTICE("Rebooted.");
+  supervisor_report();
+  LOG_NOTICE("Starting Core 0");
 
   if (mainboardDetected) {
-    Log.notice("Mainboard detected");
+    LOG_NOTICE("Mainboard detected");
   } else {
-    Log.notice("No mainboard detected - bare Pico");
+    LOG_NOTICE("No mainboard detected - bare Pico");
   }
 
   delay(500);
 
   init_device_eeprom();
 
-  Log.notice("Starting I2C0");
+  LOG_NOTICE("Starting I2C0");
   Wire.setSDA(PIN_I2C0_SDA);
   Wire.setSCL(PIN_I2C0_SCL);
   Wire.setClock(I2C0_CLK);
@@ -90,19 +111,24 @@ void setup()
   SPI.setCS(PIN_CAN_SPI_SS);
 
   init_canbus_mcp2517fd(&SPI, PIN_CAN_SPI_SS, PIN_CAN_INT);
+  gpio_add_raw_irq_handler(PIN_CAN_INT, &can_int_wake);
 
   // active low enable for transceiver
   digitalWrite(PIN_CAN_EN, LOW);
 
+  // Sensors may start posting events before core1 has the FSM running.
+  fsm_queue_init();
+
   init_sensors();
   init_fram();
   init_display();
+  update_async_log();
   mutex_exit(&startup_mutex);
 
   delay(1);
 
   CoreMutex m2(&startup_mutex);  
-//  rp2040.wdt_begin(500);
+  supervisor_start();
 }
 
 void setup1(void)
@@ -112,7 +138,10 @@ void setup1(void)
 
   CoreMutex m(&startup_mutex);
 
-  Log.notice("Starting Core 1");
+  LOG_NOTICE("Starting Core 1");
+
+  // The alarm pool is bound to the core that creates it, so do it here.
+  globalTimer.begin();
 
   init_fsm();
 }
@@ -120,34 +149,47 @@ void setup1(void)
 void loop() {
   static int display_count = 0;
 
-  int topOfLoop = millis();
+  uint64_t topOfLoop = monotonic_us();
+  supervisor_beat();
 
   bool ledOn = false;
   onboard_led_q.push(&ledOn);
 
   display_count++;
 
+  supervisor_at(SUPERVISOR_AT_DEVICE_EEPROM);
   update_device_eeprom();
+  supervisor_at(SUPERVISOR_AT_FRAM);
   update_fram();
+  supervisor_at(SUPERVISOR_AT_SENSORS);
   update_sensors();
+  supervisor_at(SUPERVISOR_AT_ASYNC_LOG);
+  update_async_log();
 
   // We want screen updates every second.
   if (display_count % 10 == 1) {
     ledOn = true;
     onboard_led_q.push(&ledOn);
+    supervisor_at(SUPERVISOR_AT_DISPLAY);
     update_display();
   }
 
-  int elapsed = millis() - topOfLoop;
+  supervisor_at(SUPERVISOR_AT_LOOP);
+
+  int elapsed = elapsed_ms_since(topOfLoop);
   if (elapsed >= 100) {
-    Log.warning("Main loop > 100ms (%dms)", elapsed);
+    LOG_WARNING("Main loop > 100ms (%dms)", elapsed);
   }
 
   int delayMs = clamp<int>(100 - elapsed, 1, 100);
 
-  delay(delayMs);
+  // Let core1 pick up the LED queue and anything queued for CAN TX.
+  globalTimer.wake();
 
-//  rp2040.wdt_reset();
+  // Feeds the watchdog if core1 is still beating
+  supervisor_check();
+
+  delay(delayMs);
 }
 
 void loop1(void)
@@ -156,7 +198,8 @@ void loop1(void)
     
   // Hi, ho!  Kermit the frog here.
   // this loop runs on core1 and is primarily just the FSM and globalTimer
-  int topOfLoop = millis();
+  uint64_t topOfLoop = monotonic_us();
+  supervisor_beat();
 
   while (!onboard_led_q.isEmpty()) {
     bool newLedOn;
@@ -167,15 +210,30 @@ void loop1(void)
     }
   }
 
+  supervisor_at(SUPERVISOR_AT_TIMERS);
   globalTimer.tick();
+  supervisor_at(SUPERVISOR_AT_CANBUS_RX);
   update_canbus_rx();
+  latency_probe_can_rx_done();
+  supervisor_at(SUPERVISOR_AT_FSM);
+  fsm_process_events();
+  supervisor_at(SUPERVISOR_AT_CANBUS_TX);
   update_canbus_tx();
+  supervisor_at(SUPERVISOR_AT_LOOP);
 
-  int elapsed = millis() - topOfLoop;
+  int elapsed = elapsed_ms_since(topOfLoop);
   if (elapsed >= 10) {
-    Log.warning("Secondary loop > 10ms (%dms)", elapsed);
+    LOG_WARNING("Secondary loop > 10ms (%dms)", elapsed);
   }
 
-  int delayMs = clamp<int>(10 - elapsed, 1, 10);
-  delay(delayMs);
+  // Feeds the watchdog if core0 is still beating
+  supervisor_check();
+
+  // Sleep until the next timer deadline, a CAN interrupt or a nudge from
+  // core0.  The CAN INT line is level-low while frames are pending, so don't
+  // sleep at all if it is still asserted, or if FSM events are still queued.
+  if (digitalRead(PIN_CAN_INT) == HIGH && !fsm_events_pending()) {
+    supervisor_sleep(CORE1_MAX_SLEEP_MS);
+    globalTimer.wait(CORE1_MAX_SLEEP_MS);
+  }
 }
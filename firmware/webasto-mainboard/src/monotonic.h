@@ -0,0 +1,27 @@
+#ifndef __monotonic_h_
+#define __monotonic_h_
+
+#include <pico.h>
+#include <pico/time.h>
+
+// Single time base for the whole firmware:  64-bit microseconds since boot.
+// Unlike millis() stored in an int (wraps after ~24.8 days), this will not
+// wrap in the lifetime of the hardware, so plain comparisons stay ordered.
+
+inline uint64_t monotonic_us(void)
+{
+  return time_us_64();
+}
+
+inline uint64_t monotonic_ms(void)
+{
+  return time_us_64() / 1000;
+}
+
+inline int elapsed_ms_since(uint64_t start_us)
+{
+  uint64_t now = time_us_64();
+  return now > start_us ? (int)((now - start_us) / 1000) : 0;
+}
+
+#endif
@@ -0,0 +1,611 @@
+// Entry point for the host (Linux) build, "pio run -e native".  Stands in for
+// main.cpp:  brings up the same subsystems on top of lib/native-hal and runs
+// both "cores" from one thread.
+//
+//   program [seconds]    run the firmware for a while on the manual clock
+//   program bench        micro-benchmarks of the hot paths, GlobalTimer
+//                        against the old sorted list (env:native-bench
+//                        for 50 and 200 live timers)
+//   program latency [frames]
+//                        emergency stop frames through canbus_dispatch(),
+//                        reporting the latency probe histograms
+//   program sim [low high step cycles]
+//                        heater simulator sweep over outdoor temperatures (C)
+//   program stall [core]
+//                        one core stops beating mid-burn:  when the other
+//                        notices, what the pins do, and the record read
+//                        back after the pretend watchdog reset
+//
+// The unit tests (test/test_native) only take mainboardDetected from here.
+
+#ifdef NATIVE_BUILD
+
+#include <Beirdo-Utilities.h>
+
+#include <Arduino.h>
+#include <pico.h>
+#include <ArduinoLog.h>
+#include <canbus_ids.h>
+#include <canbus.h>
+#include <canbus_dispatch.h>
+#include <native_hal.h>
+
+#include <chrono>
+
+#include "project.h"
+#include "global_timer.h"
+#include "monotonic.h"
+#include "sensor_registry.h"
+#include "sensor_snapshot.h"
+#include "device_eeprom.h"
+#include "fram.h"
+#include "fsm.h"
+#include "fsm_queue.h"
+#include "heater_sim.h"
+#include "async_log.h"
+#include "latency_probe.h"
+#include "supervisor.h"
+#include "state_names.h"
+
+bool mainboardDetected = false;
+
+#ifndef PIO_UNIT_TESTING
+
+#define NATIVE_RUN_SECONDS  60
+
+static void native_setup(void)
+{
+  Serial.begin(115200);
+  Log.begin(LOG_LEVEL_NOTICE, &Serial);
+  asyncLog.begin(&Serial);
+  LOG_NOTICE("Starting native build");
+
+  native_set_core_num(0);
+  init_device_eeprom();
+  fsm_queue_init();
+  init_sensors();
+  init_fram();
+
+  native_set_core_num(1);
+  globalTimer.begin();
+  init_fsm();
+  update_async_log();
+}
+
+static void native_run(int seconds)
+{
+  native_clock_set_manual(true);
+  native_setup();
+
+  uint64_t end_us = monotonic_us() + (uint64_t)seconds * 1000000;
+  uint64_t next_core0_us = monotonic_us();
+
+  while (monotonic_us() < end_us) {
+    if (monotonic_us() >= next_core0_us) {
+      native_set_core_num(0);
+      update_device_eeprom();
+      update_fram();
+      update_sensors();
+      update_async_log();
+      native_set_core_num(1);
+      next_core0_us += 100000;
+    }
+
+    globalTimer.tick();
+    fsm_process_events();
+
+    // wait() advances the manual clock to the next deadline
+    int64_t until_core0_us = (int64_t)(next_core0_us - monotonic_us());
+    int max_ms = clamp<int>((until_core0_us + 999) / 1000, 1, CORE1_MAX_SLEEP_MS);
+    globalTimer.wait(max_ms);
+  }
+
+  LOG_NOTICE("Ran %d simulated seconds, FSM state %d", seconds, fsm_state);
+  update_async_log();
+}
+
+
+// Benchmarks run on the real clock.  Numbers are host numbers:  useful for
+// comparing changes to each other, not as RP2040 timings.
+
+typedef void (*bench_func)(int iteration);
+
+static void bench(const char *name, bench_func func, int iterations)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    func(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+  printf("%-40s %10.1f ns/op\n", name, ns);
+}
+
+static void bench_timer_callback(int timer_id, int delay_ms)
+{
+  (void)timer_id;
+  (void)delay_ms;
+}
+
+// GlobalTimer as it was before the heap pool:  a malloc'd list sorted by
+// target, searched by timer id, and ticked on millis().  Only here as the
+// baseline for the timer benchmarks.
+typedef struct bench_list_item_s {
+  int timer_id;
+  int start_ms;
+  int target_ms;
+  timer_callback cb;
+  struct bench_list_item_s *next;
+} bench_list_item_t;
+
+class BenchListTimer {
+  public:
+    BenchListTimer(void) : _last_run(0), _head(0) { mutex_init(&_mutex); };
+
+    void register_timer(int timer_id, int delay_ms, timer_callback cb)
+    {
+      if (delay_ms <= 0 || !cb) {
+        return;
+      }
+
+      Log.notice("Registering timer: %d -> %dms", timer_id, delay_ms);
+
+      bench_list_item_t *item = (bench_list_item_t *)malloc(sizeof(bench_list_item_t));
+      item->timer_id = timer_id;
+      item->start_ms = millis();
+      item->target_ms = item->start_ms + delay_ms;
+      item->cb = cb;
+      item->next = 0;
+
+      CoreMutex m(&_mutex);
+      insert_item(item);
+    };
+
+    void cancel_timer_id(int timer_id)
+    {
+      CoreMutex m(&_mutex);
+      free(remove_item(timer_id));
+    };
+
+    void tick(void)
+    {
+      int now = millis();
+      if (now == _last_run) {
+        return;
+      }
+
+      _last_run = now;
+
+      mutex_enter_blocking(&_mutex);
+      bench_list_item_t *curr, *old_head = _head, *new_head;
+      for (curr = _head; curr; curr = curr->next) {
+        if (curr->target_ms > now) {
+          break;
+        }
+        _head = curr->next;
+      }
+      new_head = _head;
+      mutex_exit(&_mutex);
+
+      bench_list_item_t *next;
+      for (curr = old_head; curr && curr != new_head; curr = next) {
+        int elapsed = now - curr->start_ms;
+        Log.notice("Calling callback: %d, %dms", curr->timer_id, elapsed);
+        (*curr->cb)(curr->timer_id, elapsed);
+
+        next = curr->next;
+        free(curr);
+      }
+    };
+
+  private:
+    bench_list_item_t *remove_item(int timer_id)
+    {
+      bench_list_item_t *curr, *prev;
+      for (curr = _head, prev = 0; curr; prev = curr, curr = curr->next) {
+        if (curr->timer_id == timer_id) {
+          if (!prev) {
+            _head = curr->next;
+          } else {
+            prev->next = curr->next;
+          }
+          break;
+        }
+      }
+      return curr;
+    };
+
+    void insert_item(bench_list_item_t *item)
+    {
+      bench_list_item_t *curr, *prev;
+      for (curr = _head, prev = 0; curr; prev = curr, curr = curr->next) {
+        if (curr->target_ms > item->target_ms) {
+          break;
+        }
+      }
+
+      item->next = curr;
+      if (!prev) {
+        _head = item;
+      } else {
+        prev->next = item;
+      }
+    };
+
+    int _last_run;
+    bench_list_item_t *_head;
+    mutex_t _mutex;
+};
+
+// Both timers with the same number of long-lived timers (an hour out) parked
+// in them.  Registrations land in the middle of those.
+#define BENCH_TIMER_PARKED_MS   3600000
+
+static GlobalTimer *bench_heap_timer;
+static BenchListTimer *bench_list_timer;
+static int bench_timer_live;
+
+static void bench_heap_register_cancel(int iteration)
+{
+  (void)iteration;
+  timer_handle_t handle = bench_heap_timer->register_timer(TIMER_STAGE_RETRY, BENCH_TIMER_PARKED_MS + bench_timer_live / 2,
+                                                           &bench_timer_callback);
+  bench_heap_timer->cancel_timer(handle);
+}
+
+static void bench_list_register_cancel(int iteration)
+{
+  (void)iteration;
+  bench_list_timer->register_timer(TIMER_STAGE_RETRY, BENCH_TIMER_PARKED_MS + bench_timer_live / 2, &bench_timer_callback);
+  bench_list_timer->cancel_timer_id(TIMER_STAGE_RETRY);
+}
+
+static void bench_heap_tick_idle(int iteration)
+{
+  (void)iteration;
+  bench_heap_timer->tick();
+}
+
+static void bench_list_tick_idle(int iteration)
+{
+  (void)iteration;
+  bench_list_timer->tick();
+}
+
+// The fuel pump's pattern:  a short timer that fires and is registered
+// again.  On the manual clock, 1ms per iteration.
+static void bench_heap_register_fire(int iteration)
+{
+  (void)iteration;
+  bench_heap_timer->register_timer(TIMER_FUEL_PUMP, 1, &bench_timer_callback);
+  native_clock_advance_us(1000);
+  bench_heap_timer->tick();
+}
+
+static void bench_list_register_fire(int iteration)
+{
+  (void)iteration;
+  bench_list_timer->register_timer(TIMER_FUEL_PUMP, 1, &bench_timer_callback);
+  native_clock_advance_us(1000);
+  bench_list_timer->tick();
+}
+
+static void bench_timers(void)
+{
+  static const int live_counts[] = { 10, 50, 200 };
+
+  for (size_t i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+    int count = live_counts[i];
+    char name[64];
+
+    // One more slot for the timer being benchmarked
+    if (count + 1 > GLOBAL_TIMER_POOL_SIZE) {
+      printf("timers, %d live:  skipped, GLOBAL_TIMER_POOL_SIZE is %d (env:native-bench)\n", count,
+             GLOBAL_TIMER_POOL_SIZE);
+      continue;
+    }
+
+    bench_heap_timer = new GlobalTimer();
+    bench_list_timer = new BenchListTimer();
+    bench_timer_live = count;
+
+    for (int j = 0; j < count; j++) {
+      bench_heap_timer->register_timer(TIMER_RUN_TIME_MINUTE, BENCH_TIMER_PARKED_MS + j, &bench_timer_callback);
+      bench_list_timer->register_timer(TIMER_RUN_TIME_MINUTE, BENCH_TIMER_PARKED_MS + j, &bench_timer_callback);
+    }
+
+    snprintf(name, sizeof(name), "heap register+cancel (%d live)", count);
+    bench(name, bench_heap_register_cancel, 1000000);
+    snprintf(name, sizeof(name), "list register+cancel (%d live)", count);
+    bench(name, bench_list_register_cancel, 1000000);
+    snprintf(name, sizeof(name), "heap tick, nothing due (%d live)", count);
+    bench(name, bench_heap_tick_idle, 1000000);
+    snprintf(name, sizeof(name), "list tick, nothing due (%d live)", count);
+    bench(name, bench_list_tick_idle, 1000000);
+
+    native_clock_set_manual(true);
+    snprintf(name, sizeof(name), "heap register+fire (%d live)", count);
+    bench(name, bench_heap_register_fire, 50000);
+    snprintf(name, sizeof(name), "list register+fire (%d live)", count);
+    bench(name, bench_list_register_fire, 50000);
+    native_clock_set_manual(false);
+
+    for (int j = 0; j < count; j++) {
+      bench_list_timer->cancel_timer_id(TIMER_RUN_TIME_MINUTE);
+    }
+    delete bench_heap_timer;
+    delete bench_list_timer;
+  }
+}
+
+static void bench_fsm_dispatch(int iteration)
+{
+  CoolantTempEvent event;
+  event.value = iteration & 0x3F;
+  WebastoControlFSM::dispatch(event);
+}
+
+// Empty handler in every state but FlameMeasureState:  just the dispatch
+static void bench_fsm_dispatch_empty(int iteration)
+{
+  FlameDetectEvent event;
+  event.value = iteration & 0x3F;
+  WebastoControlFSM::dispatch(event);
+}
+
+static void bench_fsm_post_process(int iteration)
+{
+  CoolantTempEvent event;
+  event.value = iteration & 0x3F;
+  fsm_post(event);
+  fsm_process_events();
+}
+
+static void bench_sensor_lookup(int iteration)
+{
+  (void)iteration;
+  volatile Sensor *sensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
+  (void)sensor;
+}
+
+// What AutoBurnState pays per tick for its three temperatures, before and
+// after the snapshot
+static void bench_sensor_registry_reads(int iteration)
+{
+  (void)iteration;
+  volatile int32_t value;
+  value = sensorRegistry.get(CANBUS_ID_COOLANT_TEMP_WEBASTO)->get_value();
+  value = sensorRegistry.get(CANBUS_ID_EXTERNAL_TEMP)->get_value();
+  value = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP)->get_value();
+  (void)value;
+}
+
+static void bench_sensor_snapshot_reads(int iteration)
+{
+  (void)iteration;
+  sensor_snapshot_t snapshot;
+  sensor_snapshot_read(&snapshot);
+
+  volatile int32_t value;
+  value = sensor_snapshot_get(&snapshot, CANBUS_ID_COOLANT_TEMP_WEBASTO);
+  value = sensor_snapshot_get(&snapshot, CANBUS_ID_EXTERNAL_TEMP);
+  value = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
+  (void)value;
+}
+
+static void bench_sensor_snapshot_value(int iteration)
+{
+  (void)iteration;
+  volatile int32_t value = sensor_snapshot_value(CANBUS_ID_EXHAUST_TEMP);
+  (void)value;
+}
+
+static void bench_sensor_snapshot_publish(int iteration)
+{
+  sensor_snapshot_publish(CANBUS_ID_EXHAUST_TEMP, iteration);
+}
+
+// What the caller pays:  the ring is drained outside the timed part
+static void bench_log_notice_queued(void)
+{
+  const int batches = 100000;
+  double ns = 0;
+
+  for (int i = 0; i < batches; i++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < LOG_RING_SIZE; j++) {
+      LOG_NOTICE("Bench message %d: %d", i, j);
+    }
+    auto end = std::chrono::steady_clock::now();
+    ns += std::chrono::duration<double, std::nano>(end - start).count();
+    update_async_log();
+  }
+
+  printf("%-40s %10.1f ns/op\n", "log notice, queued", ns / (batches * LOG_RING_SIZE));
+}
+
+static void bench_log_notice_sync(int iteration)
+{
+  Log.notice("Bench message %d: %d", iteration, iteration & 0x3F);
+}
+
+static void native_bench(void)
+{
+  native_setup();
+  Log.setLevel(LOG_LEVEL_ERROR);
+
+  bench_timers();
+
+#ifdef FSM_TABLE_ENGINE
+  printf("fsm engine: table\n");
+#else
+  printf("fsm engine: tinyfsm\n");
+#endif
+  bench("fsm dispatch CoolantTempEvent", bench_fsm_dispatch, 1000000);
+  bench("fsm dispatch FlameDetectEvent (empty)", bench_fsm_dispatch_empty, 10000000);
+  bench("fsm post+process CoolantTempEvent", bench_fsm_post_process, 1000000);
+  bench("sensorRegistry.get", bench_sensor_lookup, 1000000);
+  bench("3 sensors via sensorRegistry", bench_sensor_registry_reads, 1000000);
+  bench("3 sensors via sensor_snapshot_read", bench_sensor_snapshot_reads, 1000000);
+  bench("sensor_snapshot_value", bench_sensor_snapshot_value, 10000000);
+  bench("sensor_snapshot_publish", bench_sensor_snapshot_publish, 1000000);
+
+  // Printed to /dev/null, to compare the cost at the call site
+  FILE *devnull = fopen("/dev/null", "w");
+  HardwareSerial nullSerial(devnull);
+  Log.begin(LOG_LEVEL_NOTICE, &nullSerial);
+  asyncLog.begin(&nullSerial);
+  bench_log_notice_queued();
+  bench("log notice, synchronous", bench_log_notice_sync, 1000000);
+  Log.begin(LOG_LEVEL_ERROR, &Serial);
+  asyncLog.begin(&Serial);
+  fclose(devnull);
+}
+
+// Emergency stop frames on the real clock, the way loop1() handles them:
+// the interrupt, the RX poll dispatching the frame, then the FSM.  Lockdown
+// can only be cleared from the front panel, so the FSM is started over
+// (outside the measured part) before each frame.
+static void native_latency(int frames)
+{
+  static const char *segment_names[LATENCY_SEGMENT_COUNT] = {
+    "CAN IRQ -> dispatch",
+    "dispatch -> react",
+    "react -> output",
+    "end to end",
+  };
+
+  native_setup();
+  Log.setLevel(LOG_LEVEL_ERROR);
+  latency_stats_reset();
+
+  uint8_t asserted = 1;
+  for (int i = 0; i < frames; i++) {
+    globalTimer.cancel_timer_id(TIMER_RESTART_BEEPS);
+    init_fsm();
+    update_async_log();
+
+    latency_probe_can_irq();
+    canbus_dispatch(CANBUS_ID_EMERGENCY_STOP, &asserted, 1, CAN_DATA);
+    latency_probe_can_rx_done();
+    fsm_process_events();
+    update_async_log();
+  }
+
+  latency_stats_t *stats = &latency_stats[LATENCY_PATH_EMERGENCY_STOP];
+  printf("emergency stop, %d frames, budget %dus, %d over\n", frames,
+         (int)latency_slo(LATENCY_PATH_EMERGENCY_STOP), (int)stats->slo_misses);
+  printf("%-24s %8s %8s %8s %8s\n", "segment", "count", "min_us", "max_us", "p99_us");
+  for (int i = 0; i < LATENCY_SEGMENT_COUNT; i++) {
+    timer_histogram_t *hist = &stats->segments[i];
+    printf("%-24s %8u %8u %8u %8u\n", segment_names[i], hist->count, hist->min_us, hist->max_us,
+           timer_histogram_percentile(hist, 99));
+  }
+}
+
+static void native_sim(int argc, char **argv)
+{
+  int low_c = argc > 2 ? atoi(argv[2]) : -30;
+  int high_c = argc > 3 ? atoi(argv[3]) : 10;
+  int step_c = argc > 4 ? max(atoi(argv[4]), 1) : 5;
+  int cycles = argc > 5 ? max(atoi(argv[5]), 1) : 10;
+
+  native_clock_set_manual(true);
+  native_setup();
+  Log.setLevel(getenv("SIMLOG") ? LOG_LEVEL_VERBOSE : LOG_LEVEL_WARNING);
+
+  heater_sim_sweep(low_c, high_c, step_c, cycles);
+}
+
+// Both loops on the manual clock at 10ms steps, core0 beating every 100ms
+// and core1 every 10ms, until one of them stops in the middle of its pass
+static void native_stall(int stalled_core)
+{
+  native_clock_set_manual(true);
+  native_setup();
+  Log.setLevel(LOG_LEVEL_ERROR);
+
+  // As if AutoBurnState were running
+  set_fsm_state(WB_STATE_PH);
+  supervisor_start();
+
+  uint32_t stall_ms = 1000;
+  int tripped_ms = -1;
+  int expired_ms = -1;
+  int where = stalled_core ? SUPERVISOR_AT_FSM : SUPERVISOR_AT_DISPLAY;
+
+  // Core0 passes every 100ms and nudges core1, which otherwise sleeps as
+  // long as it may
+  uint32_t next_core1_ms = 0;
+
+  for (uint32_t ms = 0; ms < 5000 && expired_ms < 0; ms += 10) {
+    for (int core = 0; core < 2; core++) {
+      if ((core == 0 && ms % 100) || (core == 1 && ms < next_core1_ms)) {
+        continue;
+      }
+
+      native_set_core_num(core);
+      if (core == stalled_core && ms >= stall_ms) {
+        if (ms == stall_ms) {
+          supervisor_beat();
+          supervisor_at(where);
+        }
+        continue;
+      }
+
+      supervisor_beat();
+      supervisor_check();
+
+      if (core == 0) {
+        next_core1_ms = ms;
+      } else {
+        supervisor_sleep(CORE1_MAX_SLEEP_MS);
+        next_core1_ms = ms + CORE1_MAX_SLEEP_MS;
+      }
+    }
+
+    if (tripped_ms < 0 && native_digital_output(PIN_FUEL_PUMP) == LOW &&
+        native_analog_output(PIN_COMBUSTION_FAN) == 255) {
+      tripped_ms = ms;
+    }
+    if (native_watchdog_expired()) {
+      expired_ms = ms;
+    }
+    update_async_log();
+    native_clock_advance_us(10000);
+  }
+  native_set_core_num(1);
+
+  printf("core%d stalled at %ums in %s\n", stalled_core, stall_ms, supervisor_location_name(where));
+  printf("fast path at %dms, watchdog bit at %dms\n", tripped_ms, expired_ms);
+
+  native_watchdog_reboot();
+  supervisor_boot();
+
+  supervisor_reset_t *reset = &supervisor_reset;
+  printf("after reset:  valid %d, stalled %X (%dms), core0 in %s, core1 in %s, state %X, purge %d, fan %d\n",
+         reset->valid, reset->stalled, reset->stall_ms, supervisor_location_name(reset->where[0]),
+         supervisor_location_name(reset->where[1]), reset->fsm_state, reset->purge,
+         native_digital_output(PIN_COMBUSTION_FAN));
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && !strcmp(argv[1], "bench")) {
+    native_bench();
+  } else if (argc > 1 && !strcmp(argv[1], "latency")) {
+    native_latency(argc > 2 ? max(atoi(argv[2]), 1) : 1000);
+  } else if (argc > 1 && !strcmp(argv[1], "sim")) {
+    native_sim(argc, argv);
+  } else if (argc > 1 && !strcmp(argv[1], "stall")) {
+    native_stall(argc > 2 ? !!atoi(argv[2]) : 1);
+  } else {
+    native_run(argc > 1 ? atoi(argv[1]) : NATIVE_RUN_SECONDS);
+  }
+  return 0;
+}
+
+#endif
+
+#endif
@@ -8,7 +8,8 @@
 #include "fsm.h"
 #include "fuel_pump.h"
 #include "global_timer.h"
-#include "sensor_registry.h"
+#include "sensor_snapshot.h"
+#include "async_log.h"
 
 OLEDDisplay::OLEDDisplay(uint8_t i2c_address, int width, int height) :
   Display(i2c_address, width/6, height/8), _width(width), _height(height)
@@ -18,11 +19,11 @@ OLEDDisplay::OLEDDisplay(uint8_t i2c_address, int width, int height) :
   _ssd1306 = 0;
 
   if (!isConnected()) {
-    Log.warning("No OLED connected at I2C0/%X", _i2c_address);
+    LOG_WARNING("No OLED connected at I2C0/%X", _i2c_address);
     return;
   }
 
-  Log.notice("Found OLED at I2C0/%X", _i2c_address);
+  LOG_NOTICE("Found OLED at I2C0/%X", _i2c_address);
 
   _x_offset = (_width - (6 * _columns)) / 2;
   _ssd1306 = new Adafruit_SSD1306(_width, _height, &Wire, -1);
@@ -43,7 +44,7 @@ OLEDDisplay::~OLEDDisplay(void)
 
 void OLEDDisplay::timerCallback(int timerId, int delayMs)
 {
-  Log.notice("OLED timer: delay %dms", delayMs);
+  LOG_NOTICE("OLED timer: delay %dms", delayMs);
   if (timerId != TIMER_OLED_LOGO) {
     return;
   }
@@ -105,12 +106,14 @@ void OLEDDisplay::updateDisplay(void)
   printHexByte(19, 0, fsm_mode);
   mutex_exit(&fsm_mutex);
 
+  sensor_snapshot_t snapshot;
+  sensor_snapshot_read(&snapshot);
+
   printLabel(0, 1, "Burn Power:");
   printWatts(16, 1, fuelPumpTimer.getBurnPower());
 
   printLabel(0, 2, "Flame PTC:");
-  Sensor *flameDetectorSensor = sensorRegistry.get(CANBUS_ID_FLAME_DETECTOR);
-  printMilliohms(15, 2, flameDetectorSensor->get_value());
+  printMilliohms(15, 2, sensor_snapshot_get(&snapshot, CANBUS_ID_FLAME_DETECTOR));
 
   printLabel(0, 3, "CF:");
   printPercent(6, 3, combustionFanPercent);
@@ -118,23 +121,19 @@ void OLEDDisplay::updateDisplay(void)
   printLabel(11, 3, "VF:");
   printPercent(17, 3, vehicleFanPercent);
 
-  Sensor *internalTempSensor = sensorRegistry.get(CANBUS_ID_INTERNAL_TEMP);
-  int temp = internalTempSensor->get_value();
+  int temp = sensor_snapshot_get(&snapshot, CANBUS_ID_INTERNAL_TEMP);
   printLabel(0, 4, "Internal:");
   printTemperature(13, 4, temp);
 
-  Sensor *externalTempSensor = sensorRegistry.get(CANBUS_ID_EXTERNAL_TEMP);
-  temp = externalTempSensor->get_value();
+  temp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXTERNAL_TEMP);
   printLabel(0, 5, "Outdoors:");
   printTemperature(13, 5, temp);
 
-  Sensor *coolantTempSensor = sensorRegistry.get(CANBUS_ID_COOLANT_TEMP_WEBASTO);
-  temp = coolantTempSensor->get_value();
+  temp = sensor_snapshot_get(&snapshot, CANBUS_ID_COOLANT_TEMP_WEBASTO);
   printLabel(0, 6, "Coolant:");
   printTemperature(13, 6, temp);
 
-  Sensor *exhaustTempSensor = sensorRegistry.get(CANBUS_ID_EXHAUST_TEMP);
-  temp = exhaustTempSensor->get_value();
+  temp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP);
   printLabel(0, 7, "Exhaust:");
   printTemperature(13, 7, temp);
 
@@ -148,7 +147,7 @@ void OLEDDisplay::updateDisplay(void)
 
 void oledTimerCallback(int timerId, int delayMs)
 {
-  Log.notice("Received OLED callback: %d, %dms", timerId, delayMs);
+  LOG_NOTICE("Received OLED callback: %d, %dms", timerId, delayMs);
   OLEDDisplay *oled = dynamic_cast<OLEDDisplay *>(display);
 
   if (oled && timerId == TIMER_OLED_LOGO) {
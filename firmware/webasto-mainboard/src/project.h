@@ -92,23 +92,17 @@
 #define COOLANT_IDLE_THRESHOLD  7500    // 75C
 #define COOLANT_MAX_THRESHOLD   8500    // 85C - too hot!!!
 
-#define THROTTLE_HIGH_FUEL(x)   (double)((x) <= WINTER_TEMP_THRESHOLD ? 1.8 : 1.6)
-#define THROTTLE_HIGH_FAN       90
+// AutoBurnState's throttle targets are in throttle_map.cpp
 
-#define THROTTLE_STEADY_FUEL    (double)(1.3)
-#define THROTTLE_STEADY_FAN     65
-
-#define THROTTLE_LOW_FUEL       (double)(0.83)
-#define THROTTLE_LOW_FAN        55
-
-#define THROTTLE_IDLE_FUEL      (double)(0.6)
-#define THROTTLE_IDLE_FAN       30
-
-#define START_FUEL(x)           (double)((x) <= WINTER_TEMP_THRESHOLD ? 1.2 : 1.0)
+#define START_FUEL(x)           ((x) <= WINTER_TEMP_THRESHOLD ? 120 : 100)  // fuel need * 100
 #define START_FAN               40
 
 #define PURGE_FAN               80
 
+// Longest core1 will sleep with nothing pending (no timer, CAN or core0 nudge).
+// SUPERVISOR_WATCHDOG_MS is sized from it.
+#define CORE1_MAX_SLEEP_MS      1000
+
 extern bool mainboardDetected;
 
 void init_sensors(void);
@@ -6,10 +6,14 @@
 #include "internal_gpio.h"
 #include "ina219.h"
 #include "sensor_registry.h"
+#include "sensor_snapshot.h"
 #include "fsm.h"
+#include "fsm_queue.h"
 
 void init_sensors(void)
 {
+  init_sensor_snapshot();
+
   // On the mainboard
   sensorRegistry.add(CANBUS_ID_INTERNAL_TEMP, new InternalADCSensor(CANBUS_ID_INTERNAL_TEMP, 4, 12));
   sensorRegistry.add(CANBUS_ID_FLAME_DETECTOR, new INA219Sensor(CANBUS_ID_FLAME_DETECTOR, 0x4F, 12, &glowPlugInEnable));
@@ -39,54 +43,56 @@ void update_sensors(void)
 
 void RemoteCANBusSensor::do_feedback(void)
 {
+  sensor_snapshot_publish(_id, _value);
+
   switch (_id) {
     case CANBUS_ID_EXTERNAL_TEMP:
       {
         OutdoorTempEvent event;
         event.value = (int)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_BATTERY_VOLTAGE:
       {
         BatteryLevelEvent event;
         event.value = _value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_COOLANT_TEMP_WEBASTO:
       {
         CoolantTempEvent event;
         event.value = (int)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_EXHAUST_TEMP:
       {
         ExhaustTempEvent event;
         event.value = (int)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_IGNITION_SENSE:
       {
         IgnitionEvent event;
         event.enable = (bool)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_START_RUN:
       {
         StartRunEvent event;
         event.enable = (bool)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     case CANBUS_ID_EMERGENCY_STOP:
       {
         EmergencyStopEvent event;
         event.enable = (bool)_value;
-        WebastoControlFSM::dispatch(event);
+        fsm_post(event);
       }
       break;
     default:
@@ -96,6 +102,8 @@ void RemoteCANBusSensor::do_feedback(void)
 
 void RemoteLINBusSensor::do_feedback(void)
 {
+  sensor_snapshot_publish(_id, _value);
+
   switch (_id) {
     case CANBUS_ID_VEHICLE_FAN_SPEED:
     default:
@@ -0,0 +1,121 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <CoreMutex.h>
+#include <canbus_ids.h>
+#include <hardware/sync.h>
+
+#include "sensor_snapshot.h"
+#include "monotonic.h"
+
+// Odd while a publish is in progress
+static volatile uint32_t snapshot_seq = 0;
+static volatile uint32_t snapshot_valid = 0;
+static volatile int32_t snapshot_value[SENSOR_SLOT_COUNT];
+static volatile uint64_t snapshot_stamp_ms[SENSOR_SLOT_COUNT];
+
+static mutex_t snapshot_write_mutex;
+
+void init_sensor_snapshot(void)
+{
+  mutex_init(&snapshot_write_mutex);
+}
+
+int sensor_slot_for_id(int canbus_id)
+{
+  switch (canbus_id) {
+    case CANBUS_ID_INTERNAL_TEMP:
+      return SENSOR_SLOT_INTERNAL_TEMP;
+    case CANBUS_ID_FLAME_DETECTOR:
+      return SENSOR_SLOT_FLAME_DETECTOR;
+    case CANBUS_ID_VSYS_VOLTAGE:
+      return SENSOR_SLOT_VSYS_VOLTAGE;
+    case CANBUS_ID_IGNITION_SENSE:
+      return SENSOR_SLOT_IGNITION_SENSE;
+    case CANBUS_ID_EMERGENCY_STOP:
+      return SENSOR_SLOT_EMERGENCY_STOP;
+    case CANBUS_ID_START_RUN:
+      return SENSOR_SLOT_START_RUN;
+    case CANBUS_ID_EXTERNAL_TEMP:
+      return SENSOR_SLOT_EXTERNAL_TEMP;
+    case CANBUS_ID_BATTERY_VOLTAGE:
+      return SENSOR_SLOT_BATTERY_VOLTAGE;
+    case CANBUS_ID_COOLANT_TEMP_WEBASTO:
+      return SENSOR_SLOT_COOLANT_TEMP;
+    case CANBUS_ID_EXHAUST_TEMP:
+      return SENSOR_SLOT_EXHAUST_TEMP;
+    case CANBUS_ID_VEHICLE_FAN_PERCENT:
+      return SENSOR_SLOT_VEHICLE_FAN_PERCENT;
+    case CANBUS_ID_VEHICLE_FAN_SPEED:
+      return SENSOR_SLOT_VEHICLE_FAN_SPEED;
+    case CANBUS_ID_VEHICLE_FAN_INT_TEMP:
+      return SENSOR_SLOT_VEHICLE_FAN_INT_TEMP;
+    case CANBUS_ID_VEHICLE_FAN_EXT_TEMP:
+      return SENSOR_SLOT_VEHICLE_FAN_EXT_TEMP;
+    default:
+      return -1;
+  }
+}
+
+void sensor_snapshot_publish(int canbus_id, int32_t value)
+{
+  int slot = sensor_slot_for_id(canbus_id);
+  if (slot < 0) {
+    return;
+  }
+
+  CoreMutex m(&snapshot_write_mutex);
+
+  snapshot_seq = snapshot_seq + 1;
+  __dmb();
+
+  snapshot_value[slot] = value;
+  snapshot_stamp_ms[slot] = monotonic_ms();
+  snapshot_valid = snapshot_valid | (1 << slot);
+
+  __dmb();
+  snapshot_seq = snapshot_seq + 1;
+}
+
+void sensor_snapshot_read(sensor_snapshot_t *snapshot)
+{
+  uint32_t seq;
+
+  do {
+    seq = snapshot_seq;
+    if (seq & 1) {
+      continue;
+    }
+    __dmb();
+
+    snapshot->valid = snapshot_valid;
+    for (int i = 0; i < SENSOR_SLOT_COUNT; i++) {
+      snapshot->value[i] = snapshot_value[i];
+      snapshot->stamp_ms[i] = snapshot_stamp_ms[i];
+    }
+
+    __dmb();
+  } while ((seq & 1) || seq != snapshot_seq);
+
+  snapshot->sequence = seq / 2;
+}
+
+int32_t sensor_snapshot_get(const sensor_snapshot_t *snapshot, int canbus_id)
+{
+  int slot = sensor_slot_for_id(canbus_id);
+  if (slot < 0) {
+    return 0;
+  }
+
+  return snapshot->value[slot];
+}
+
+int32_t sensor_snapshot_value(int canbus_id)
+{
+  // A single aligned word can't tear, so no need for the sequence
+  int slot = sensor_slot_for_id(canbus_id);
+  if (slot < 0) {
+    return 0;
+  }
+
+  return snapshot_value[slot];
+}
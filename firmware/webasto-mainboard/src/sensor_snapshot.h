@@ -0,0 +1,55 @@
+#ifndef __sensor_snapshot_h_
+#define __sensor_snapshot_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// The latest value of every sensor, and when it arrived, in one versioned
+// block.  Sensors publish from their do_feedback() (either core); readers
+// copy the block out under a seqlock and never take a lock:  a read that
+// overlaps a publish just goes round again.  Publishers are serialised by a
+// mutex among themselves, and none of them run from an interrupt, so a
+// reader can't spin on a publish that its own core has interrupted.
+//
+// This is for reading values.  The registry is still where the sensor
+// objects live (updating them, actuators).
+
+enum {
+  SENSOR_SLOT_INTERNAL_TEMP,
+  SENSOR_SLOT_FLAME_DETECTOR,
+  SENSOR_SLOT_VSYS_VOLTAGE,
+  SENSOR_SLOT_IGNITION_SENSE,
+  SENSOR_SLOT_EMERGENCY_STOP,
+  SENSOR_SLOT_START_RUN,
+  SENSOR_SLOT_EXTERNAL_TEMP,
+  SENSOR_SLOT_BATTERY_VOLTAGE,
+  SENSOR_SLOT_COOLANT_TEMP,
+  SENSOR_SLOT_EXHAUST_TEMP,
+  SENSOR_SLOT_VEHICLE_FAN_PERCENT,
+  SENSOR_SLOT_VEHICLE_FAN_SPEED,
+  SENSOR_SLOT_VEHICLE_FAN_INT_TEMP,
+  SENSOR_SLOT_VEHICLE_FAN_EXT_TEMP,
+  SENSOR_SLOT_COUNT,
+};
+
+typedef struct {
+  uint32_t sequence;    // publishes so far
+  uint32_t valid;       // bit per slot:  published at least once
+  int32_t value[SENSOR_SLOT_COUNT];
+  uint64_t stamp_ms[SENSOR_SLOT_COUNT];   // monotonic_ms()
+} sensor_snapshot_t;
+
+void init_sensor_snapshot(void);
+int sensor_slot_for_id(int canbus_id);    // -1 if not a sensor
+
+void sensor_snapshot_publish(int canbus_id, int32_t value);
+
+// The whole block, consistent across sensors
+void sensor_snapshot_read(sensor_snapshot_t *snapshot);
+
+// One value from a copy, or straight from the live block.  Sensors that
+// haven't published read as 0, as a fresh Sensor does.
+int32_t sensor_snapshot_get(const sensor_snapshot_t *snapshot, int canbus_id);
+int32_t sensor_snapshot_value(int canbus_id);
+
+#endif
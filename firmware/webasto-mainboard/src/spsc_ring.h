@@ -0,0 +1,63 @@
+#ifndef __spsc_ring_h_
+#define __spsc_ring_h_
+
+#include <Arduino.h>
+#include <pico.h>
+#include <hardware/sync.h>
+
+// Lock-free ring for exactly one producer and one consumer, one per core.
+// Neither side ever blocks:  push() reports a full ring, front() an empty
+// one.  The consumer works on the entry in place and only hands the slot
+// back with pop(), so the producer cannot overwrite it mid-read.
+//
+// head and tail are free-running counters, only the producer writes head
+// and only the consumer writes tail.  The __dmb() orders the entry against
+// the counter on both sides.
+
+template <typename T, uint32_t SIZE>
+class SpscRing {
+  static_assert(SIZE && (SIZE & (SIZE - 1)) == 0, "SpscRing size must be a power of 2");
+
+  public:
+    SpscRing(void) : _head(0), _tail(0) {};
+
+    // Producer side
+    bool push(const T &item)
+    {
+      uint32_t head = _head;
+      if (head - _tail >= SIZE) {
+        return false;
+      }
+
+      _items[head & (SIZE - 1)] = item;
+      __dmb();
+      _head = head + 1;
+      return true;
+    };
+
+    // Consumer side:  the oldest entry, or 0 if there is none
+    T *front(void)
+    {
+      uint32_t tail = _tail;
+      if (tail == _head) {
+        return 0;
+      }
+
+      __dmb();
+      return &_items[tail & (SIZE - 1)];
+    };
+
+    // Hands back the entry front() returned
+    void pop(void)
+    {
+      __dmb();
+      _tail = _tail + 1;
+    };
+
+  private:
+    T _items[SIZE];
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <string.h>
+#include <ArduinoLog.h>
+#include <CoreMutex.h>
+#include <canbus_ids.h>
+
+#include "project.h"
+#include "start_learn.h"
+#include "fram.h"
+#include "monotonic.h"
+#include "sensor_snapshot.h"
+#include "async_log.h"
+
+start_learn_fram_t start_learn;
+start_attempt_t start_learn_last;
+
+static bool start_pending = false;
+static uint64_t start_began_us;
+static uint8_t start_clean_count[START_BAND_COUNT];
+
+static inline int start_learn_step(int value, int step, int limit)
+{
+  return clamp<int>(value + step, -limit, limit);
+}
+
+static inline int start_learn_relax(int value, int step)
+{
+  if (value > 0) {
+    return max(value - step, 0);
+  }
+  return min(value + step, 0);
+}
+
+static void start_learn_store(void)
+{
+  CoreMutex m(&fram_mutex);
+
+  if (memcmp(&fram_data.current.start_learn, &start_learn, sizeof(start_learn))) {
+    memcpy(&fram_data.current.start_learn, &start_learn, sizeof(start_learn));
+    fram_dirty = true;
+  }
+}
+
+void init_start_learn(void)
+{
+  {
+    CoreMutex m(&fram_mutex);
+    start_learn = fram_data.current.start_learn;
+  }
+
+  // Anything out of bounds was not written by us
+  for (int i = 0; i < START_BAND_COUNT; i++) {
+    start_learn.fuel_bias[i] = clamp<int>(start_learn.fuel_bias[i], -START_LEARN_FUEL_LIMIT, START_LEARN_FUEL_LIMIT);
+    start_learn.fan_bias[i] = clamp<int>(start_learn.fan_bias[i], -START_LEARN_FAN_LIMIT, START_LEARN_FAN_LIMIT);
+  }
+
+  memset(&start_learn_last, 0x00, sizeof(start_learn_last));
+  start_learn_last.band = -1;
+  memset(start_clean_count, 0x00, sizeof(start_clean_count));
+  start_pending = false;
+}
+
+void start_learn_reset(void)
+{
+  memset(&start_learn, 0x00, sizeof(start_learn));
+  memset(start_clean_count, 0x00, sizeof(start_clean_count));
+  start_learn_store();
+}
+
+static void start_learn_begin(void)
+{
+  sensor_snapshot_t snapshot;
+  sensor_snapshot_read(&snapshot);
+  int outdoorTemp = sensor_snapshot_get(&snapshot, CANBUS_ID_EXTERNAL_TEMP);
+
+  memset(&start_learn_last, 0x00, sizeof(start_learn_last));
+  start_learn_last.band = start_band(outdoorTemp);
+  start_learn_last.outdoor_temp = clamp<int>(outdoorTemp, INT16_MIN, INT16_MAX);
+  start_learn_last.vbat = clamp<int>(sensor_snapshot_get(&snapshot, CANBUS_ID_BATTERY_VOLTAGE), 0, UINT16_MAX);
+
+  start_began_us = monotonic_us();
+  start_pending = true;
+}
+
+static void start_learn_finish(bool success)
+{
+  start_attempt_t *attempt = &start_learn_last;
+  int band = attempt->band;
+
+  start_pending = false;
+  attempt->success = success;
+  if (success) {
+    attempt->time_to_flame_ms = (uint32_t)((monotonic_us() - start_began_us) / 1000);
+  }
+
+  LOG_NOTICE("Start in band %d (%d, %dmV):  %s, %d retries", band, attempt->outdoor_temp, attempt->vbat,
+             success ? "flame" : "no flame", attempt->retries);
+
+  if (!attempt->retries) {
+    if (!success || ++start_clean_count[band] < START_LEARN_RELAX) {
+      return;
+    }
+
+    start_clean_count[band] = 0;
+    start_learn.fuel_bias[band] = start_learn_relax(start_learn.fuel_bias[band], START_LEARN_FUEL_STEP);
+    start_learn.fan_bias[band] = start_learn_relax(start_learn.fan_bias[band], START_LEARN_FAN_STEP);
+  } else if (attempt->vbat < START_LEARN_MIN_VBAT) {
+    LOG_NOTICE("Battery too low to learn from this start");
+    return;
+  } else {
+    start_clean_count[band] = 0;
+    start_learn.fuel_bias[band] = start_learn_step(start_learn.fuel_bias[band], START_LEARN_FUEL_STEP,
+                                                   START_LEARN_FUEL_LIMIT);
+    start_learn.fan_bias[band] = start_learn_step(start_learn.fan_bias[band], -START_LEARN_FAN_STEP,
+                                                  START_LEARN_FAN_LIMIT);
+  }
+
+  LOG_NOTICE("Start bias for band %d:  fuel %d, fan %d", band, start_learn.fuel_bias[band],
+             start_learn.fan_bias[band]);
+  start_learn_store();
+}
+
+void start_learn_transition(int start)
+{
+  switch (start) {
+    case START_BEGIN:
+      start_learn_begin();
+      break;
+
+    case START_RETRY:
+      if (start_pending && start_learn_last.retries < UINT8_MAX) {
+        start_learn_last.retries++;
+      }
+      break;
+
+    case START_FLAME:
+    case START_GAVE_UP:
+      if (start_pending) {
+        start_learn_finish(start == START_FLAME);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+int start_learn_fuel(int fuel)
+{
+  if (start_pending) {
+    fuel += start_learn.fuel_bias[start_learn_last.band];
+    start_learn_last.fuel = fuel;
+  }
+  return fuel;
+}
+
+int start_learn_fan(int fan)
+{
+  if (start_pending) {
+    fan += start_learn.fan_bias[start_learn_last.band];
+    start_learn_last.fan = fan;
+  }
+  return fan;
+}
@@ -0,0 +1,60 @@
+#ifndef __start_learn_h_
+#define __start_learn_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "state_stats.h"
+
+// Start parameter learning:  TestBurnState's fuel need (START_FUEL()) and
+// combustion fan (START_FAN) get a bias per outdoor temperature band
+// (start_band()), learnt from how earlier starts in that band went.
+//
+// Starts are followed by state_stats_transition() (state_stats.h), which
+// hands each START_* on.  A start that needed a retry makes the next one in
+// its band richer:  more fuel, less air.
+// START_LEARN_RELAX clean starts in a row step it back towards the
+// built-in values.  Starts on a weak battery teach nothing, the glow plug
+// is the likelier culprit there.  Neither does a start that never got as
+// far as a flameout (switched off, an error).
+//
+// The biases live in FRAM (fram_data.current.start_learn) and are bounded
+// by START_LEARN_FUEL_LIMIT and START_LEARN_FAN_LIMIT.  The last start is
+// kept in start_learn_last and read back over W-Bus (sensor 0x67).  Only
+// touched from core1.
+
+#define START_LEARN_FUEL_STEP   5       // fuel need * 100
+#define START_LEARN_FUEL_LIMIT  30
+#define START_LEARN_FAN_STEP    2       // percent
+#define START_LEARN_FAN_LIMIT   10
+#define START_LEARN_RELAX       3       // clean starts per step back
+#define START_LEARN_MIN_VBAT    11500   // 11.5V
+
+typedef struct {
+  int8_t fuel_bias[START_BAND_COUNT];
+  int8_t fan_bias[START_BAND_COUNT];
+} start_learn_fram_t;
+
+typedef struct {
+  int8_t band;              // -1 if no start was seen yet
+  bool success;
+  uint8_t retries;          // flameouts on the way
+  uint8_t fan;              // percent
+  int16_t fuel;             // fuel need * 100
+  int16_t outdoor_temp;     // 1/100 degC
+  uint16_t vbat;            // mV
+  uint32_t time_to_flame_ms;
+} start_attempt_t;
+
+extern start_learn_fram_t start_learn;
+extern start_attempt_t start_learn_last;
+
+void init_start_learn(void);
+void start_learn_transition(int start);      // START_*, from set_fsm_state()
+void start_learn_reset(void);
+
+// Start parameters for the start under way, noted in its record
+int start_learn_fuel(int fuel);
+int start_learn_fan(int fan);
+
+#endif
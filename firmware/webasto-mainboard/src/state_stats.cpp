@@ -0,0 +1,238 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <string.h>
+#include <ArduinoLog.h>
+#include <CoreMutex.h>
+#include <canbus_ids.h>
+
+#include "project.h"
+#include "state_stats.h"
+#include "fram.h"
+#include "global_timer.h"
+#include "monotonic.h"
+#include "sensor_snapshot.h"
+#include "state_names.h"
+#include "async_log.h"
+
+#define STATE_STATS_FLUSH_MS  60000
+
+// Every tracked state (fsm_state.h), in start-up order
+static const uint8_t state_stats_states[STATE_STATS_STATES] = {
+  WB_STATE_OFF,       // Idle
+  WB_STATE_PURGE,     // Purging
+  WB_STATE_PRES,      // Standby
+  WB_STATE_PSFS,      // Prefuel
+  WB_STATE_PREIGN,    // FuelOff
+  WB_STATE_STAB,      // Stabilization
+  WB_STATE_FSTAB,     // TestBurn
+  WB_STATE_FDM,       // FlameMeasure
+  WB_STATE_PH,        // AutoBurn
+  WB_STATE_VENT,      // Cooldown
+  WB_STATE_LOCK2,     // Lockdown
+  WB_STATE_BOADR,     // EmergencyOff
+};
+
+static const int start_band_edges[START_BAND_COUNT - 1] = START_BAND_EDGES;
+
+state_stats_t state_stats[STATE_STATS_STATES];
+start_stats_t start_stats[START_BAND_COUNT];
+
+static uint64_t state_entered_us;
+static uint16_t state_remainder_ms[STATE_STATS_STATES];
+static int state_current_slot = -1;
+static bool state_faulted = false;
+static int start_pending_band = -1;
+
+int state_stats_slot(uint8_t state)
+{
+  for (int i = 0; i < STATE_STATS_STATES; i++) {
+    if (state_stats_states[i] == state) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+uint8_t state_stats_state(int slot)
+{
+  return state_stats_states[slot];
+}
+
+int start_band(int outdoor_temp)
+{
+  int band = 0;
+  while (band < START_BAND_COUNT - 1 && outdoor_temp >= start_band_edges[band]) {
+    band++;
+  }
+  return band;
+}
+
+// 4-bit exponent, 4-bit mantissa:  0-15 as is, then (16 + m) << (e - 1),
+// rounded to nearest, saturating at 0xFF (507904)
+uint8_t state_stats_pack(uint32_t value)
+{
+  if (value < 16) {
+    return value;
+  }
+
+  int shift = 0;
+  while ((value >> shift) >= 32) {
+    shift++;
+  }
+
+  uint32_t mantissa = shift ? (value + (1 << (shift - 1))) >> shift : value;
+  if (mantissa >= 32) {
+    mantissa >>= 1;
+    shift++;
+  }
+
+  if (shift > 14) {
+    return 0xFF;
+  }
+  return ((shift + 1) << 4) | (mantissa - 16);
+}
+
+uint32_t state_stats_unpack(uint8_t packed)
+{
+  int exponent = packed >> 4;
+  uint32_t mantissa = packed & 0x0F;
+
+  if (!exponent) {
+    return mantissa;
+  }
+  return (16 + mantissa) << (exponent - 1);
+}
+
+// Time so far in the current state, without ending the stay
+static void state_stats_accrue(void)
+{
+  uint64_t now = monotonic_us();
+  int slot = state_current_slot;
+
+  if (slot >= 0) {
+    uint32_t elapsed_ms = (uint32_t)((now - state_entered_us) / 1000) + state_remainder_ms[slot];
+    state_stats[slot].seconds += elapsed_ms / 1000;
+    state_remainder_ms[slot] = elapsed_ms % 1000;
+  }
+
+  state_entered_us = now;
+}
+
+static void state_stats_store(void)
+{
+  state_stats_fram_t packed;
+
+  for (int i = 0; i < STATE_STATS_STATES; i++) {
+    packed.entries[i] = state_stats_pack(state_stats[i].entries);
+    packed.abnormal[i] = state_stats_pack(state_stats[i].abnormal);
+    packed.minutes[i] = state_stats_pack((state_stats[i].seconds + 30) / 60);
+  }
+
+  for (int i = 0; i < START_BAND_COUNT; i++) {
+    packed.start_attempts[i] = state_stats_pack(start_stats[i].attempts);
+    packed.start_successes[i] = state_stats_pack(start_stats[i].successes);
+  }
+
+  CoreMutex m(&fram_mutex);
+
+  if (memcmp(&fram_data.current.state_stats, &packed, sizeof(packed))) {
+    memcpy(&fram_data.current.state_stats, &packed, sizeof(packed));
+    fram_dirty = true;
+  }
+}
+
+void init_state_stats(void)
+{
+  {
+    CoreMutex m(&fram_mutex);
+    state_stats_fram_t *packed = &fram_data.current.state_stats;
+
+    for (int i = 0; i < STATE_STATS_STATES; i++) {
+      state_stats[i].entries = state_stats_unpack(packed->entries[i]);
+      state_stats[i].abnormal = state_stats_unpack(packed->abnormal[i]);
+      state_stats[i].seconds = state_stats_unpack(packed->minutes[i]) * 60;
+      state_remainder_ms[i] = 0;
+    }
+
+    for (int i = 0; i < START_BAND_COUNT; i++) {
+      start_stats[i].attempts = state_stats_unpack(packed->start_attempts[i]);
+      start_stats[i].successes = state_stats_unpack(packed->start_successes[i]);
+    }
+  }
+
+  state_entered_us = monotonic_us();
+  state_current_slot = -1;
+  state_faulted = false;
+  start_pending_band = -1;
+
+  globalTimer.register_periodic_timer(TIMER_STATE_STATS, STATE_STATS_FLUSH_MS, STATE_STATS_FLUSH_MS,
+                                      &stateStatsTimerCallback, true);
+}
+
+int state_stats_transition(uint8_t to)
+{
+  state_stats_accrue();
+
+  int slot = state_current_slot;
+  if (slot >= 0 && (state_faulted || to == WB_STATE_LOCK2 || to == WB_STATE_BOADR)) {
+    state_stats[slot].abnormal++;
+  }
+  state_faulted = false;
+
+  slot = state_stats_slot(to);
+  state_current_slot = slot;
+  if (slot >= 0) {
+    state_stats[slot].entries++;
+  }
+
+  int start = START_NONE;
+  if (to == WB_STATE_PRES) {                  // Standby
+    if (start_pending_band < 0) {
+      start_pending_band = start_band(sensor_snapshot_value(CANBUS_ID_EXTERNAL_TEMP));
+      start_stats[start_pending_band].attempts++;
+      start = START_BEGIN;
+    } else {
+      start = START_RETRY;
+    }
+  } else if (start_pending_band >= 0) {
+    if (to == WB_STATE_PH) {                  // AutoBurn
+      start_stats[start_pending_band].successes++;
+      start_pending_band = -1;
+      start = START_FLAME;
+    } else if (to == WB_STATE_OFF || to == WB_STATE_VENT || to == WB_STATE_LOCK2 || to == WB_STATE_BOADR) {
+      start_pending_band = -1;
+      start = START_GAVE_UP;
+    }
+  }
+
+  state_stats_store();
+  return start;
+}
+
+void state_stats_error(void)
+{
+  state_faulted = true;
+}
+
+void state_stats_reset(void)
+{
+  memset(state_stats, 0x00, sizeof(state_stats));
+  memset(start_stats, 0x00, sizeof(start_stats));
+  memset(state_remainder_ms, 0x00, sizeof(state_remainder_ms));
+  state_entered_us = monotonic_us();
+  start_pending_band = -1;
+
+  state_stats_store();
+}
+
+void stateStatsTimerCallback(int timer_id, int delay_ms)
+{
+  (void)delay_ms;
+
+  if (timer_id != TIMER_STATE_STATS) {
+    return;
+  }
+
+  state_stats_accrue();
+  state_stats_store();
+}
@@ -0,0 +1,77 @@
+#ifndef __state_stats_h_
+#define __state_stats_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// Time-in-state and start statistics, to tell which heaters need service
+// before they stop starting.  For every FSM state but Startup:  how often it
+// was entered, how many of those stays ended abnormally (an error was raised
+// during the stay, or it was left for Lockdown or EmergencyOff) and the time
+// spent in it.  For every outdoor temperature band:  start attempts and
+// successes.
+//
+// A start runs from entering Standby until the flame is established
+// (AutoBurn) or the heater gives up (Idle, Cooldown, Lockdown or
+// EmergencyOff).  A flameout on the way sends it back through Purging into
+// Standby as a retry of the same start.  state_stats_transition() is the one
+// place that follows this, and tells start_learn what each transition meant.
+//
+// Counted exactly in RAM, only from core1, and read back over W-Bus (sensor
+// 0x66).  The FRAM copy holds one byte per counter on a log scale
+// (state_stats_pack()):  exact up to 31, within 1/32 above that, time in
+// minutes.  It is loaded at boot and refreshed on every transition and once
+// a minute, so a reboot only loses the rounding.
+
+#define STATE_STATS_STATES  12
+#define START_BAND_COUNT    4
+
+// Outdoor temperature band edges (1/100 degC), coldest first
+#define START_BAND_EDGES    { -1500, -500, 500 }
+
+// What a transition meant for the start (state_stats_transition())
+enum {
+  START_NONE,
+  START_BEGIN,
+  START_RETRY,
+  START_FLAME,
+  START_GAVE_UP,
+};
+
+typedef struct {
+  uint8_t entries[STATE_STATS_STATES];
+  uint8_t abnormal[STATE_STATS_STATES];
+  uint8_t minutes[STATE_STATS_STATES];
+  uint8_t start_attempts[START_BAND_COUNT];
+  uint8_t start_successes[START_BAND_COUNT];
+} state_stats_fram_t;
+
+typedef struct {
+  uint32_t entries;
+  uint32_t abnormal;
+  uint32_t seconds;
+} state_stats_t;
+
+typedef struct {
+  uint32_t attempts;
+  uint32_t successes;
+} start_stats_t;
+
+extern state_stats_t state_stats[STATE_STATS_STATES];
+extern start_stats_t start_stats[START_BAND_COUNT];
+
+int state_stats_slot(uint8_t state);    // -1 if not tracked
+uint8_t state_stats_state(int slot);
+int start_band(int outdoor_temp);
+
+void init_state_stats(void);
+int state_stats_transition(uint8_t to);      // from set_fsm_state(), START_*
+void state_stats_error(void);
+void state_stats_reset(void);
+
+uint8_t state_stats_pack(uint32_t value);
+uint32_t state_stats_unpack(uint8_t packed);
+
+void stateStatsTimerCallback(int timer_id, int delay_ms);
+
+#endif
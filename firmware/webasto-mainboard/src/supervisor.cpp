@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <ArduinoLog.h>
+#include <hardware/gpio.h>
+#include <hardware/sync.h>
+#include <hardware/watchdog.h>
+
+#include "project.h"
+#include "supervisor.h"
+#include "monotonic.h"
+#include "fsm.h"
+#include "async_log.h"
+
+// Scratch registers 0 and 1 are where each core is, 2 the verdict, 3 the
+// FSM state.  The SDK's own reboot bookkeeping lives in 4-7.
+#define SUPERVISOR_SCRATCH_VERDICT  2
+#define SUPERVISOR_SCRATCH_STATE    3
+
+#define SUPERVISOR_MAGIC            0x5AFE0000
+#define SUPERVISOR_MAGIC_MASK       0xFFFF0000
+
+// Verdict:  magic, stalled cores in bits 14-15, heartbeat age in 0-13
+#define SUPERVISOR_STALLED_SHIFT    14
+#define SUPERVISOR_STALL_MS_MASK    0x3FFF
+
+supervisor_reset_t supervisor_reset;
+
+static volatile uint32_t supervisor_beat_ms[2];
+static volatile bool supervisor_running = false;
+static volatile bool supervisor_tripped = false;
+
+static const char *supervisor_location_names[SUPERVISOR_AT_COUNT] = {
+  "loop",
+  "update_device_eeprom",
+  "update_fram",
+  "update_sensors",
+  "update_async_log",
+  "update_display",
+  "globalTimer.tick",
+  "update_canbus_rx",
+  "fsm_process_events",
+  "update_canbus_tx",
+};
+
+const char *supervisor_location_name(int where)
+{
+  if (where < 0 || where >= SUPERVISOR_AT_COUNT) {
+    return "?";
+  }
+  return supervisor_location_names[where];
+}
+
+static inline bool supervisor_scratch_valid(int index)
+{
+  return (watchdog_hw->scratch[index] & SUPERVISOR_MAGIC_MASK) == SUPERVISOR_MAGIC;
+}
+
+void supervisor_boot(void)
+{
+  memset(&supervisor_reset, 0x00, sizeof(supervisor_reset));
+
+  // watchdog_enable_caused_reboot() is only a timeout, not watchdog_reboot()
+  if (watchdog_enable_caused_reboot() && supervisor_scratch_valid(0) && supervisor_scratch_valid(1) &&
+      supervisor_scratch_valid(SUPERVISOR_SCRATCH_STATE)) {
+    uint32_t verdict = watchdog_hw->scratch[SUPERVISOR_SCRATCH_VERDICT];
+
+    supervisor_reset.valid = true;
+    supervisor_reset.where[0] = watchdog_hw->scratch[0] & 0xFF;
+    supervisor_reset.where[1] = watchdog_hw->scratch[1] & 0xFF;
+    supervisor_reset.fsm_state = watchdog_hw->scratch[SUPERVISOR_SCRATCH_STATE] & 0xFF;
+    supervisor_reset.purge = fsm_state_may_be_burning(supervisor_reset.fsm_state);
+
+    if ((verdict & SUPERVISOR_MAGIC_MASK) == SUPERVISOR_MAGIC) {
+      supervisor_reset.stalled = (verdict & ~SUPERVISOR_MAGIC_MASK) >> SUPERVISOR_STALLED_SHIFT;
+      supervisor_reset.stall_ms = verdict & SUPERVISOR_STALL_MS_MASK;
+    }
+  }
+
+  for (int i = 0; i <= SUPERVISOR_SCRATCH_STATE; i++) {
+    watchdog_hw->scratch[i] = 0;
+  }
+
+  if (supervisor_reset.purge) {
+    // Pick the purge back up before anything else, the FSM takes over with
+    // a cooldown once it is running
+    pinMode(PIN_FUEL_PUMP, OUTPUT);
+    digitalWrite(PIN_FUEL_PUMP, LOW);
+    pinMode(PIN_COMBUSTION_FAN, OUTPUT);
+    digitalWrite(PIN_COMBUSTION_FAN, HIGH);
+  }
+}
+
+void supervisor_report(void)
+{
+  if (!supervisor_reset.valid) {
+    return;
+  }
+
+  if (supervisor_reset.stalled) {
+    LOG_ERROR("Watchdog reset:  core stall mask %X (%dms), state %X", supervisor_reset.stalled,
+              supervisor_reset.stall_ms, supervisor_reset.fsm_state);
+  } else {
+    LOG_ERROR("Watchdog reset:  no stall noticed first, state %X", supervisor_reset.fsm_state);
+  }
+
+  LOG_ERROR("Core0 was in %s, core1 in %s", supervisor_location_name(supervisor_reset.where[0]),
+            supervisor_location_name(supervisor_reset.where[1]));
+
+  if (supervisor_reset.purge) {
+    LOG_WARNING("Heater may have been burning, purging");
+  }
+}
+
+void supervisor_start(void)
+{
+  uint32_t now = (uint32_t)monotonic_ms();
+
+  supervisor_beat_ms[0] = now;
+  supervisor_beat_ms[1] = now;
+  watchdog_hw->scratch[0] = SUPERVISOR_MAGIC | SUPERVISOR_AT_LOOP;
+  watchdog_hw->scratch[1] = SUPERVISOR_MAGIC | SUPERVISOR_AT_LOOP;
+  watchdog_hw->scratch[SUPERVISOR_SCRATCH_VERDICT] = 0;
+  supervisor_note_state(fsm_state);
+
+  supervisor_tripped = false;
+  supervisor_running = true;
+  watchdog_enable(SUPERVISOR_WATCHDOG_MS, true);
+}
+
+void supervisor_beat(void)
+{
+  int core = get_core_num();
+
+  supervisor_beat_ms[core] = (uint32_t)monotonic_ms();
+  watchdog_hw->scratch[core] = SUPERVISOR_MAGIC | SUPERVISOR_AT_LOOP;
+}
+
+void supervisor_at(int where)
+{
+  watchdog_hw->scratch[get_core_num()] = SUPERVISOR_MAGIC | (where & 0xFF);
+}
+
+void supervisor_sleep(int max_ms)
+{
+  // A beat in the future:  the age only starts counting once we're overdue
+  supervisor_beat_ms[get_core_num()] = (uint32_t)monotonic_ms() + max_ms;
+}
+
+void supervisor_note_state(uint8_t state)
+{
+  watchdog_hw->scratch[SUPERVISOR_SCRATCH_STATE] = SUPERVISOR_MAGIC | state;
+}
+
+static void supervisor_trip(uint8_t stalled, uint32_t stall_ms)
+{
+  // Fuel and glow plug off, fan to full, straight at the pads
+  gpio_set_outover(PIN_FUEL_PUMP, GPIO_OVERRIDE_LOW);
+  gpio_set_outover(PIN_GLOW_PLUG_OUT, GPIO_OVERRIDE_LOW);
+  gpio_set_outover(PIN_COMBUSTION_FAN, GPIO_OVERRIDE_HIGH);
+
+  stall_ms = min(stall_ms, (uint32_t)SUPERVISOR_STALL_MS_MASK);
+  watchdog_hw->scratch[SUPERVISOR_SCRATCH_VERDICT] = SUPERVISOR_MAGIC | (stalled << SUPERVISOR_STALLED_SHIFT) | stall_ms;
+  supervisor_tripped = true;
+
+  LOG_ERROR("Core stall mask %X (%dms), waiting for the watchdog", stalled, stall_ms);
+}
+
+void supervisor_check(void)
+{
+  if (!supervisor_running || supervisor_tripped) {
+    return;
+  }
+
+  // The calling core is plainly still going, so only the other one counts.
+  // A pass that took longer than SUPERVISOR_STALL_MS shows up from the
+  // other side.
+  int core = get_core_num();
+  int other = !core;
+  int32_t age = (int32_t)((uint32_t)monotonic_ms() - supervisor_beat_ms[other]);
+
+  if (age < SUPERVISOR_STALL_MS) {
+    watchdog_update();
+    return;
+  }
+
+  supervisor_trip(1 << other, age);
+}
@@ -0,0 +1,74 @@
+#ifndef __supervisor_h_
+#define __supervisor_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "project.h"
+
+// Watchdog supervisor.  loop() and loop1() each beat at the top of every
+// pass and say what they are about to call with supervisor_at().
+// supervisor_check(), at the end of both loops, feeds the hardware watchdog
+// only while both heartbeats are fresh.  Before core1 goes to sleep,
+// supervisor_sleep() dates its heartbeat to when it will be back at the
+// latest, so it isn't taken for stalled while asleep.
+//
+// A core that finds the other one stalled takes the fast path:  the fuel
+// pump and glow plug pads are forced low and the combustion fan to full
+// with GPIO output overrides (no locks, so nothing the stalled core can be
+// holding), then it stops feeding and the watchdog resets the chip with the
+// fan purging.  If neither core is left to notice, the watchdog bites on
+// its own.
+//
+// Where each core was, the FSM state and the verdict are kept in watchdog
+// scratch registers 0-3 (the SDK has 4-7) and survive the reset.
+// supervisor_boot() reads them back first thing in setup() and restarts the
+// fan straight away if the heater may have been burning.  The FSM then runs
+// a cooldown rather than going idle.  Read back over W-Bus (sensor 0x65).
+
+#define SUPERVISOR_STALL_MS     250     // heartbeat age that counts as stalled
+
+// Hardware watchdog timeout.  With core0 stalled nothing nudges core1, so it
+// may sleep the full CORE1_MAX_SLEEP_MS before it can notice.
+#define SUPERVISOR_WATCHDOG_MS  (CORE1_MAX_SLEEP_MS + 2 * SUPERVISOR_STALL_MS)
+
+static_assert(SUPERVISOR_WATCHDOG_MS <= 8000, "RP2040 watchdog tops out at ~8.3s");
+
+enum {
+  SUPERVISOR_AT_LOOP,         // between calls, or asleep
+  SUPERVISOR_AT_DEVICE_EEPROM,
+  SUPERVISOR_AT_FRAM,
+  SUPERVISOR_AT_SENSORS,
+  SUPERVISOR_AT_ASYNC_LOG,
+  SUPERVISOR_AT_DISPLAY,
+  SUPERVISOR_AT_TIMERS,
+  SUPERVISOR_AT_CANBUS_RX,
+  SUPERVISOR_AT_FSM,
+  SUPERVISOR_AT_CANBUS_TX,
+  SUPERVISOR_AT_COUNT,
+};
+
+typedef struct {
+  bool valid;           // the last reset was the watchdog's, with a record
+  bool purge;           // the heater may have been burning
+  uint8_t stalled;      // bit per core found stalled, 0 if nobody noticed
+  uint8_t where[2];     // SUPERVISOR_AT_* per core
+  uint8_t fsm_state;
+  uint16_t stall_ms;    // age of the stalled heartbeat when noticed
+} supervisor_reset_t;
+
+extern supervisor_reset_t supervisor_reset;
+
+void supervisor_boot(void);     // first thing in setup()
+void supervisor_report(void);   // once logging is up
+void supervisor_start(void);    // end of setup(), starts the watchdog
+
+void supervisor_beat(void);
+void supervisor_at(int where);
+void supervisor_sleep(int max_ms);
+void supervisor_check(void);
+
+void supervisor_note_state(uint8_t state);
+const char *supervisor_location_name(int where);
+
+#endif
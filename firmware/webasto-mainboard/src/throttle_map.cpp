@@ -0,0 +1,149 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <CoreMutex.h>
+
+#include "throttle_map.h"
+#include "fuel_pump.h"
+#include "fram.h"
+#include "async_log.h"
+
+// Full throttle up to 50C coolant (less fuel once it's mild out), steady at
+// 60C, low at 70C and idle from 75C.
+static constexpr throttle_map_t throttle_map_default = {
+  THROTTLE_MAP_VALID,
+  { 50, 60, 70, 75 },
+  { -20, 10, 20 },
+  {
+    { { 90, 180 }, { 65, 130 }, { 55, 83 }, { 30, 60 } },   // -20C
+    { { 90, 180 }, { 65, 130 }, { 55, 83 }, { 30, 60 } },   //  10C
+    { { 90, 160 }, { 65, 130 }, { 55, 83 }, { 30, 60 } },   //  20C
+  },
+};
+
+static constexpr bool throttle_axis_ascending(const int8_t *axis, int count)
+{
+  for (int i = 1; i < count; i++) {
+    if (axis[i] <= axis[i - 1]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static constexpr bool throttle_points_in_range(const throttle_map_t *map)
+{
+  for (int i = 0; i < THROTTLE_OUTDOOR_POINTS; i++) {
+    for (int j = 0; j < THROTTLE_COOLANT_POINTS; j++) {
+      const throttle_point_t *point = &map->points[i][j];
+      if (point->fan > 100 || point->fuel < MIN_FUEL_NEED || point->fuel > MAX_FUEL_NEED_BURNING) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(throttle_axis_ascending(throttle_map_default.coolant_c, THROTTLE_COOLANT_POINTS), "Throttle map coolant axis must ascend");
+static_assert(throttle_axis_ascending(throttle_map_default.outdoor_c, THROTTLE_OUTDOOR_POINTS), "Throttle map outdoor axis must ascend");
+static_assert(throttle_points_in_range(&throttle_map_default), "Throttle map point out of range");
+
+// Only touched from core1
+static throttle_map_t throttle_map = throttle_map_default;
+
+bool throttle_map_check(const throttle_map_t *map)
+{
+  return map->valid == THROTTLE_MAP_VALID &&
+         throttle_axis_ascending(map->coolant_c, THROTTLE_COOLANT_POINTS) &&
+         throttle_axis_ascending(map->outdoor_c, THROTTLE_OUTDOOR_POINTS) &&
+         throttle_points_in_range(map);
+}
+
+void throttle_map_load(void)
+{
+  CoreMutex m(&fram_mutex);
+
+  const throttle_map_t *stored = &fram_data.current.throttle_map;
+
+  if (stored->valid != THROTTLE_MAP_VALID) {
+    throttle_map = throttle_map_default;
+  } else if (throttle_map_check(stored)) {
+    throttle_map = *stored;
+  } else {
+    LOG_WARNING("Throttle map in FRAM is invalid, using the built-in one");
+    throttle_map = throttle_map_default;
+  }
+}
+
+// Which pair of points value (1/100 degC) falls between, and how far along
+// it is (num / den).  Past either end it sits on the end point.
+static int throttle_segment(const int8_t *axis, int count, int value, int *num, int *den)
+{
+  *num = 0;
+  *den = 1;
+
+  if (value <= axis[0] * 100) {
+    return 0;
+  }
+
+  for (int i = 1; i < count; i++) {
+    if (value < axis[i] * 100) {
+      *num = value - axis[i - 1] * 100;
+      *den = (axis[i] - axis[i - 1]) * 100;
+      return i - 1;
+    }
+  }
+
+  *num = 1;
+  return count - 2;
+}
+
+static inline int throttle_lerp(int a, int b, int num, int den)
+{
+  return a + (b - a) * num / den;
+}
+
+throttle_point_t throttle_map_lookup(int coolant_temp, int outdoor_temp)
+{
+  int c_num, c_den, o_num, o_den;
+  int c = throttle_segment(throttle_map.coolant_c, THROTTLE_COOLANT_POINTS, coolant_temp, &c_num, &c_den);
+  int o = throttle_segment(throttle_map.outdoor_c, THROTTLE_OUTDOOR_POINTS, outdoor_temp, &o_num, &o_den);
+
+  const throttle_point_t *low = throttle_map.points[o];
+  const throttle_point_t *high = throttle_map.points[o + 1];
+
+  int fan_low = throttle_lerp(low[c].fan, low[c + 1].fan, c_num, c_den);
+  int fan_high = throttle_lerp(high[c].fan, high[c + 1].fan, c_num, c_den);
+  int fuel_low = throttle_lerp(low[c].fuel, low[c + 1].fuel, c_num, c_den);
+  int fuel_high = throttle_lerp(high[c].fuel, high[c + 1].fuel, c_num, c_den);
+
+  throttle_point_t point;
+  point.fan = throttle_lerp(fan_low, fan_high, o_num, o_den);
+  point.fuel = throttle_lerp(fuel_low, fuel_high, o_num, o_den);
+  return point;
+}
+
+throttle_point_t throttle_map_idle(int outdoor_temp)
+{
+  return throttle_map_lookup(INT16_MAX, outdoor_temp);
+}
+
+throttle_point_t throttle_map_full(int outdoor_temp)
+{
+  return throttle_map_lookup(INT16_MIN, outdoor_temp);
+}
+
+int throttle_map_fan(int fuel, int outdoor_temp)
+{
+  throttle_point_t idle = throttle_map_idle(outdoor_temp);
+  throttle_point_t full = throttle_map_full(outdoor_temp);
+
+  if (fuel <= idle.fuel || full.fuel <= idle.fuel) {
+    return idle.fan;
+  }
+
+  if (fuel >= full.fuel) {
+    return full.fan;
+  }
+
+  return throttle_lerp(idle.fan, full.fan, fuel - idle.fuel, full.fuel - idle.fuel);
+}
@@ -0,0 +1,45 @@
+#ifndef __throttle_map_h_
+#define __throttle_map_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+// AutoBurnState's throttle targets:  combustion fan percent and fuel need
+// (x100) over coolant temperature x outdoor temperature.  Bilinear between
+// the points, held flat past the ends of each axis, integer maths only.
+//
+// The built-in map can be overridden by one stored in FRAM
+// (fram_data.current.throttle_map), picked up by throttle_map_load() on
+// each entry to AutoBurnState.  A stored map that isn't marked valid, or
+// fails throttle_map_check(), is ignored.
+
+#define THROTTLE_COOLANT_POINTS  4
+#define THROTTLE_OUTDOOR_POINTS  3
+#define THROTTLE_MAP_VALID       0xA5
+
+typedef struct {
+  uint8_t fan;          // percent
+  uint8_t fuel;         // fuel need * 100
+} throttle_point_t;
+
+typedef struct {
+  uint8_t valid;        // THROTTLE_MAP_VALID, or the built-in map is used
+  int8_t coolant_c[THROTTLE_COOLANT_POINTS];  // whole degC, ascending
+  int8_t outdoor_c[THROTTLE_OUTDOOR_POINTS];  // whole degC, ascending
+  throttle_point_t points[THROTTLE_OUTDOOR_POINTS][THROTTLE_COOLANT_POINTS];
+} throttle_map_t;
+
+bool throttle_map_check(const throttle_map_t *map);
+void throttle_map_load(void);
+
+// Temperatures in 1/100 degC, like the sensors.  Idle is the hottest
+// coolant point, full throttle the coldest.
+throttle_point_t throttle_map_lookup(int coolant_temp, int outdoor_temp);
+throttle_point_t throttle_map_idle(int outdoor_temp);
+throttle_point_t throttle_map_full(int outdoor_temp);
+
+// Combustion fan for a given fuel need (x100), on the line between idle and
+// full throttle
+int throttle_map_fan(int fuel, int outdoor_temp);
+
+#endif
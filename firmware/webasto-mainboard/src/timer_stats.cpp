@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include <pico.h>
+#include <string.h>
+
+#include "timer_stats.h"
+
+timer_stats_t timer_stats[TIMER_COUNT];
+
+static int timer_histogram_bucket(uint32_t value_us)
+{
+  if (!value_us) {
+    return 0;
+  }
+
+  int bucket = 32 - __builtin_clz(value_us);
+  return min(bucket, TIMER_STATS_BUCKETS - 1);
+}
+
+void timer_histogram_add(timer_histogram_t *hist, uint32_t value_us)
+{
+  if (!hist->count || value_us < hist->min_us) {
+    hist->min_us = value_us;
+  }
+
+  if (value_us > hist->max_us) {
+    hist->max_us = value_us;
+  }
+
+  hist->count++;
+
+  uint16_t *bucket = &hist->buckets[timer_histogram_bucket(value_us)];
+  if (*bucket != 0xFFFF) {
+    (*bucket)++;
+  }
+}
+
+void timer_stats_record(int timer_id, uint32_t lateness_us, uint32_t duration_us)
+{
+  if (timer_id < 0 || timer_id >= TIMER_COUNT) {
+    return;
+  }
+
+  timer_histogram_add(&timer_stats[timer_id].lateness, lateness_us);
+  timer_histogram_add(&timer_stats[timer_id].duration, duration_us);
+}
+
+void timer_stats_reset(void)
+{
+  memset(timer_stats, 0x00, sizeof(timer_stats));
+}
+
+uint32_t timer_histogram_percentile(timer_histogram_t *hist, int percent)
+{
+  // Returns the upper edge of the bucket holding the requested percentile,
+  // clamped to the observed maximum.
+  uint32_t total = 0;
+  for (int i = 0; i < TIMER_STATS_BUCKETS; i++) {
+    total += hist->buckets[i];
+  }
+
+  if (!total) {
+    return 0;
+  }
+
+  uint32_t threshold = (total * percent + 99) / 100;
+  uint32_t seen = 0;
+  int i;
+  for (i = 0; i < TIMER_STATS_BUCKETS - 1; i++) {
+    seen += hist->buckets[i];
+    if (seen >= threshold) {
+      break;
+    }
+  }
+
+  if (i == TIMER_STATS_BUCKETS - 1) {
+    return hist->max_us;
+  }
+
+  uint32_t edge = i ? (1UL << i) - 1 : 0;
+  return min(edge, hist->max_us);
+}
@@ -0,0 +1,33 @@
+#ifndef __timer_stats_h_
+#define __timer_stats_h_
+
+#include <Arduino.h>
+#include <pico.h>
+
+#include "global_timer.h"
+
+// Log2 buckets in microseconds:  bucket 0 is exactly 0us, bucket n covers
+// [2^(n-1), 2^n) and the last bucket is open-ended (>= ~262ms).
+#define TIMER_STATS_BUCKETS 20
+
+typedef struct {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint16_t buckets[TIMER_STATS_BUCKETS];
+} timer_histogram_t;
+
+typedef struct {
+  timer_histogram_t lateness;   // actual start of callback - target time
+  timer_histogram_t duration;   // callback execution time
+} timer_stats_t;
+
+// Only touched from core1 (GlobalTimer::tick and the W-Bus handlers)
+extern timer_stats_t timer_stats[TIMER_COUNT];
+
+void timer_stats_record(int timer_id, uint32_t lateness_us, uint32_t duration_us);
+void timer_stats_reset(void);
+void timer_histogram_add(timer_histogram_t *hist, uint32_t value_us);
+uint32_t timer_histogram_percentile(timer_histogram_t *hist, int percent);
+
+#endif
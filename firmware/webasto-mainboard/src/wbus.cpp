@@ -17,12 +17,39 @@
 #include "device_eeprom.h"
 #include "canbus.h"
 #include "sensor_registry.h"
+#include "timer_stats.h"
+#include "fsm_queue.h"
+#include "flight_recorder.h"
+#include "latency_probe.h"
+#include "coolant_pi.h"
+#include "supervisor.h"
+#include "state_stats.h"
+#include "start_learn.h"
+#include "async_log.h"
 
 #define WBUS_RX_MATCH_ADDR 0xF4
 #define WBUS_TX_ADDR       0x4F
 
 #define WBUS_BUFFER_SIZE 64
 
+// Not Webasto sensors:  our own timer lateness/duration statistics, FSM
+// event queue statistics, the flight recorder snapshot, CAN input to
+// output latency, the coolant controller, the last watchdog reset, the
+// time-in-state/start statistics and the start parameter learning
+#define WBUS_SENSOR_TIMER_STATS     0x60
+#define WBUS_SENSOR_FSM_QUEUE       0x61
+#define WBUS_SENSOR_FLIGHT_RECORDER 0x62
+#define WBUS_SENSOR_LATENCY         0x63
+#define WBUS_SENSOR_COOLANT_PI      0x64
+#define WBUS_SENSOR_SUPERVISOR      0x65
+#define WBUS_SENSOR_STATE_STATS     0x66
+#define WBUS_SENSOR_START_LEARN     0x67
+
+// Not a Webasto command either:  coolant controller tuning
+#define WBUS_COMMAND_COOLANT_TUNING 0x60
+
+#define WBUS_FLIGHT_ENTRIES_PER_PAGE  5
+
 uint8_t calc_wbus_checksum(uint8_t *buf, int len)
 {
   uint8_t checksum = 0x00;
@@ -47,8 +74,8 @@ uint8_t *allocate_response(uint8_t command, uint8_t len, uint8_t subcommand)
 
 void receive_wbus_from_canbus(uint8_t *buf, int len)
 {
-  Log.notice("Processing WBus packet");
-  hexdump(buf, len, 16);
+  LOG_NOTICE("Processing WBus packet");
+  LOG_HEXDUMP(LOG_LEVEL_NOTICE, buf, len);
 
   wbusPacket_t *respPacket = wbus_rx_dispatch(buf, len);
   if (respPacket) {
@@ -126,7 +153,7 @@ wbusPacket_t *wbus_rx_dispatch(uint8_t *buf, int len)
 
     case 0x50:
       // Read sensors
-      outbuf = wbus_command_read_sensor(buf[3]);
+      outbuf = wbus_command_read_sensor(buf[3], buf[4]);
       break;
 
     case 0x51:
@@ -144,6 +171,13 @@ wbusPacket_t *wbus_rx_dispatch(uint8_t *buf, int len)
       outbuf = wbus_command_co2_calibration(buf[3], buf[4]);
       break;
 
+    case WBUS_COMMAND_COOLANT_TUNING:
+      {
+        int32_t value = (buf[5] << 24) | (buf[6] << 16) | (buf[7] << 8) | buf[8];
+        outbuf = wbus_command_coolant_tuning(buf[3], buf[4], value);
+      }
+      break;
+
     default:
       break;
   }
@@ -171,7 +205,9 @@ uint8_t *wbus_command_shutdown(void)
 
   ShutdownEvent event;
   event.mode = WEBASTO_MODE_DEFAULT;
-  WebastoControlFSM::dispatch(event);
+  event.emergency = false;
+  event.lockdown = false;
+  fsm_post(event);
   return buf;
 }
 
@@ -183,7 +219,7 @@ uint8_t *wbus_command_timed_start(uint8_t mode, uint8_t minutes)
   StartupEvent event;
   event.mode = (int)mode;
   event.minutes = (int)minutes;
-  WebastoControlFSM::dispatch(event);
+  fsm_post(event);
   return buf;
 }
 
@@ -194,9 +230,14 @@ uint8_t *wbus_command_keep_alive(uint8_t mode, uint8_t minutes)
   AddTimeEvent event;
   event.mode = mode;
   event.minutes = minutes;
-  WebastoControlFSM::dispatch(event);
+  fsm_post(event);
 
-  int remaining = globalTimer.get_remaining_time(TIMER_TIMED_SHUT_DOWN) / 60000;
+  // The FSM hasn't applied the extra time yet, so add it in here.
+  int remaining = globalTimer.get_remaining_time(TIMER_TIMED_SHUT_DOWN);
+  if (remaining && minutes) {
+    remaining += minutes * 60000;
+  }
+  remaining /= 60000;
 
   // Add x minutes to the timer for mode, and return the number of minutes left.
   buf[3] = HI_BYTE(remaining);
@@ -214,7 +255,7 @@ uint8_t *wbus_command_component_test(uint8_t component, uint8_t seconds, uint16_
   return buf;
 }
 
-uint8_t *wbus_command_read_sensor(uint8_t sensornum)
+uint8_t *wbus_command_read_sensor(uint8_t sensornum, uint8_t index)
 {
   switch(sensornum) {
     case 0x06:
@@ -235,6 +276,33 @@ uint8_t *wbus_command_read_sensor(uint8_t sensornum)
     case 0x12:
       // Ventilation duration
       return wbus_read_ventilation_duration_sensor();
+    case WBUS_SENSOR_TIMER_STATS:
+      // Timer statistics, index is the timer id (0xFF resets them all)
+      return wbus_read_timer_stats_sensor(index);
+    case WBUS_SENSOR_FSM_QUEUE:
+      // FSM event queue statistics (index 0xFF resets them)
+      return wbus_read_fsm_queue_sensor(index);
+    case WBUS_SENSOR_FLIGHT_RECORDER:
+      // Flight recorder snapshot, index 0 is the header, 1.. the entries
+      // (0xFF clears it)
+      return wbus_read_flight_recorder_sensor(index);
+    case WBUS_SENSOR_LATENCY:
+      // Latency statistics, index is the path (0xFF resets them all)
+      return wbus_read_latency_sensor(index);
+    case WBUS_SENSOR_COOLANT_PI:
+      // Coolant controller terms from its last update
+      return wbus_read_coolant_pi_sensor();
+    case WBUS_SENSOR_SUPERVISOR:
+      // What the watchdog reset us from, if it did
+      return wbus_read_supervisor_sensor();
+    case WBUS_SENSOR_STATE_STATS:
+      // Time-in-state statistics, index is the state slot, 0x80 + band the
+      // start statistics (0xFF resets them all)
+      return wbus_read_state_stats_sensor(index);
+    case WBUS_SENSOR_START_LEARN:
+      // Start biases, index is the band, 0x80 the last start (0xFF resets
+      // the biases)
+      return wbus_read_start_learn_sensor(index);
     default:
       return 0;
   }
@@ -471,3 +539,318 @@ uint8_t *wbus_read_ventilation_duration_sensor(void)
   buf[6] = ventilation_duration.minutes;
   return buf;
 }
+
+static int wbus_put_u16_saturated(uint8_t *buf, int index, uint32_t value)
+{
+  uint16_t clipped = value > 0xFFFF ? 0xFFFF : value;
+  buf[index++] = HI_BYTE(clipped);
+  buf[index++] = LO_BYTE(clipped);
+  return index;
+}
+
+static int wbus_put_u32(uint8_t *buf, int index, uint32_t value)
+{
+  buf[index++] = (value >> 24) & 0xFF;
+  buf[index++] = (value >> 16) & 0xFF;
+  buf[index++] = (value >> 8) & 0xFF;
+  buf[index++] = value & 0xFF;
+  return index;
+}
+
+static int wbus_put_timer_histogram(uint8_t *buf, int index, timer_histogram_t *hist)
+{
+  index = wbus_put_u16_saturated(buf, index, hist->count);
+  index = wbus_put_u16_saturated(buf, index, hist->min_us);
+  index = wbus_put_u16_saturated(buf, index, hist->max_us);
+  index = wbus_put_u16_saturated(buf, index, timer_histogram_percentile(hist, 99));
+  return index;
+}
+
+uint8_t *wbus_read_timer_stats_sensor(uint8_t timer_id)
+{
+  if (timer_id == 0xFF) {
+    timer_stats_reset();
+    uint8_t *buf = allocate_response(0x50, 6, WBUS_SENSOR_TIMER_STATS);
+    buf[4] = timer_id;
+    return buf;
+  }
+
+  if (timer_id >= TIMER_COUNT) {
+    return 0;
+  }
+
+  // count, min, max, p99 (all 16-bit, microseconds, saturated) for lateness
+  // then for callback duration
+  uint8_t *buf = allocate_response(0x50, 22, WBUS_SENSOR_TIMER_STATS);
+  buf[4] = timer_id;
+
+  int index = 5;
+  index = wbus_put_timer_histogram(buf, index, &timer_stats[timer_id].lateness);
+  index = wbus_put_timer_histogram(buf, index, &timer_stats[timer_id].duration);
+  return buf;
+}
+
+uint8_t *wbus_read_fsm_queue_sensor(uint8_t option)
+{
+  if (option == 0xFF) {
+    fsm_queue_reset_stats();
+  }
+
+  fsm_queue_stats_t stats;
+  fsm_queue_get_stats(&stats);
+
+  // depth, high water, capacity, posted, dispatched, dropped, coalesced
+  // (16-bit, saturated)
+  uint8_t *buf = allocate_response(0x50, 19, WBUS_SENSOR_FSM_QUEUE);
+
+  int index = 4;
+  index = wbus_put_u16_saturated(buf, index, fsm_queue_depth());
+  index = wbus_put_u16_saturated(buf, index, stats.high_water);
+  index = wbus_put_u16_saturated(buf, index, FSM_EVENT_QUEUE_SIZE);
+  index = wbus_put_u16_saturated(buf, index, stats.posted);
+  index = wbus_put_u16_saturated(buf, index, stats.dispatched);
+  index = wbus_put_u16_saturated(buf, index, stats.dropped);
+  index = wbus_put_u16_saturated(buf, index, stats.coalesced);
+  return buf;
+}
+
+uint8_t *wbus_read_flight_recorder_sensor(uint8_t page)
+{
+  CoreMutex m(&fram_mutex);
+
+  if (page == 0xFF) {
+    flight_snapshot_clear();
+    uint8_t *buf = allocate_response(0x50, 6, WBUS_SENSOR_FLIGHT_RECORDER);
+    buf[4] = page;
+    return buf;
+  }
+
+  flight_snapshot_t *snapshot = &flight_snapshot;
+
+  if (page == 0) {
+    // version, error code, state, mode, sequence (16-bit), entry count, then
+    // the last reading of each sensor (32-bit signed)
+    uint8_t *buf = allocate_response(0x50, 12 + 4 * FLIGHT_SAMPLE_COUNT, WBUS_SENSOR_FLIGHT_RECORDER);
+    buf[4] = page;
+    buf[5] = snapshot->version;
+    buf[6] = snapshot->error_code;
+    buf[7] = snapshot->fsm_state;
+    buf[8] = snapshot->fsm_mode;
+    buf[9] = HI_BYTE(snapshot->sequence);
+    buf[10] = LO_BYTE(snapshot->sequence);
+    buf[11] = snapshot->count;
+
+    int index = 12;
+    for (int i = 0; i < FLIGHT_SAMPLE_COUNT; i++) {
+      index = wbus_put_u32(buf, index, snapshot->samples[i]);
+    }
+    return buf;
+  }
+
+  int first = (page - 1) * WBUS_FLIGHT_ENTRIES_PER_PAGE;
+  if (first >= snapshot->count) {
+    return 0;
+  }
+
+  // Per entry:  microseconds before the snapshot (32-bit), kind, id and
+  // value (16-bit signed)
+  int count = min(snapshot->count - first, WBUS_FLIGHT_ENTRIES_PER_PAGE);
+  uint8_t *buf = allocate_response(0x50, 6 + 8 * count, WBUS_SENSOR_FLIGHT_RECORDER);
+  buf[4] = page;
+
+  int index = 5;
+  for (int i = first; i < first + count; i++) {
+    flight_record_t *entry = &snapshot->entries[i];
+    index = wbus_put_u32(buf, index, snapshot->time_us - entry->time_us);
+    buf[index++] = entry->kind;
+    buf[index++] = entry->id;
+    buf[index++] = HI_BYTE(entry->value);
+    buf[index++] = LO_BYTE(entry->value);
+  }
+  return buf;
+}
+
+uint8_t *wbus_read_latency_sensor(uint8_t path)
+{
+  if (path == 0xFF) {
+    latency_stats_reset();
+    uint8_t *buf = allocate_response(0x50, 6, WBUS_SENSOR_LATENCY);
+    buf[4] = path;
+    return buf;
+  }
+
+  if (path >= LATENCY_PATH_COUNT) {
+    return 0;
+  }
+
+  // budget, budget misses, then count, min, max, p99 for CAN IRQ to
+  // dispatch, dispatch to react, react to output and end to end (all
+  // 16-bit, microseconds, saturated)
+  latency_stats_t *stats = &latency_stats[path];
+  uint8_t *buf = allocate_response(0x50, 10 + 8 * LATENCY_SEGMENT_COUNT, WBUS_SENSOR_LATENCY);
+  buf[4] = path;
+
+  int index = 5;
+  index = wbus_put_u16_saturated(buf, index, latency_slo(path));
+  index = wbus_put_u16_saturated(buf, index, stats->slo_misses);
+  for (int i = 0; i < LATENCY_SEGMENT_COUNT; i++) {
+    index = wbus_put_timer_histogram(buf, index, &stats->segments[i]);
+  }
+  return buf;
+}
+
+uint8_t *wbus_command_coolant_tuning(uint8_t subcmd, uint8_t index, int32_t value)
+{
+  switch(subcmd) {
+    case 0x01:
+      // read a parameter
+      break;
+    case 0x03:
+      // write a parameter
+      if (!coolant_pi_set_tuning(index, value)) {
+        return 0;
+      }
+      break;
+    default:
+      return 0;
+  }
+
+  if (index >= COOLANT_PI_TUNE_COUNT) {
+    return 0;
+  }
+
+  // index, then the value in effect (32-bit signed)
+  uint8_t *buf = allocate_response(WBUS_COMMAND_COOLANT_TUNING, 10, subcmd);
+  buf[4] = index;
+  wbus_put_u32(buf, 5, coolant_pi_get_tuning(index));
+  return buf;
+}
+
+uint8_t *wbus_read_coolant_pi_sensor(void)
+{
+  coolant_pi_t *pi = &coolant_pi;
+
+  // limit, fan, then error, feedforward, proportional, integral, damping
+  // and fuel (16-bit signed, fuel need x100 but the error in 1/100 degC)
+  uint8_t *buf = allocate_response(0x50, 19, WBUS_SENSOR_COOLANT_PI);
+  int16_t terms[] = {
+    pi->error,
+    pi->feedforward,
+    pi->proportional,
+    (int16_t)clamp<int32_t>(pi->integral >> 16, INT16_MIN, INT16_MAX),
+    pi->damping,
+    pi->fuel,
+  };
+
+  int index = 4;
+  buf[index++] = pi->limited;
+  buf[index++] = pi->fan;
+  for (int i = 0; i < 6; i++) {
+    buf[index++] = HI_BYTE(terms[i]);
+    buf[index++] = LO_BYTE(terms[i]);
+  }
+  return buf;
+}
+
+uint8_t *wbus_read_supervisor_sensor(void)
+{
+  supervisor_reset_t *reset = &supervisor_reset;
+
+  // valid, purge, stalled core mask, core0 and core1 location, FSM state,
+  // stall age in ms (16-bit)
+  uint8_t *buf = allocate_response(0x50, 13, WBUS_SENSOR_SUPERVISOR);
+
+  int index = 4;
+  buf[index++] = reset->valid;
+  buf[index++] = reset->purge;
+  buf[index++] = reset->stalled;
+  buf[index++] = reset->where[0];
+  buf[index++] = reset->where[1];
+  buf[index++] = reset->fsm_state;
+  index = wbus_put_u16_saturated(buf, index, reset->stall_ms);
+  return buf;
+}
+
+uint8_t *wbus_read_state_stats_sensor(uint8_t index)
+{
+  if (index == 0xFF) {
+    state_stats_reset();
+    uint8_t *buf = allocate_response(0x50, 6, WBUS_SENSOR_STATE_STATS);
+    buf[4] = index;
+    return buf;
+  }
+
+  if (index >= 0x80) {
+    int band = index - 0x80;
+    if (band >= START_BAND_COUNT) {
+      return 0;
+    }
+
+    // start attempts, successes (32-bit)
+    start_stats_t *stats = &start_stats[band];
+    uint8_t *buf = allocate_response(0x50, 14, WBUS_SENSOR_STATE_STATS);
+    buf[4] = index;
+
+    int offset = 5;
+    offset = wbus_put_u32(buf, offset, stats->attempts);
+    offset = wbus_put_u32(buf, offset, stats->successes);
+    return buf;
+  }
+
+  if (index >= STATE_STATS_STATES) {
+    return 0;
+  }
+
+  // FSM state, then entries, abnormal exits and seconds spent (32-bit)
+  state_stats_t *stats = &state_stats[index];
+  uint8_t *buf = allocate_response(0x50, 19, WBUS_SENSOR_STATE_STATS);
+  buf[4] = index;
+  buf[5] = state_stats_state(index);
+
+  int offset = 6;
+  offset = wbus_put_u32(buf, offset, stats->entries);
+  offset = wbus_put_u32(buf, offset, stats->abnormal);
+  offset = wbus_put_u32(buf, offset, stats->seconds);
+  return buf;
+}
+
+uint8_t *wbus_read_start_learn_sensor(uint8_t index)
+{
+  if (index == 0xFF) {
+    start_learn_reset();
+    uint8_t *buf = allocate_response(0x50, 6, WBUS_SENSOR_START_LEARN);
+    buf[4] = index;
+    return buf;
+  }
+
+  if (index == 0x80) {
+    // band, success, retries, outdoor temp (16-bit signed), battery (16-bit),
+    // fuel need, fan, time to flame in ms (32-bit)
+    start_attempt_t *attempt = &start_learn_last;
+    uint8_t *buf = allocate_response(0x50, 20, WBUS_SENSOR_START_LEARN);
+    buf[4] = index;
+    buf[5] = attempt->band;
+    buf[6] = attempt->success;
+    buf[7] = attempt->retries;
+    buf[8] = HI_BYTE(attempt->outdoor_temp);
+    buf[9] = LO_BYTE(attempt->outdoor_temp);
+    buf[10] = HI_BYTE(attempt->vbat);
+    buf[11] = LO_BYTE(attempt->vbat);
+    buf[12] = HI_BYTE(attempt->fuel);
+    buf[13] = LO_BYTE(attempt->fuel);
+    buf[14] = attempt->fan;
+    wbus_put_u32(buf, 15, attempt->time_to_flame_ms);
+    return buf;
+  }
+
+  if (index >= START_BAND_COUNT) {
+    return 0;
+  }
+
+  // fuel need bias, fan bias (signed)
+  uint8_t *buf = allocate_response(0x50, 8, WBUS_SENSOR_START_LEARN);
+  buf[4] = index;
+  buf[5] = start_learn.fuel_bias[index];
+  buf[6] = start_learn.fan_bias[index];
+  return buf;
+}
@@ -12,10 +12,11 @@ uint8_t *wbus_command_shutdown(void);
 uint8_t *wbus_command_timed_start(uint8_t mode, uint8_t minutes);
 uint8_t *wbus_command_keep_alive(uint8_t mode, uint8_t minutes);
 uint8_t *wbus_command_component_test(uint8_t component, uint8_t seconds, uint16_t value);
-uint8_t *wbus_command_read_sensor(uint8_t sensornum);
+uint8_t *wbus_command_read_sensor(uint8_t sensornum, uint8_t index = 0);
 uint8_t *wbus_command_read_stuff(uint8_t index);
 uint8_t *wbus_command_get_error_codes(uint8_t subcmd, uint8_t index);
 uint8_t *wbus_command_co2_calibration(uint8_t index, uint8_t value);
+uint8_t *wbus_command_coolant_tuning(uint8_t subcmd, uint8_t index, int32_t value);
 
 uint8_t *wbus_get_error_code_list(void);
 uint8_t *wbus_get_error_code_details(uint8_t index);
@@ -30,5 +31,13 @@ uint8_t *wbus_read_burning_duration_sensor(void);
 uint8_t *wbus_read_operating_duration_sensor(void);
 uint8_t *wbus_read_start_counter_sensor(void);
 uint8_t *wbus_read_ventilation_duration_sensor(void);
+uint8_t *wbus_read_timer_stats_sensor(uint8_t timer_id);
+uint8_t *wbus_read_fsm_queue_sensor(uint8_t option);
+uint8_t *wbus_read_flight_recorder_sensor(uint8_t page);
+uint8_t *wbus_read_latency_sensor(uint8_t path);
+uint8_t *wbus_read_coolant_pi_sensor(void);
+uint8_t *wbus_read_supervisor_sensor(void);
+uint8_t *wbus_read_state_stats_sensor(uint8_t index);
+uint8_t *wbus_read_start_learn_sensor(uint8_t index);
 
 #endif
@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "project.h"
+#include "fram.h"
+#include "fuel_pump.h"
+#include "coolant_pi.h"
+#include "throttle_map.h"
+#include "test_native.h"
+
+// One update from a reset controller (so no damping yet), 15C outdoors on
+// the built-in throttle map:  idle 60 / 30%, full 170 / 90%, feedforward at
+// the 65C target 107.
+
+#define PI_OUTDOOR  1500
+#define PI_IDLE     60
+#define PI_FULL     170
+#define PI_STEP     (COOLANT_PI_KI * COOLANT_PI_PERIOD_MS / 1000)   // per 1/100 degC of error
+
+typedef struct {
+  const char *name;
+  int coolant_temp;
+  int exhaust_temp;
+  int integral;         // fuel (x100) to start from
+  uint8_t limited;
+  int fuel;
+  bool integrates;      // or holds still against the limit
+} coolant_pi_case_t;
+
+static const coolant_pi_case_t coolant_pi_cases[] = {
+  { "unlimited",              6450, 10000,    0, COOLANT_PI_LIMIT_NONE,    121, true },
+  { "high, pushing",          2000, 10000,    0, COOLANT_PI_LIMIT_HIGH,    PI_FULL, false },
+  { "high, coming back",      6600, 10000,  150, COOLANT_PI_LIMIT_HIGH,    PI_FULL, true },
+  { "low, pushing",           7400, 10000,    0, COOLANT_PI_LIMIT_LOW,     PI_IDLE, false },
+  { "low, coming back",       6400, 10000, -200, COOLANT_PI_LIMIT_LOW,     PI_IDLE, true },
+  { "exhaust, pushing",       2000, 19000,    0, COOLANT_PI_LIMIT_EXHAUST, 115, false },
+  { "exhaust, coming back",   6600, 19000,  150, COOLANT_PI_LIMIT_EXHAUST, 115, true },
+  { "exhaust band top",       2000, 20000,    0, COOLANT_PI_LIMIT_EXHAUST, PI_IDLE, false },
+  { "exhaust under band",     2000, 17999,    0, COOLANT_PI_LIMIT_HIGH,    PI_FULL, false },
+  { "idle, coolant",          7500, 10000, -200, COOLANT_PI_LIMIT_IDLE,    PI_IDLE, false },
+  { "idle, exhaust",          2000, 20001,  150, COOLANT_PI_LIMIT_IDLE,    PI_IDLE, false },
+};
+
+static void test_coolant_pi_begin(void)
+{
+  test_firmware_start();
+  fram_data.current.throttle_map.valid = 0;
+  throttle_map_load();
+
+  coolant_pi_set_tuning(COOLANT_PI_TUNE_KP, COOLANT_PI_KP);
+  coolant_pi_set_tuning(COOLANT_PI_TUNE_KI, COOLANT_PI_KI);
+  coolant_pi_set_tuning(COOLANT_PI_TUNE_KD, COOLANT_PI_KD);
+  coolant_pi_set_tuning(COOLANT_PI_TUNE_TARGET, COOLANT_TARGET_TEMP);
+  coolant_pi_reset();
+}
+
+static void test_coolant_pi_limits(void)
+{
+  test_coolant_pi_begin();
+
+  for (const coolant_pi_case_t &c : coolant_pi_cases) {
+    coolant_pi_reset();
+    coolant_pi.integral = c.integral << 16;
+    coolant_pi_update(c.coolant_temp, PI_OUTDOOR, c.exhaust_temp);
+
+    int error = COOLANT_TARGET_TEMP - c.coolant_temp;
+    int32_t expected = (c.integral << 16) + (c.integrates ? PI_STEP * error : 0);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.limited, coolant_pi.limited, c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.fuel, coolant_pi.fuel, c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected, coolant_pi.integral, c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(throttle_map_fan(c.fuel, PI_OUTDOOR), coolant_pi.fan, c.name);
+  }
+}
+
+static void test_coolant_pi_terms(void)
+{
+  test_coolant_pi_begin();
+
+  coolant_pi_update(6450, PI_OUTDOOR, 10000);
+  TEST_ASSERT_EQUAL_INT(50, coolant_pi.error);
+  TEST_ASSERT_EQUAL_INT(107, coolant_pi.feedforward);
+  TEST_ASSERT_EQUAL_INT(14, coolant_pi.proportional);
+  TEST_ASSERT_EQUAL_INT(0, coolant_pi.damping);
+
+  // 1C in one period is 2C/s, an eighth of it into the filtered rate
+  coolant_pi_update(6550, PI_OUTDOOR, 10000);
+  TEST_ASSERT_EQUAL_INT(25, coolant_pi.rate);
+  TEST_ASSERT_EQUAL_INT(37, coolant_pi.damping);
+  TEST_ASSERT_EQUAL_INT(-50, coolant_pi.error);
+
+  coolant_pi_reset();
+  TEST_ASSERT_EQUAL_INT(0, coolant_pi.rate);
+  TEST_ASSERT_FALSE(coolant_pi.primed);
+}
+
+static void test_coolant_pi_integral_clamped(void)
+{
+  test_coolant_pi_begin();
+
+  // Integrating unlimited, with a gain big enough to hit the clamp at once
+  coolant_pi_set_tuning(COOLANT_PI_TUNE_KI, INT32_MAX);
+  coolant_pi_update(6450, PI_OUTDOOR, 10000);
+  TEST_ASSERT_EQUAL_INT(COOLANT_PI_LIMIT_NONE, coolant_pi.limited);
+  TEST_ASSERT_EQUAL_INT((int32_t)MAX_FUEL_NEED_PRIMING << 16, coolant_pi.integral);
+
+  coolant_pi_reset();
+  coolant_pi_update(6550, PI_OUTDOOR, 10000);
+  TEST_ASSERT_EQUAL_INT(-((int32_t)MAX_FUEL_NEED_PRIMING << 16), coolant_pi.integral);
+
+  test_coolant_pi_begin();
+}
+
+static void test_coolant_pi_tuning(void)
+{
+  test_coolant_pi_begin();
+
+  TEST_ASSERT_TRUE(coolant_pi_set_tuning(COOLANT_PI_TUNE_KP, -5));
+  TEST_ASSERT_EQUAL_INT(0, coolant_pi_get_tuning(COOLANT_PI_TUNE_KP));
+
+  TEST_ASSERT_TRUE(coolant_pi_set_tuning(COOLANT_PI_TUNE_TARGET, 9000));
+  TEST_ASSERT_EQUAL_INT(COOLANT_IDLE_THRESHOLD - 100, coolant_pi_get_tuning(COOLANT_PI_TUNE_TARGET));
+  TEST_ASSERT_TRUE(coolant_pi_set_tuning(COOLANT_PI_TUNE_TARGET, 1000));
+  TEST_ASSERT_EQUAL_INT(COOLANT_MIN_THRESHOLD, coolant_pi_get_tuning(COOLANT_PI_TUNE_TARGET));
+
+  TEST_ASSERT_FALSE(coolant_pi_set_tuning(COOLANT_PI_TUNE_COUNT, 1));
+  TEST_ASSERT_EQUAL_INT(0, coolant_pi_get_tuning(COOLANT_PI_TUNE_COUNT));
+
+  test_coolant_pi_begin();
+}
+
+void run_coolant_pi_tests(void)
+{
+  RUN_TEST(test_coolant_pi_limits);
+  RUN_TEST(test_coolant_pi_terms);
+  RUN_TEST(test_coolant_pi_integral_clamped);
+  RUN_TEST(test_coolant_pi_tuning);
+}
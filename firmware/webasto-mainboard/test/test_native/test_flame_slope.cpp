@@ -0,0 +1,244 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <canbus_ids.h>
+#include <webasto.h>
+
+#include "project.h"
+#include "global_timer.h"
+#include "monotonic.h"
+#include "sensor_registry.h"
+#include "sensor_snapshot.h"
+#include "flame_slope.h"
+#include "fsm.h"
+#include "fsm_state.h"
+#include "fsm_queue.h"
+#include "state_names.h"
+#include "test_native.h"
+
+// Synthetic exhaust ramps, one sample a second.  Each ramp starts more than
+// a window after the last one, so nothing of it is left in the fit.  The
+// times are well clear of the clock the FSM stamps its samples with.
+
+#define SLOPE_BASELINE  2000    // 20C
+#define SLOPE_STEP_MS   1000
+
+static uint32_t slope_time_ms = 1 << 30;
+
+typedef struct {
+  const char *name;
+  int peak;             // one sample after flame_slope_mark(), or 0
+  int start;
+  int rate;             // 1/100 degC per second
+  bool lit;
+  bool cold;
+  bool out;
+} flame_slope_case_t;
+
+static const flame_slope_case_t flame_slope_cases[] = {
+  { "rising fast, hot",          0,  3000,  200, true,  false, false },
+  { "rising fast, under margin", 0,  1500,  100, false, false, false },
+  { "rising at LIT_RATE",        0,  3000,  100, true,  false, false },
+  { "rising slowly, cold",       0,  2000,   10, false, true,  false },
+  { "flat, cold",                0,  2000,    0, false, true,  false },
+  { "flat, hot",                 0, 10000,    0, false, false, false },
+  { "falling, past half",    20000, 10000, -300, false, false, true },
+  { "falling, still hot",    20000, 19000, -300, false, false, false },
+  { "falling slowly",        20000,  8000, -100, false, false, false },
+  { "falling at OUT_RATE",   20000, 10000, -150, false, false, true },
+};
+
+static void test_slope_ramp(int count, int step_ms, int start, int rate)
+{
+  for (int i = 0; i < count; i++) {
+    flame_slope_add(slope_time_ms, start + rate * i * step_ms / 1000);
+    slope_time_ms += step_ms;
+  }
+}
+
+static void test_slope_begin(int peak)
+{
+  slope_time_ms += FLAME_SLOPE_WINDOW_MS * 2;
+  flame_slope_mark();
+  if (peak) {
+    flame_slope_add(slope_time_ms, peak);
+    slope_time_ms += SLOPE_STEP_MS;
+  }
+}
+
+static void test_flame_slope_cases(void)
+{
+  for (const flame_slope_case_t &c : flame_slope_cases) {
+    test_slope_begin(c.peak);
+    test_slope_ramp(FLAME_SLOPE_SAMPLES, SLOPE_STEP_MS, c.start, c.rate);
+
+    TEST_ASSERT_TRUE_MESSAGE(flame_slope_valid(), c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.rate, flame_slope_rate(), c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.lit, flame_slope_lit(SLOPE_BASELINE), c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.cold, flame_slope_cold(SLOPE_BASELINE), c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.out, flame_slope_out(SLOPE_BASELINE), c.name);
+  }
+}
+
+// No verdict at all until the samples span FLAME_SLOPE_MIN_SPAN_MS
+static void test_flame_slope_min_span(void)
+{
+  int step_ms = FLAME_SLOPE_MIN_SPAN_MS / 4;
+
+  test_slope_begin(0);
+  test_slope_ramp(4, step_ms, 5000, 500);
+
+  TEST_ASSERT_FALSE(flame_slope_valid());
+  TEST_ASSERT_EQUAL_INT(0, flame_slope_rate());
+  TEST_ASSERT_FALSE(flame_slope_lit(SLOPE_BASELINE));
+  TEST_ASSERT_FALSE(flame_slope_cold(SLOPE_BASELINE));
+  TEST_ASSERT_FALSE(flame_slope_out(SLOPE_BASELINE));
+
+  test_slope_ramp(1, step_ms, 5000 + 500 * 4 * step_ms / 1000, 0);
+  TEST_ASSERT_TRUE(flame_slope_valid());
+  TEST_ASSERT_EQUAL_INT(500, flame_slope_rate());
+  TEST_ASSERT_TRUE(flame_slope_lit(SLOPE_BASELINE));
+}
+
+// Samples older than the window drop out of the fit, however many are left
+static void test_flame_slope_window(void)
+{
+  test_slope_begin(0);
+  test_slope_ramp(2, SLOPE_STEP_MS, 5000, 0);
+  slope_time_ms += FLAME_SLOPE_WINDOW_MS;
+  test_slope_ramp(3, SLOPE_STEP_MS, 5000, 500);
+
+  TEST_ASSERT_FALSE(flame_slope_valid());
+}
+
+// Full load back to idle:  the exhaust falls as fast as it would going out,
+// and past half the rise to the peak, but settles well clear of the baseline.
+// Only once it heads for the baseline is the flame out.
+
+#define SLOPE_FUEL_FULL 500
+#define SLOPE_FUEL_IDLE 150
+
+static void test_flame_slope_throttle(void)
+{
+  test_slope_begin(25000);
+  flame_slope_fuel(SLOPE_FUEL_FULL);
+  flame_slope_fuel(SLOPE_FUEL_IDLE);
+  test_slope_ramp(FLAME_SLOPE_SAMPLES, SLOPE_STEP_MS, 10000, -300);
+
+  TEST_ASSERT_TRUE(flame_slope_valid());
+  TEST_ASSERT_EQUAL_INT(-300, flame_slope_rate());
+  TEST_ASSERT_FALSE(flame_slope_out(SLOPE_BASELINE));
+
+  // Back up to full load on the way, and it is the full half again
+  flame_slope_fuel(SLOPE_FUEL_FULL);
+  TEST_ASSERT_TRUE(flame_slope_out(SLOPE_BASELINE));
+  flame_slope_fuel(SLOPE_FUEL_IDLE);
+
+  test_slope_ramp(FLAME_SLOPE_SAMPLES * 2, SLOPE_STEP_MS, 7600, -300);
+  TEST_ASSERT_TRUE(flame_slope_out(SLOPE_BASELINE));
+
+  // Whatever fuel was reported is gone with the next mark
+  test_slope_begin(25000);
+  test_slope_ramp(FLAME_SLOPE_SAMPLES, SLOPE_STEP_MS, 10000, -300);
+  TEST_ASSERT_TRUE(flame_slope_out(SLOPE_BASELINE));
+}
+
+// A burn that keeps dying in AutoBurn:  the exhaust climbs from TestBurn
+// on, and falls away a couple of seconds into every AutoBurn.  Each of
+// those is caught from the slope, and the third one locks the heater out
+// (after a cooldown).
+
+#define BURN_AMBIENT    2000
+#define BURN_MAX        25000
+#define BURN_RISE       500     // per second, while lit
+#define BURN_FALL       1000    // per second, once out
+#define BURN_LIT_MS     2000    // in AutoBurn before it goes out
+#define BURN_LIMIT_MS   (30 * 60 * 1000)
+#define BURN_STEP_MS    100
+
+static void test_report(int id, int32_t value)
+{
+  // Same path as a frame arriving in canbus_dispatch()
+  RemoteSensor *sensor = sensorRegistry.get<RemoteSensor>(id);
+  if (sensor) {
+    sensor->set_value(value);
+  }
+}
+
+static void test_fsm_run_ms(int ms)
+{
+  for (int elapsed = 0; elapsed < ms; elapsed += BURN_STEP_MS) {
+    globalTimer.tick();
+    fsm_process_events();
+    native_clock_advance_us(BURN_STEP_MS * 1000);
+  }
+}
+
+static void test_flame_slope_lockdown(void)
+{
+  test_firmware_start();
+  test_report(CANBUS_ID_BATTERY_VOLTAGE, 12600);
+  test_report(CANBUS_ID_EXTERNAL_TEMP, BURN_AMBIENT);
+  test_report(CANBUS_ID_COOLANT_TEMP_WEBASTO, BURN_AMBIENT);
+  test_report(CANBUS_ID_EXHAUST_TEMP, BURN_AMBIENT);
+  test_fsm_run_ms(1000);
+  TEST_ASSERT_EQUAL_HEX8(WB_STATE_OFF, fsm_state);
+
+  StartupEvent event;
+  event.mode = WEBASTO_MODE_PARKING_HEATER;
+  event.minutes = 0;
+  fsm_post(event);
+
+  int exhaust = BURN_AMBIENT;
+  bool lit = false;
+  int flameouts = 0;
+  uint8_t last_state = fsm_state;
+  uint64_t burn_us = 0;
+
+  for (int elapsed = 0; elapsed < BURN_LIMIT_MS && fsm_state != WB_STATE_LOCK2; elapsed += 1000) {
+    test_fsm_run_ms(1000);
+
+    if (fsm_state != last_state) {
+      if (last_state == WB_STATE_PH && fsm_state != WB_STATE_FDM) {     // AutoBurn, not to FlameMeasure
+        flameouts++;
+      }
+      TEST_ASSERT_NOT_EQUAL(WB_STATE_OFF, fsm_state);
+      if (fsm_state == WB_STATE_VENT) {       // Cooldown, only on the way to Lockdown
+        TEST_ASSERT_EQUAL_INT(MAX_FLAMEOUT_COUNT + 1, flameOutCount);
+      }
+
+      last_state = fsm_state;
+      if (fsm_state == WB_STATE_FSTAB) {      // TestBurn
+        lit = true;
+      } else if (fsm_state == WB_STATE_PH) {  // AutoBurn
+        burn_us = monotonic_us();
+      }
+    }
+
+    if (lit && fsm_state == WB_STATE_PH && monotonic_us() - burn_us >= BURN_LIT_MS * 1000) {
+      lit = false;
+    }
+
+    exhaust = lit ? min(exhaust + BURN_RISE, BURN_MAX) : max(exhaust - BURN_FALL, BURN_AMBIENT);
+    test_report(CANBUS_ID_EXHAUST_TEMP, exhaust);
+  }
+
+  TEST_ASSERT_EQUAL_HEX8(WB_STATE_LOCK2, fsm_state);
+  TEST_ASSERT_EQUAL_INT(MAX_FLAMEOUT_COUNT + 1, flameouts);
+  TEST_ASSERT_EQUAL_INT(MAX_FLAMEOUT_COUNT + 1, flameOutCount);
+
+  // Lockdown can only be cleared from the front panel, so start the FSM over
+  globalTimer.cancel_timer_id(TIMER_RESTART_BEEPS);
+  globalTimer.cancel_timer_id(TIMER_RUN_TIME_MINUTE);
+  init_fsm();
+  test_fsm_run_ms(1000);
+  TEST_ASSERT_EQUAL_HEX8(WB_STATE_OFF, fsm_state);
+}
+
+void run_flame_slope_tests(void)
+{
+  RUN_TEST(test_flame_slope_cases);
+  RUN_TEST(test_flame_slope_min_span);
+  RUN_TEST(test_flame_slope_window);
+  RUN_TEST(test_flame_slope_throttle);
+  RUN_TEST(test_flame_slope_lockdown);
+}
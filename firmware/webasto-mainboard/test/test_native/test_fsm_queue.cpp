@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "project.h"
+#include "fsm.h"
+#include "fsm_queue.h"
+#include "test_native.h"
+
+static void test_fsm_queue_begin(void)
+{
+  test_firmware_start();
+  while (fsm_process_events()) {
+  }
+  fsm_queue_reset_stats();
+}
+
+static void test_fsm_queue_coalesces_samples(void)
+{
+  fsm_queue_stats_t stats;
+  BatteryLevelEvent event;
+
+  test_fsm_queue_begin();
+
+  // A burst collapses into one reaction to the newest value
+  static const int samples[] = { 12000, 12500, 9500 };
+  for (int value : samples) {
+    event.value = value;
+    TEST_ASSERT_TRUE(fsm_post(event));
+  }
+
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.posted);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.coalesced);
+  TEST_ASSERT_EQUAL_INT(0, fsm_queue_depth());
+  TEST_ASSERT_TRUE(fsm_events_pending());
+
+  TEST_ASSERT_EQUAL_INT(1, fsm_process_events());
+  TEST_ASSERT_TRUE(batteryLow);
+  TEST_ASSERT_FALSE(fsm_events_pending());
+
+  event.value = 9000;
+  fsm_post(event);
+  event.value = 12500;
+  fsm_post(event);
+  TEST_ASSERT_EQUAL_INT(1, fsm_process_events());
+  TEST_ASSERT_FALSE(batteryLow);
+
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.posted);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.coalesced);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.dispatched);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+}
+
+static void test_fsm_queue_slot_per_type(void)
+{
+  fsm_queue_stats_t stats;
+  CoolantTempEvent coolant;
+  OutdoorTempEvent outdoor;
+  InternalTempEvent internal;
+
+  test_fsm_queue_begin();
+
+  coolant.value = 2000;
+  outdoor.value = 500;
+  internal.value = 3000;
+  fsm_post(coolant);
+  fsm_post(outdoor);
+  fsm_post(internal);
+
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.posted);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.coalesced);
+
+  TEST_ASSERT_EQUAL_INT(3, fsm_process_events());
+  TEST_ASSERT_EQUAL_INT(0, fsm_process_events());
+}
+
+static void test_fsm_queue_drops_when_full(void)
+{
+  fsm_queue_stats_t stats;
+  FlameDetectEvent event;
+
+  test_fsm_queue_begin();
+
+  // Queued events are never coalesced, and a full queue drops
+  for (int i = 0; i < FSM_EVENT_QUEUE_SIZE; i++) {
+    event.value = i;
+    TEST_ASSERT_TRUE(fsm_post(event));
+  }
+  TEST_ASSERT_FALSE(fsm_post(event));
+  TEST_ASSERT_FALSE(fsm_post(event));
+
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(FSM_EVENT_QUEUE_SIZE, stats.posted);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.coalesced);
+  TEST_ASSERT_EQUAL_UINT(FSM_EVENT_QUEUE_SIZE, stats.high_water);
+  TEST_ASSERT_EQUAL_INT(FSM_EVENT_QUEUE_SIZE, fsm_queue_depth());
+
+  // A pending sample still gets its turn after a full batch
+  BatteryLevelEvent battery;
+  battery.value = 12500;
+  fsm_post(battery);
+
+  TEST_ASSERT_EQUAL_INT(FSM_EVENT_QUEUE_SIZE + 1, fsm_process_events());
+  TEST_ASSERT_EQUAL_INT(0, fsm_queue_depth());
+
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(FSM_EVENT_QUEUE_SIZE + 1, stats.dispatched);
+
+  // Room again
+  TEST_ASSERT_TRUE(fsm_post(event));
+  fsm_queue_reset_stats();
+  fsm_queue_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+  TEST_ASSERT_EQUAL_UINT(1, stats.high_water);
+}
+
+void run_fsm_queue_tests(void)
+{
+  RUN_TEST(test_fsm_queue_coalesces_samples);
+  RUN_TEST(test_fsm_queue_slot_per_type);
+  RUN_TEST(test_fsm_queue_drops_when_full);
+}
@@ -0,0 +1,70 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "global_timer.h"
+#include "sensor_registry.h"
+#include "device_eeprom.h"
+#include "fram.h"
+#include "fsm.h"
+#include "fsm_queue.h"
+#include "test_native.h"
+
+void test_firmware_start(void)
+{
+  static bool started = false;
+
+  if (started) {
+    return;
+  }
+  started = true;
+
+  native_set_core_num(0);
+  init_device_eeprom();
+  fsm_queue_init();
+  init_sensors();
+  init_fram();
+
+  native_set_core_num(1);
+  globalTimer.begin();
+  init_fsm();
+}
+
+void test_fram_power_cycle(void)
+{
+  update_fram();
+  TEST_ASSERT_FALSE_MESSAGE(fram_dirty, "FRAM not written");
+
+  init_fram();
+  TEST_ASSERT_FALSE_MESSAGE(fram_dirty, "FRAM reinitialised after a reboot");
+}
+
+void setUp(void)
+{
+  native_clock_set_manual(true);
+  native_clock_set_us(TEST_CLOCK_START_US);
+  native_set_core_num(1);
+}
+
+void tearDown(void)
+{
+}
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  UNITY_BEGIN();
+  run_timer_tests();
+  run_monotonic_tests();
+  run_spsc_ring_tests();
+  run_fsm_queue_tests();
+  run_throttle_map_tests();
+  run_coolant_pi_tests();
+  run_sensor_snapshot_tests();
+  run_state_stats_tests();
+  run_start_learn_tests();
+  run_flame_slope_tests();
+  run_supervisor_tests();
+  return UNITY_END();
+}
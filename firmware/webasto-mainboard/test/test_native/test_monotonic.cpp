@@ -0,0 +1,86 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "global_timer.h"
+#include "monotonic.h"
+#include "test_native.h"
+
+// The points where millis() in an int went negative (2^31 ms, ~24.8 days)
+// and where a 32-bit millis() wraps (2^32 ms, ~49.7 days).
+#define TEST_WRAP_31_US   ((1ULL << 31) * 1000)
+#define TEST_WRAP_32_US   ((1ULL << 32) * 1000)
+
+static const uint64_t wrap_points_us[] = { TEST_WRAP_31_US, TEST_WRAP_32_US };
+
+static void test_monotonic_elapsed_across_wrap(void)
+{
+  for (uint64_t wrap_us : wrap_points_us) {
+    native_clock_set_us(wrap_us - 1500000);
+    uint64_t start_us = monotonic_us();
+    uint64_t start_ms = monotonic_ms();
+
+    native_clock_advance_us(1000000);
+    TEST_ASSERT_EQUAL_INT(1000, elapsed_ms_since(start_us));
+
+    // Across the wrap point
+    native_clock_advance_us(1000000);
+    TEST_ASSERT_EQUAL_INT(2000, elapsed_ms_since(start_us));
+    TEST_ASSERT_GREATER_THAN(start_ms, monotonic_ms());
+    TEST_ASSERT_EQUAL_UINT64(2000, monotonic_ms() - start_ms);
+
+    native_clock_advance_us(3600ULL * 1000000);
+    TEST_ASSERT_EQUAL_INT(3602000, elapsed_ms_since(start_us));
+  }
+}
+
+static void test_monotonic_elapsed_never_negative(void)
+{
+  native_clock_set_us(TEST_WRAP_32_US + 5000);
+
+  // A start in the future (taken on the other core a moment later) is 0
+  TEST_ASSERT_EQUAL_INT(0, elapsed_ms_since(monotonic_us() + 1000));
+  TEST_ASSERT_EQUAL_INT(0, elapsed_ms_since(monotonic_us()));
+  TEST_ASSERT_EQUAL_INT(5, elapsed_ms_since(TEST_WRAP_32_US));
+}
+
+static int wrap_calls;
+static int wrap_delay_ms;
+
+static void test_wrap_callback(int timer_id, int delay_ms)
+{
+  (void)timer_id;
+
+  wrap_calls++;
+  wrap_delay_ms = delay_ms;
+}
+
+static void test_monotonic_timer_across_wrap(void)
+{
+  for (uint64_t wrap_us : wrap_points_us) {
+    GlobalTimer *timer = new GlobalTimer();
+    wrap_calls = 0;
+
+    native_clock_set_us(wrap_us - 20000);
+    timer->register_timer(TIMER_BEEPER, 50, test_wrap_callback);
+    TEST_ASSERT_EQUAL_INT(50, timer->get_remaining_time(TIMER_BEEPER));
+
+    native_clock_advance_us(30000);     // 10ms past the wrap point
+    timer->tick();
+    TEST_ASSERT_EQUAL_INT(0, wrap_calls);
+    TEST_ASSERT_EQUAL_INT(20, timer->get_remaining_time(TIMER_BEEPER));
+
+    native_clock_advance_us(20000);
+    timer->tick();
+    TEST_ASSERT_EQUAL_INT(1, wrap_calls);
+    TEST_ASSERT_EQUAL_INT(50, wrap_delay_ms);
+
+    delete timer;
+  }
+}
+
+void run_monotonic_tests(void)
+{
+  RUN_TEST(test_monotonic_elapsed_across_wrap);
+  RUN_TEST(test_monotonic_elapsed_never_negative);
+  RUN_TEST(test_monotonic_timer_across_wrap);
+}
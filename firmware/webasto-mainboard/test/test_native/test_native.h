@@ -0,0 +1,33 @@
+#ifndef __test_native_h_
+#define __test_native_h_
+
+#include <stdint.h>
+
+// Host unit tests, "pio test -e native".  Each test_*.cpp has a
+// run_*_tests() that test_main.cpp calls.  Every test starts on core1 with
+// the manual clock at TEST_CLOCK_START_US, and only moves it on with
+// native_clock_advance_us().
+
+#define TEST_CLOCK_START_US   1000000ULL
+
+// Brings up the firmware the way native_main.cpp does, the first time only.
+// For the tests that go through the FSM.
+void test_firmware_start(void);
+
+// Writes FRAM back as core0 does and reads it again as after a reboot,
+// failing the test unless it comes back intact.
+void test_fram_power_cycle(void);
+
+void run_timer_tests(void);
+void run_monotonic_tests(void);
+void run_spsc_ring_tests(void);
+void run_fsm_queue_tests(void);
+void run_throttle_map_tests(void);
+void run_coolant_pi_tests(void);
+void run_sensor_snapshot_tests(void);
+void run_state_stats_tests(void);
+void run_start_learn_tests(void);
+void run_flame_slope_tests(void);
+void run_supervisor_tests(void);
+
+#endif
@@ -0,0 +1,55 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <canbus_ids.h>
+
+#include "monotonic.h"
+#include "sensor_snapshot.h"
+#include "test_native.h"
+
+// Stamps are on the monotonic_ms() time base, so a value published just
+// before the 32-bit millis() wrap still reads as older than one after it.
+#define TEST_WRAP_32_US   ((1ULL << 32) * 1000)
+
+static void test_sensor_snapshot_publish(void)
+{
+  sensor_snapshot_t snapshot;
+  int slot = sensor_slot_for_id(CANBUS_ID_COOLANT_TEMP_WEBASTO);
+
+  test_firmware_start();
+  native_clock_set_us(TEST_WRAP_32_US - 500000);
+  sensor_snapshot_publish(CANBUS_ID_EXHAUST_TEMP, 12345);
+  native_clock_advance_us(1000000);
+  sensor_snapshot_publish(CANBUS_ID_COOLANT_TEMP_WEBASTO, 6500);
+
+  sensor_snapshot_read(&snapshot);
+  TEST_ASSERT_EQUAL_INT32(12345, sensor_snapshot_get(&snapshot, CANBUS_ID_EXHAUST_TEMP));
+  TEST_ASSERT_EQUAL_INT32(6500, sensor_snapshot_get(&snapshot, CANBUS_ID_COOLANT_TEMP_WEBASTO));
+  TEST_ASSERT_EQUAL_INT32(6500, sensor_snapshot_value(CANBUS_ID_COOLANT_TEMP_WEBASTO));
+  TEST_ASSERT_TRUE(snapshot.valid & (1 << slot));
+
+  int exhaust = sensor_slot_for_id(CANBUS_ID_EXHAUST_TEMP);
+  TEST_ASSERT_EQUAL_UINT64(monotonic_ms(), snapshot.stamp_ms[slot]);
+  TEST_ASSERT_EQUAL_UINT64(1000, snapshot.stamp_ms[slot] - snapshot.stamp_ms[exhaust]);
+}
+
+// Anything that isn't a sensor is left alone
+static void test_sensor_snapshot_not_a_sensor(void)
+{
+  sensor_snapshot_t before;
+  sensor_snapshot_t after;
+
+  test_firmware_start();
+  TEST_ASSERT_EQUAL_INT(-1, sensor_slot_for_id(-1));
+
+  sensor_snapshot_read(&before);
+  sensor_snapshot_publish(-1, 1);
+  sensor_snapshot_read(&after);
+  TEST_ASSERT_EQUAL_UINT32(before.sequence, after.sequence);
+  TEST_ASSERT_EQUAL_INT32(0, sensor_snapshot_value(-1));
+}
+
+void run_sensor_snapshot_tests(void)
+{
+  RUN_TEST(test_sensor_snapshot_publish);
+  RUN_TEST(test_sensor_snapshot_not_a_sensor);
+}
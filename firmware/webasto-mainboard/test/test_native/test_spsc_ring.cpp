@@ -0,0 +1,151 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include <thread>
+
+#include "global_timer.h"
+#include "spsc_ring.h"
+#include "test_native.h"
+
+// The core0 -> core1 request ring, with two real threads on it.  Unity's
+// asserts can't be used off the test's own thread, so the consumer only
+// counts what went wrong and the test checks after join().
+
+#define TEST_RING_ITEMS   1000000
+#define TEST_RING_SIZE    16
+
+typedef struct {
+  uint32_t sequence;
+  uint32_t check;
+} ring_item_t;
+
+static inline uint32_t ring_check(uint32_t sequence)
+{
+  return sequence * 2654435761U;
+}
+
+static void test_spsc_ring_full_and_empty(void)
+{
+  SpscRing<ring_item_t, TEST_RING_SIZE> ring;
+
+  TEST_ASSERT_NULL(ring.front());
+
+  for (uint32_t i = 0; i < TEST_RING_SIZE; i++) {
+    TEST_ASSERT_TRUE(ring.push({ i, ring_check(i) }));
+  }
+  TEST_ASSERT_FALSE(ring.push({ TEST_RING_SIZE, 0 }));
+
+  TEST_ASSERT_EQUAL_UINT32(0, ring.front()->sequence);
+  ring.pop();
+  TEST_ASSERT_TRUE(ring.push({ TEST_RING_SIZE, ring_check(TEST_RING_SIZE) }));
+  TEST_ASSERT_FALSE(ring.push({ TEST_RING_SIZE + 1, 0 }));
+
+  for (uint32_t i = 1; i <= TEST_RING_SIZE; i++) {
+    TEST_ASSERT_NOT_NULL(ring.front());
+    TEST_ASSERT_EQUAL_UINT32(i, ring.front()->sequence);
+    ring.pop();
+  }
+  TEST_ASSERT_NULL(ring.front());
+}
+
+static void test_spsc_ring_two_threads(void)
+{
+  static SpscRing<ring_item_t, TEST_RING_SIZE> ring;
+  uint32_t full = 0;
+  uint32_t received = 0;
+  uint32_t out_of_order = 0;
+  uint32_t corrupt = 0;
+
+  std::thread consumer([&]() {
+    native_set_core_num(1);
+    uint32_t expected = 0;
+
+    while (expected < TEST_RING_ITEMS) {
+      ring_item_t *item = ring.front();
+      if (!item) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      if (item->sequence != expected) {
+        out_of_order++;
+      }
+      if (item->check != ring_check(item->sequence)) {
+        corrupt++;
+      }
+      expected = item->sequence + 1;
+      received++;
+      ring.pop();
+    }
+  });
+
+  std::thread producer([&]() {
+    native_set_core_num(0);
+
+    for (uint32_t i = 0; i < TEST_RING_ITEMS; i++) {
+      while (!ring.push({ i, ring_check(i) })) {
+        full++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_ITEMS, received);
+  TEST_ASSERT_EQUAL_UINT32(0, out_of_order);
+  TEST_ASSERT_EQUAL_UINT32(0, corrupt);
+  TEST_ASSERT_NULL(ring.front());
+  printf("%u pushes found the ring full\n", full);
+}
+
+// And through GlobalTimer:  core0's requests are refused once core1 has
+// GLOBAL_TIMER_REQUEST_QUEUE_SIZE of them outstanding, and none are lost.
+
+static int ring_calls;
+
+static void test_ring_callback(int timer_id, int delay_ms)
+{
+  (void)timer_id;
+  (void)delay_ms;
+
+  ring_calls++;
+}
+
+static void test_spsc_ring_timer_requests(void)
+{
+  GlobalTimer *timer = new GlobalTimer();
+  ring_calls = 0;
+
+  // Remote adds have no handle to give back, a remote cancel says whether
+  // it was queued
+  native_set_core_num(0);
+  for (int i = 0; i < GLOBAL_TIMER_REQUEST_QUEUE_SIZE - 1; i++) {
+    timer->register_timer(TIMER_BEEPER, 10 + i, test_ring_callback);
+  }
+  TEST_ASSERT_TRUE(timer->cancel_timer(TIMER_HANDLE_NONE));
+  TEST_ASSERT_FALSE(timer->cancel_timer(TIMER_HANDLE_NONE));
+  timer->register_timer(TIMER_BEEPER, 10, test_ring_callback);     // dropped
+  native_set_core_num(1);
+
+  // Delays count from when core1 picks the request up
+  timer->tick();
+  native_clock_advance_us(1000000);
+  timer->tick();
+  TEST_ASSERT_EQUAL_INT(GLOBAL_TIMER_REQUEST_QUEUE_SIZE - 1, ring_calls);
+
+  // Drained, so core0 gets through again
+  native_set_core_num(0);
+  TEST_ASSERT_TRUE(timer->cancel_timer(TIMER_HANDLE_NONE));
+  native_set_core_num(1);
+
+  delete timer;
+}
+
+void run_spsc_ring_tests(void)
+{
+  RUN_TEST(test_spsc_ring_full_and_empty);
+  RUN_TEST(test_spsc_ring_two_threads);
+  RUN_TEST(test_spsc_ring_timer_requests);
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <canbus_ids.h>
+
+#include "project.h"
+#include "fram.h"
+#include "start_learn.h"
+#include "sensor_snapshot.h"
+#include "test_native.h"
+
+// Every start here is at -20C, with the start codes handed in the way
+// set_fsm_state() passes them on from state_stats_transition()
+
+#define LEARN_OUTDOOR   -2000
+#define LEARN_VBAT      12500
+
+typedef struct {
+  const char *name;
+  int fuel_bias;
+  int fan_bias;
+  int vbat;
+  int retries;
+  bool flame;
+  int fuel_after;
+  int fan_after;
+} start_learn_case_t;
+
+static const start_learn_case_t start_learn_cases[] = {
+  { "retry, flame",         0,   0, LEARN_VBAT, 1, true,    5,  -2 },
+  { "retries, no flame",    0,   0, LEARN_VBAT, 2, false,   5,  -2 },
+  { "retry at the limit",  30, -10, LEARN_VBAT, 1, true,   30, -10 },
+  { "retry from -limit",  -30,  10, LEARN_VBAT, 1, true,  -25,   8 },
+  { "low battery",          0,   0, 11499,      1, true,    0,   0 },
+  { "battery at minimum",   0,   0, 11500,      1, true,    5,  -2 },
+  { "no flame, no retry",  10,  -4, LEARN_VBAT, 0, false,  10,  -4 },
+  { "one clean start",     10,  -4, LEARN_VBAT, 0, true,   10,  -4 },
+};
+
+static int test_learn_band(void)
+{
+  return start_band(LEARN_OUTDOOR);
+}
+
+static void test_learn_begin(int fuel_bias, int fan_bias, int vbat)
+{
+  test_firmware_start();
+  sensor_snapshot_publish(CANBUS_ID_EXTERNAL_TEMP, LEARN_OUTDOOR);
+  sensor_snapshot_publish(CANBUS_ID_BATTERY_VOLTAGE, vbat);
+
+  start_learn_reset();
+  start_learn.fuel_bias[test_learn_band()] = fuel_bias;
+  start_learn.fan_bias[test_learn_band()] = fan_bias;
+}
+
+static void test_learn_start(int retries, bool flame)
+{
+  start_learn_transition(START_BEGIN);
+  for (int i = 0; i < retries; i++) {
+    start_learn_transition(START_RETRY);
+  }
+  start_learn_transition(flame ? START_FLAME : START_GAVE_UP);
+}
+
+static void test_start_learn_cases(void)
+{
+  int band = test_learn_band();
+
+  for (const start_learn_case_t &c : start_learn_cases) {
+    test_learn_begin(c.fuel_bias, c.fan_bias, c.vbat);
+    test_learn_start(c.retries, c.flame);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.fuel_after, start_learn.fuel_bias[band], c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.fan_after, start_learn.fan_bias[band], c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.retries, start_learn_last.retries, c.name);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.flame, start_learn_last.success, c.name);
+  }
+
+  start_learn_reset();
+}
+
+// Retries step all the way to the limits and stay there
+static void test_start_learn_step_to_limit(void)
+{
+  int band = test_learn_band();
+
+  test_learn_begin(0, 0, LEARN_VBAT);
+  for (int i = 1; i <= 10; i++) {
+    test_learn_start(1, true);
+    TEST_ASSERT_EQUAL_INT(min(i * START_LEARN_FUEL_STEP, START_LEARN_FUEL_LIMIT), start_learn.fuel_bias[band]);
+    TEST_ASSERT_EQUAL_INT(-min(i * START_LEARN_FAN_STEP, START_LEARN_FAN_LIMIT), start_learn.fan_bias[band]);
+  }
+
+  start_learn_reset();
+}
+
+// Every START_LEARN_RELAX clean starts step back towards 0, from either
+// limit, and no further
+static void test_start_learn_relax(void)
+{
+  static const int signs[] = { 1, -1 };
+  int band = test_learn_band();
+
+  for (int sign : signs) {
+    int fuel = sign * START_LEARN_FUEL_LIMIT;
+    int fan = -sign * START_LEARN_FAN_LIMIT;
+
+    test_learn_begin(fuel, fan, LEARN_VBAT);
+    for (int i = 1; i <= 30; i++) {
+      test_learn_start(0, true);
+      if (i % START_LEARN_RELAX == 0) {
+        fuel = sign * max(abs(fuel) - START_LEARN_FUEL_STEP, 0);
+        fan = -sign * max(abs(fan) - START_LEARN_FAN_STEP, 0);
+      }
+
+      TEST_ASSERT_EQUAL_INT(fuel, start_learn.fuel_bias[band]);
+      TEST_ASSERT_EQUAL_INT(fan, start_learn.fan_bias[band]);
+    }
+    TEST_ASSERT_EQUAL_INT(0, fuel);
+    TEST_ASSERT_EQUAL_INT(0, fan);
+  }
+
+  start_learn_reset();
+}
+
+// A retry in between starts the count of clean starts again
+static void test_start_learn_relax_interrupted(void)
+{
+  int band = test_learn_band();
+
+  test_learn_begin(20, -8, LEARN_VBAT);
+  test_learn_start(0, true);
+  test_learn_start(0, true);
+  test_learn_start(1, true);
+  test_learn_start(0, true);
+  test_learn_start(0, true);
+  TEST_ASSERT_EQUAL_INT(25, start_learn.fuel_bias[band]);
+  TEST_ASSERT_EQUAL_INT(-10, start_learn.fan_bias[band]);
+
+  test_learn_start(0, true);
+  TEST_ASSERT_EQUAL_INT(20, start_learn.fuel_bias[band]);
+  TEST_ASSERT_EQUAL_INT(-8, start_learn.fan_bias[band]);
+
+  start_learn_reset();
+}
+
+// The bias only applies while a start is under way
+static void test_start_learn_applies(void)
+{
+  test_learn_begin(10, -4, LEARN_VBAT);
+
+  TEST_ASSERT_EQUAL_INT(100, start_learn_fuel(100));
+  TEST_ASSERT_EQUAL_INT(50, start_learn_fan(50));
+
+  start_learn_transition(START_BEGIN);
+  TEST_ASSERT_EQUAL_INT(110, start_learn_fuel(100));
+  TEST_ASSERT_EQUAL_INT(46, start_learn_fan(50));
+  TEST_ASSERT_EQUAL_INT(110, start_learn_last.fuel);
+  TEST_ASSERT_EQUAL_INT(46, start_learn_last.fan);
+  TEST_ASSERT_EQUAL_INT(LEARN_VBAT, start_learn_last.vbat);
+
+  start_learn_transition(START_GAVE_UP);
+  TEST_ASSERT_EQUAL_INT(100, start_learn_fuel(100));
+
+  start_learn_reset();
+}
+
+// Whatever is in FRAM is held to the limits
+static void test_start_learn_load_limits(void)
+{
+  int band = test_learn_band();
+  int other = START_BAND_COUNT - 1;
+
+  test_learn_begin(0, 0, LEARN_VBAT);
+  fram_data.current.start_learn.fuel_bias[band] = 100;
+  fram_data.current.start_learn.fan_bias[band] = -100;
+  fram_data.current.start_learn.fuel_bias[other] = -100;
+  fram_data.current.start_learn.fan_bias[other] = 100;
+  init_start_learn();
+
+  TEST_ASSERT_EQUAL_INT(START_LEARN_FUEL_LIMIT, start_learn.fuel_bias[band]);
+  TEST_ASSERT_EQUAL_INT(-START_LEARN_FAN_LIMIT, start_learn.fan_bias[band]);
+  TEST_ASSERT_EQUAL_INT(-START_LEARN_FUEL_LIMIT, start_learn.fuel_bias[other]);
+  TEST_ASSERT_EQUAL_INT(START_LEARN_FAN_LIMIT, start_learn.fan_bias[other]);
+
+  start_learn_reset();
+}
+
+// What was learned before a reboot is still there after it
+static void test_start_learn_reload(void)
+{
+  int band = test_learn_band();
+
+  test_learn_begin(0, 0, LEARN_VBAT);
+  test_learn_start(1, true);
+  test_learn_start(1, true);
+
+  test_fram_power_cycle();
+  start_learn.fuel_bias[band] = 0;
+  start_learn.fan_bias[band] = 0;
+  init_start_learn();
+
+  TEST_ASSERT_EQUAL_INT(2 * START_LEARN_FUEL_STEP, start_learn.fuel_bias[band]);
+  TEST_ASSERT_EQUAL_INT(-2 * START_LEARN_FAN_STEP, start_learn.fan_bias[band]);
+
+  start_learn_reset();
+  test_fram_power_cycle();
+}
+
+void run_start_learn_tests(void)
+{
+  RUN_TEST(test_start_learn_cases);
+  RUN_TEST(test_start_learn_step_to_limit);
+  RUN_TEST(test_start_learn_relax);
+  RUN_TEST(test_start_learn_relax_interrupted);
+  RUN_TEST(test_start_learn_applies);
+  RUN_TEST(test_start_learn_load_limits);
+  RUN_TEST(test_start_learn_reload);
+}
@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <string.h>
+#include <native_hal.h>
+#include <canbus_ids.h>
+
+#include "project.h"
+#include "state_stats.h"
+#include "sensor_snapshot.h"
+#include "state_names.h"
+#include "test_native.h"
+
+#define PACK_SATURATED  507904      // state_stats_unpack(0xFF)
+
+// The FRAM byte:  exact up to 31, within 1/32 above that
+static void test_state_stats_pack_error(void)
+{
+  for (uint32_t value = 0; value < 600000; value++) {
+    uint32_t unpacked = state_stats_unpack(state_stats_pack(value));
+    uint32_t error = unpacked > value ? unpacked - value : value - unpacked;
+
+    if (value < 32) {
+      TEST_ASSERT_EQUAL_UINT32(value, unpacked);
+    } else if (value <= PACK_SATURATED + PACK_SATURATED / 32) {
+      TEST_ASSERT_TRUE_MESSAGE(error * 32 <= value, "more than 1/32 off");
+    }
+  }
+}
+
+static void test_state_stats_pack_saturates(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(PACK_SATURATED, state_stats_unpack(0xFF));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, state_stats_pack(PACK_SATURATED));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, state_stats_pack(PACK_SATURATED * 2));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, state_stats_pack(UINT32_MAX));
+}
+
+// Every byte means one value, and packs back to itself
+static void test_state_stats_pack_round_trip(void)
+{
+  uint32_t last = 0;
+
+  for (int packed = 0; packed <= 0xFF; packed++) {
+    uint32_t value = state_stats_unpack(packed);
+
+    TEST_ASSERT_EQUAL_UINT8(packed, state_stats_pack(value));
+    if (packed) {
+      TEST_ASSERT_TRUE_MESSAGE(value > last, "unpack not increasing");
+    }
+    last = value;
+  }
+}
+
+// A flameout's retry through Purging is part of the same start
+static void test_state_stats_start(void)
+{
+  test_firmware_start();
+  sensor_snapshot_publish(CANBUS_ID_EXTERNAL_TEMP, -2000);
+  state_stats_reset();
+  state_stats_transition(WB_STATE_OFF);         // Idle
+
+  int band = start_band(-2000);
+  int standby = state_stats_slot(WB_STATE_PRES);
+
+  TEST_ASSERT_EQUAL_INT(START_BEGIN, state_stats_transition(WB_STATE_PRES));
+  native_clock_advance_us(90 * 1000000ULL);
+  TEST_ASSERT_EQUAL_INT(START_NONE, state_stats_transition(WB_STATE_PURGE));
+  TEST_ASSERT_EQUAL_INT(START_RETRY, state_stats_transition(WB_STATE_PRES));
+  TEST_ASSERT_EQUAL_INT(START_FLAME, state_stats_transition(WB_STATE_PH));
+  TEST_ASSERT_EQUAL_INT(START_NONE, state_stats_transition(WB_STATE_VENT));
+
+  TEST_ASSERT_EQUAL_UINT32(1, start_stats[band].attempts);
+  TEST_ASSERT_EQUAL_UINT32(1, start_stats[band].successes);
+  TEST_ASSERT_EQUAL_UINT32(2, state_stats[standby].entries);
+  TEST_ASSERT_EQUAL_UINT32(90, state_stats[standby].seconds);
+  TEST_ASSERT_EQUAL_UINT32(0, state_stats[standby].abnormal);
+
+  // Given up from Standby, and left abnormally for Lockdown
+  TEST_ASSERT_EQUAL_INT(START_NONE, state_stats_transition(WB_STATE_OFF));
+  TEST_ASSERT_EQUAL_INT(START_BEGIN, state_stats_transition(WB_STATE_PRES));
+  TEST_ASSERT_EQUAL_INT(START_GAVE_UP, state_stats_transition(WB_STATE_LOCK2));
+
+  TEST_ASSERT_EQUAL_UINT32(2, start_stats[band].attempts);
+  TEST_ASSERT_EQUAL_UINT32(1, start_stats[band].successes);
+  TEST_ASSERT_EQUAL_UINT32(1, state_stats[standby].abnormal);
+
+  state_stats_reset();
+}
+
+// What was counted before a reboot is still there after it, to the minute
+static void test_state_stats_reload(void)
+{
+  test_firmware_start();
+  sensor_snapshot_publish(CANBUS_ID_EXTERNAL_TEMP, -2000);
+  state_stats_reset();
+  state_stats_transition(WB_STATE_OFF);         // Idle
+
+  int band = start_band(-2000);
+  int standby = state_stats_slot(WB_STATE_PRES);
+
+  state_stats_transition(WB_STATE_PRES);
+  native_clock_advance_us(10 * 60 * 1000000ULL);
+  state_stats_transition(WB_STATE_PH);
+
+  test_fram_power_cycle();
+  memset(state_stats, 0x00, sizeof(state_stats));
+  memset(start_stats, 0x00, sizeof(start_stats));
+  init_state_stats();
+
+  TEST_ASSERT_EQUAL_UINT32(1, start_stats[band].attempts);
+  TEST_ASSERT_EQUAL_UINT32(1, start_stats[band].successes);
+  TEST_ASSERT_EQUAL_UINT32(1, state_stats[standby].entries);
+  TEST_ASSERT_EQUAL_UINT32(600, state_stats[standby].seconds);
+
+  state_stats_reset();
+  test_fram_power_cycle();
+}
+
+void run_state_stats_tests(void)
+{
+  RUN_TEST(test_state_stats_pack_error);
+  RUN_TEST(test_state_stats_pack_saturates);
+  RUN_TEST(test_state_stats_pack_round_trip);
+  RUN_TEST(test_state_stats_start);
+  RUN_TEST(test_state_stats_reload);
+}
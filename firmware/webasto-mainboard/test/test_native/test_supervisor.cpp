@@ -0,0 +1,103 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "project.h"
+#include "supervisor.h"
+#include "state_names.h"
+#include "test_native.h"
+
+// Both cores' passes on the manual clock, core0 every 100ms.  Each test
+// ends in a pretend watchdog reset, which puts every pin back to an input:
+// run these last.
+
+#define TEST_CORE0_PASS_MS  100
+
+static void test_supervisor_pass(int core)
+{
+  native_set_core_num(core);
+  supervisor_beat();
+  supervisor_check();
+  if (core == 1) {
+    supervisor_sleep(CORE1_MAX_SLEEP_MS);
+  }
+  native_set_core_num(1);
+}
+
+static inline bool test_supervisor_tripped(void)
+{
+  return native_digital_output(PIN_FUEL_PUMP) == LOW && native_analog_output(PIN_COMBUSTION_FAN) == 255;
+}
+
+static void test_supervisor_begin(uint8_t state)
+{
+  test_firmware_start();
+  supervisor_start();
+  supervisor_note_state(state);
+  test_supervisor_pass(0);
+  test_supervisor_pass(1);
+}
+
+static void test_supervisor_core1_asleep(void)
+{
+  test_supervisor_begin(WB_STATE_OFF);
+
+  // Asleep the whole CORE1_MAX_SLEEP_MS is not a stall
+  for (int ms = 0; ms < CORE1_MAX_SLEEP_MS + SUPERVISOR_STALL_MS - TEST_CORE0_PASS_MS; ms += TEST_CORE0_PASS_MS) {
+    native_clock_advance_us(TEST_CORE0_PASS_MS * 1000);
+    test_supervisor_pass(0);
+    TEST_ASSERT_FALSE(test_supervisor_tripped());
+    TEST_ASSERT_FALSE(native_watchdog_expired());
+  }
+
+  // Overdue by SUPERVISOR_STALL_MS is
+  native_clock_advance_us(TEST_CORE0_PASS_MS * 1000);
+  test_supervisor_pass(0);
+  TEST_ASSERT_TRUE(test_supervisor_tripped());
+  TEST_ASSERT_FALSE(native_watchdog_expired());
+
+  native_clock_advance_us(SUPERVISOR_WATCHDOG_MS * 1000);
+  TEST_ASSERT_TRUE(native_watchdog_expired());
+
+  native_watchdog_reboot();
+  supervisor_boot();
+  TEST_ASSERT_TRUE(supervisor_reset.valid);
+  TEST_ASSERT_EQUAL_HEX8(0x02, supervisor_reset.stalled);
+  TEST_ASSERT_GREATER_OR_EQUAL(SUPERVISOR_STALL_MS, supervisor_reset.stall_ms);
+  TEST_ASSERT_LESS_THAN(SUPERVISOR_STALL_MS + TEST_CORE0_PASS_MS, supervisor_reset.stall_ms);
+  TEST_ASSERT_FALSE(supervisor_reset.purge);
+}
+
+static void test_supervisor_core0_stalled(void)
+{
+  test_supervisor_begin(WB_STATE_PH);
+
+  // Nothing nudges core1 now, it sleeps its full time and still gets there
+  // before the watchdog
+  native_clock_advance_us(CORE1_MAX_SLEEP_MS * 1000);
+  TEST_ASSERT_FALSE(native_watchdog_expired());
+  test_supervisor_pass(1);
+  TEST_ASSERT_TRUE(test_supervisor_tripped());
+
+  native_clock_advance_us(SUPERVISOR_WATCHDOG_MS * 1000);
+  TEST_ASSERT_TRUE(native_watchdog_expired());
+
+  // Burning when it went:  the purge starts with the fuel pump driven low
+  native_watchdog_reboot();
+  TEST_ASSERT_FALSE(native_pin_is_output(PIN_FUEL_PUMP));
+  supervisor_boot();
+  TEST_ASSERT_TRUE(supervisor_reset.valid);
+  TEST_ASSERT_EQUAL_HEX8(0x01, supervisor_reset.stalled);
+  TEST_ASSERT_EQUAL_INT(CORE1_MAX_SLEEP_MS, supervisor_reset.stall_ms);
+  TEST_ASSERT_EQUAL_HEX8(WB_STATE_PH, supervisor_reset.fsm_state);
+  TEST_ASSERT_TRUE(supervisor_reset.purge);
+  TEST_ASSERT_TRUE(native_pin_is_output(PIN_FUEL_PUMP));
+  TEST_ASSERT_EQUAL_INT(LOW, native_digital_output(PIN_FUEL_PUMP));
+  TEST_ASSERT_TRUE(native_pin_is_output(PIN_COMBUSTION_FAN));
+  TEST_ASSERT_EQUAL_INT(HIGH, native_digital_output(PIN_COMBUSTION_FAN));
+}
+
+void run_supervisor_tests(void)
+{
+  RUN_TEST(test_supervisor_core1_asleep);
+  RUN_TEST(test_supervisor_core0_stalled);
+}
@@ -0,0 +1,178 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <string.h>
+
+#include "fram.h"
+#include "fuel_pump.h"
+#include "throttle_map.h"
+#include "test_native.h"
+
+// Against the built-in map (throttle_map.cpp):
+//
+//   coolant     50C       60C       70C      75C
+//   -20C      90/180    65/130    55/83    30/60
+//    10C      90/180    65/130    55/83    30/60
+//    20C      90/160    65/130    55/83    30/60
+
+typedef struct {
+  int coolant_temp;
+  int outdoor_temp;
+  int fan;
+  int fuel;
+} throttle_case_t;
+
+static const throttle_case_t throttle_cases[] = {
+  // On the points
+  {  5000, -2000, 90, 180 },
+  {  6000,  1000, 65, 130 },
+  {  7000,  2000, 55,  83 },
+  {  7500, -2000, 30,  60 },
+  {  5000,  2000, 90, 160 },
+
+  // Along the coolant axis (truncated towards the first point)
+  {  5500, -2000, 78, 155 },
+  {  7250,  1000, 43,  72 },
+  {  7499,  1000, 31,  61 },
+
+  // Along the outdoor axis
+  {  5000,  1500, 90, 170 },
+  {  5000,  1999, 90, 161 },
+  {  5250,  1500, 84, 161 },
+
+  // Held flat past the ends of both axes
+  {  2000,  1500, 90, 170 },
+  { -4000, -4000, 90, 180 },
+  {  9000,  1500, 30,  60 },
+  { 12000,  4000, 30,  60 },
+  {  5000,  4000, 90, 160 },
+  { INT16_MIN, INT16_MAX, 90, 160 },
+  { INT16_MAX, INT16_MIN, 30,  60 },
+};
+
+static void test_throttle_map_builtin(void)
+{
+  test_firmware_start();
+  fram_data.current.throttle_map.valid = 0;
+  throttle_map_load();
+}
+
+static void test_throttle_map_interpolation(void)
+{
+  test_throttle_map_builtin();
+
+  for (const throttle_case_t &c : throttle_cases) {
+    char message[48];
+    snprintf(message, sizeof(message), "coolant %d, outdoor %d", c.coolant_temp, c.outdoor_temp);
+
+    throttle_point_t point = throttle_map_lookup(c.coolant_temp, c.outdoor_temp);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.fan, point.fan, message);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c.fuel, point.fuel, message);
+  }
+}
+
+static void test_throttle_map_idle_full(void)
+{
+  test_throttle_map_builtin();
+
+  throttle_point_t idle = throttle_map_idle(1500);
+  throttle_point_t full = throttle_map_full(1500);
+  TEST_ASSERT_EQUAL_INT(30, idle.fan);
+  TEST_ASSERT_EQUAL_INT(60, idle.fuel);
+  TEST_ASSERT_EQUAL_INT(90, full.fan);
+  TEST_ASSERT_EQUAL_INT(170, full.fuel);
+
+  // Fan on the idle -> full line, clamped at both ends
+  static const int fan_cases[][2] = {
+    {   0, 30 },
+    {  60, 30 },
+    { 115, 60 },
+    { 170, 90 },
+    { 246, 90 },
+  };
+  for (const int *c : fan_cases) {
+    TEST_ASSERT_EQUAL_INT_MESSAGE(c[1], throttle_map_fan(c[0], 1500), "fuel");
+  }
+}
+
+static void test_throttle_map_stored(void)
+{
+  throttle_map_t *stored = &fram_data.current.throttle_map;
+
+  test_throttle_map_builtin();
+
+  // A flat map of its own
+  memset(stored, 0x00, sizeof(*stored));
+  stored->valid = THROTTLE_MAP_VALID;
+  for (int i = 0; i < THROTTLE_COOLANT_POINTS; i++) {
+    stored->coolant_c[i] = 40 + i * 10;
+  }
+  for (int i = 0; i < THROTTLE_OUTDOOR_POINTS; i++) {
+    stored->outdoor_c[i] = -10 + i * 10;
+    for (int j = 0; j < THROTTLE_COOLANT_POINTS; j++) {
+      stored->points[i][j].fan = 50;
+      stored->points[i][j].fuel = 100;
+    }
+  }
+  TEST_ASSERT_TRUE(throttle_map_check(stored));
+  throttle_map_load();
+  TEST_ASSERT_EQUAL_INT(50, throttle_map_lookup(5500, 0).fan);
+  TEST_ASSERT_EQUAL_INT(100, throttle_map_lookup(5500, 0).fuel);
+
+  // Anything throttle_map_check() refuses falls back to the built-in map
+  stored->coolant_c[2] = stored->coolant_c[1];
+  TEST_ASSERT_FALSE(throttle_map_check(stored));
+  throttle_map_load();
+  TEST_ASSERT_EQUAL_INT(78, throttle_map_lookup(5500, -2000).fan);
+
+  stored->coolant_c[2] = 60;
+  stored->points[1][1].fan = 101;
+  TEST_ASSERT_FALSE(throttle_map_check(stored));
+  stored->points[1][1].fan = 50;
+  stored->points[2][3].fuel = MIN_FUEL_NEED - 1;
+  TEST_ASSERT_FALSE(throttle_map_check(stored));
+
+  stored->valid = 0;
+  throttle_map_load();
+}
+
+// An override written the way W-Bus writes it is still there after a reboot
+static void test_throttle_map_reload(void)
+{
+  throttle_map_t map;
+  int offset = (uint8_t *)&fram_data.current.throttle_map - (uint8_t *)&fram_data;
+
+  test_throttle_map_builtin();
+
+  map = fram_data.current.throttle_map;
+  map.valid = THROTTLE_MAP_VALID;
+  for (int i = 0; i < THROTTLE_COOLANT_POINTS; i++) {
+    map.coolant_c[i] = 40 + i * 10;
+  }
+  for (int i = 0; i < THROTTLE_OUTDOOR_POINTS; i++) {
+    map.outdoor_c[i] = -10 + i * 10;
+    for (int j = 0; j < THROTTLE_COOLANT_POINTS; j++) {
+      map.points[i][j].fan = 50;
+      map.points[i][j].fuel = 100;
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(sizeof(map), write_to_fram((uint8_t *)&map, sizeof(map), offset));
+
+  test_fram_power_cycle();
+  TEST_ASSERT_EQUAL_MEMORY(&map, &fram_data.current.throttle_map, sizeof(map));
+  throttle_map_load();
+  TEST_ASSERT_EQUAL_INT(50, throttle_map_lookup(5500, 0).fan);
+  TEST_ASSERT_EQUAL_INT(100, throttle_map_lookup(5500, 0).fuel);
+
+  map.valid = 0;
+  write_to_fram((uint8_t *)&map, sizeof(map), offset);
+  test_fram_power_cycle();
+  throttle_map_load();
+}
+
+void run_throttle_map_tests(void)
+{
+  RUN_TEST(test_throttle_map_interpolation);
+  RUN_TEST(test_throttle_map_idle_full);
+  RUN_TEST(test_throttle_map_stored);
+  RUN_TEST(test_throttle_map_reload);
+}
@@ -0,0 +1,185 @@
+#include <unity.h>
+#include <native_hal.h>
+
+#include "global_timer.h"
+#include "monotonic.h"
+#include "test_native.h"
+
+// A fresh GlobalTimer per test, never begin()'d:  no alarm pool, so only
+// tick() moves it on, once the test has advanced the clock.
+
+#define TEST_TIMER_MAX_CALLS  8
+
+static int timer_calls;
+static int timer_ids[TEST_TIMER_MAX_CALLS];
+static uint64_t timer_times_us[TEST_TIMER_MAX_CALLS];
+
+static void test_timer_callback(int timer_id, int delay_ms)
+{
+  (void)delay_ms;
+
+  if (timer_calls < TEST_TIMER_MAX_CALLS) {
+    timer_ids[timer_calls] = timer_id;
+    timer_times_us[timer_calls] = monotonic_us() - TEST_CLOCK_START_US;
+  }
+  timer_calls++;
+}
+
+static GlobalTimer *test_timer_new(void)
+{
+  timer_calls = 0;
+  return new GlobalTimer();
+}
+
+static void test_timer_advance_ms(GlobalTimer *timer, int ms)
+{
+  native_clock_advance_us((uint64_t)ms * 1000);
+  timer->tick();
+}
+
+static void test_timer_fires_at_deadline(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  TEST_ASSERT_NOT_EQUAL(TIMER_HANDLE_NONE, timer->register_timer(TIMER_BEEPER, 50, test_timer_callback));
+
+  test_timer_advance_ms(timer, 49);
+  TEST_ASSERT_EQUAL_INT(0, timer_calls);
+  TEST_ASSERT_EQUAL_INT(1, timer->get_remaining_time(TIMER_BEEPER));
+
+  test_timer_advance_ms(timer, 1);
+  TEST_ASSERT_EQUAL_INT(1, timer_calls);
+  TEST_ASSERT_EQUAL_INT(TIMER_BEEPER, timer_ids[0]);
+  TEST_ASSERT_EQUAL_UINT64(50000, timer_times_us[0]);
+
+  // One-shot:  gone once it has fired
+  test_timer_advance_ms(timer, 1000);
+  TEST_ASSERT_EQUAL_INT(1, timer_calls);
+  TEST_ASSERT_EQUAL_INT(0, timer->get_remaining_time(TIMER_BEEPER));
+
+  delete timer;
+}
+
+static void test_timer_periodic_rearms(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  timer->register_periodic_timer(TIMER_BEEPER, 10, 20, test_timer_callback);
+
+  for (int i = 0; i < 60; i++) {
+    test_timer_advance_ms(timer, 1);
+  }
+
+  TEST_ASSERT_EQUAL_INT(3, timer_calls);
+  TEST_ASSERT_EQUAL_UINT64(10000, timer_times_us[0]);
+  TEST_ASSERT_EQUAL_UINT64(30000, timer_times_us[1]);
+  TEST_ASSERT_EQUAL_UINT64(50000, timer_times_us[2]);
+
+  delete timer;
+}
+
+static void test_timer_cancel(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  timer_handle_t handle = timer->register_timer(TIMER_BEEPER, 50, test_timer_callback);
+  timer->register_timer(TIMER_BEEPER_OFF, 50, test_timer_callback);
+  timer->register_timer(TIMER_BEEPER_OFF, 60, test_timer_callback);
+
+  TEST_ASSERT_TRUE(timer->cancel_timer(handle));
+  TEST_ASSERT_FALSE(timer->cancel_timer(handle));     // stale handle
+  TEST_ASSERT_EQUAL_INT(2, timer->cancel_timer_id(TIMER_BEEPER_OFF));
+
+  test_timer_advance_ms(timer, 100);
+  TEST_ASSERT_EQUAL_INT(0, timer_calls);
+
+  delete timer;
+}
+
+static void test_timer_equal_deadlines_in_order(void)
+{
+  GlobalTimer *timer = test_timer_new();
+  static const int ids[] = { TIMER_BEEPER_GAP, TIMER_BEEPER, TIMER_FUEL_PUMP, TIMER_BEEPER_OFF };
+
+  for (int i = 0; i < 4; i++) {
+    timer->register_timer(ids[i], 20, test_timer_callback);
+  }
+  timer->register_timer(TIMER_STAGE_RETRY, 10, test_timer_callback);
+
+  test_timer_advance_ms(timer, 20);
+  TEST_ASSERT_EQUAL_INT(5, timer_calls);
+  TEST_ASSERT_EQUAL_INT(TIMER_STAGE_RETRY, timer_ids[0]);
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL_INT(ids[i], timer_ids[i + 1]);
+  }
+
+  delete timer;
+}
+
+static void test_timer_reschedule_and_replace(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  timer_handle_t handle = timer->register_timer(TIMER_BEEPER, 50, test_timer_callback);
+  TEST_ASSERT_TRUE(timer->reschedule_timer(handle, 80));
+
+  // replace drops the first TIMER_STAGE_COMPLETE
+  timer->register_timer(TIMER_STAGE_COMPLETE, 30, test_timer_callback);
+  timer->register_timer(TIMER_STAGE_COMPLETE, 40, test_timer_callback, true);
+
+  test_timer_advance_ms(timer, 50);
+  TEST_ASSERT_EQUAL_INT(1, timer_calls);
+  TEST_ASSERT_EQUAL_INT(TIMER_STAGE_COMPLETE, timer_ids[0]);
+
+  test_timer_advance_ms(timer, 30);
+  TEST_ASSERT_EQUAL_INT(2, timer_calls);
+  TEST_ASSERT_EQUAL_INT(TIMER_BEEPER, timer_ids[1]);
+  TEST_ASSERT_EQUAL_UINT64(80000, timer_times_us[1]);
+
+  delete timer;
+}
+
+static void test_timer_wait_advances_clock(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  // Nothing registered:  sleeps the whole max_ms
+  timer->wait(100);
+  TEST_ASSERT_EQUAL_UINT64(TEST_CLOCK_START_US + 100000, monotonic_us());
+
+  // Never past the head of the heap
+  timer->register_timer(TIMER_BEEPER, 30, test_timer_callback);
+  timer->wait(1000);
+  TEST_ASSERT_EQUAL_UINT64(TEST_CLOCK_START_US + 130000, monotonic_us());
+
+  timer->tick();
+  TEST_ASSERT_EQUAL_INT(1, timer_calls);
+
+  delete timer;
+}
+
+static void test_timer_pool_exhausted(void)
+{
+  GlobalTimer *timer = test_timer_new();
+
+  for (int i = 0; i < GLOBAL_TIMER_POOL_SIZE; i++) {
+    TEST_ASSERT_NOT_EQUAL(TIMER_HANDLE_NONE, timer->register_timer(TIMER_BEEPER, 10 + i, test_timer_callback));
+  }
+  TEST_ASSERT_EQUAL(TIMER_HANDLE_NONE, timer->register_timer(TIMER_BEEPER, 10, test_timer_callback));
+
+  test_timer_advance_ms(timer, 10 + GLOBAL_TIMER_POOL_SIZE);
+  TEST_ASSERT_EQUAL_INT(GLOBAL_TIMER_POOL_SIZE, timer_calls);
+
+  delete timer;
+}
+
+void run_timer_tests(void)
+{
+  RUN_TEST(test_timer_fires_at_deadline);
+  RUN_TEST(test_timer_periodic_rearms);
+  RUN_TEST(test_timer_cancel);
+  RUN_TEST(test_timer_equal_deadlines_in_order);
+  RUN_TEST(test_timer_reschedule_and_replace);
+  RUN_TEST(test_timer_wait_advances_clock);
+  RUN_TEST(test_timer_pool_exhausted);
+}
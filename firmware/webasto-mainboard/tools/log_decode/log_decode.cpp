@@ -0,0 +1,388 @@
+// Host decoder for LOG_TOKENIZED builds.  Reads the COBS framed binary log
+// from a capture file (or stdin, e.g. straight from the serial port) and
+// prints it as text, using the token table scripts/log_tokens.py wrote at
+// build time (.pio/build/<env>/log_tokens.txt).
+//
+//   log_decode <log_tokens.txt> [capture]
+//
+// The frame layout is described in src/async_log.h.  Build with
+// "pio run -e log_decode", or any C++17 compiler.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+enum {
+  LOG_ARG_INT,
+  LOG_ARG_FLOAT,
+  LOG_ARG_STRING,
+};
+
+typedef struct {
+  int level;
+  std::string where;
+  std::string format;
+} logToken_t;
+
+typedef struct {
+  int type;
+  int32_t i;
+  float f;
+  std::string str;
+} logArg_t;
+
+static const char level_chars[] = "SFEWNTV";
+
+static std::map<uint32_t, logToken_t> tokens;
+
+static std::string unescape(const std::string &text)
+{
+  std::string out;
+
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != '\\' || i + 1 >= text.size()) {
+      out += text[i];
+      continue;
+    }
+
+    char ch = text[++i];
+    switch (ch) {
+      case 'n':
+        out += '\n';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case '0':
+        out += '\0';
+        break;
+      case 'x':
+        {
+          size_t len = 0;
+          out += (char)std::stoi(text.substr(i + 1), &len, 16);
+          i += len;
+        }
+        break;
+      default:
+        out += ch;
+        break;
+    }
+  }
+
+  return out;
+}
+
+static bool load_tokens(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    perror(filename);
+    return false;
+  }
+
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char *fields[4];
+    char *p = line;
+    int count;
+    for (count = 0; count < 4 && p; count++) {
+      fields[count] = p;
+      p = count < 3 ? strchr(p, '\t') : 0;
+      if (p) {
+        *p++ = '\0';
+      }
+    }
+
+    if (count != 4) {
+      continue;
+    }
+
+    logToken_t token = { atoi(fields[1]), fields[2], unescape(fields[3]) };
+    tokens[strtoul(fields[0], 0, 16)] = token;
+  }
+
+  fclose(f);
+  return true;
+}
+
+static bool cobs_decode(const std::vector<uint8_t> &in, std::vector<uint8_t> &out)
+{
+  out.clear();
+
+  size_t i = 0;
+  while (i < in.size()) {
+    uint8_t code = in[i++];
+    if (!code || i + code - 1 > in.size()) {
+      return false;
+    }
+
+    out.insert(out.end(), in.begin() + i, in.begin() + i + code - 1);
+    i += code - 1;
+
+    if (code != 0xFF && i < in.size()) {
+      out.push_back(0);
+    }
+  }
+
+  return true;
+}
+
+class FrameReader {
+  public:
+    FrameReader(const std::vector<uint8_t> &frame) : _frame(frame), _pos(0), _ok(true) { };
+
+    bool ok(void) { return _ok; };
+    size_t remaining(void) { return _pos < _frame.size() ? _frame.size() - _pos : 0; };
+
+    uint8_t u8(void)
+    {
+      if (!remaining()) {
+        _ok = false;
+        return 0;
+      }
+      return _frame[_pos++];
+    };
+
+    uint32_t u32(void)
+    {
+      uint32_t value = 0;
+      for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)u8() << (8 * i);
+      }
+      return value;
+    };
+
+    uint32_t varint(void)
+    {
+      uint32_t value = 0;
+      for (int shift = 0; shift < 35 && _ok; shift += 7) {
+        uint8_t byte = u8();
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+          break;
+        }
+      }
+      return value;
+    };
+
+    std::string bytes(size_t len)
+    {
+      if (len > remaining()) {
+        _ok = false;
+        return "";
+      }
+      std::string value((const char *)&_frame[_pos], len);
+      _pos += len;
+      return value;
+    };
+
+  private:
+    const std::vector<uint8_t> &_frame;
+    size_t _pos;
+    bool _ok;
+};
+
+// Same rules as AsyncLog::format_record() in the text build
+static std::string format_message(const std::string &format, const std::vector<logArg_t> &args)
+{
+  std::string out;
+  size_t arg = 0;
+  char buf[256];
+
+  for (size_t p = 0; p < format.size(); p++) {
+    if (format[p] != '%') {
+      out += format[p];
+      continue;
+    }
+
+    if (p + 1 < format.size() && format[p + 1] == '%') {
+      out += '%';
+      p++;
+      continue;
+    }
+
+    std::string spec = "%";
+    size_t q = p + 1;
+    while (q < format.size() && strchr("-+ #0123456789.", format[q])) {
+      spec += format[q++];
+    }
+
+    while (q < format.size() && strchr("hlLqjzt", format[q])) {
+      q++;
+    }
+
+    if (q >= format.size()) {
+      break;
+    }
+
+    char conv = format[q];
+    spec += conv;
+    p = q;
+
+    bool is_float = strchr("fFeEgGaA", conv);
+    bool is_string = (conv == 's');
+
+    if (arg >= args.size()) {
+      out += '?';
+      continue;
+    }
+
+    const logArg_t &a = args[arg++];
+    switch (a.type) {
+      case LOG_ARG_FLOAT:
+        if (is_float) {
+          snprintf(buf, sizeof(buf), spec.c_str(), (double)a.f);
+        } else {
+          snprintf(buf, sizeof(buf), "%d", (int)a.f);
+        }
+        break;
+      case LOG_ARG_STRING:
+        snprintf(buf, sizeof(buf), is_string ? spec.c_str() : "%s", a.str.c_str());
+        break;
+      case LOG_ARG_INT:
+      default:
+        if (is_float) {
+          snprintf(buf, sizeof(buf), spec.c_str(), (double)a.i);
+        } else if (is_string) {
+          snprintf(buf, sizeof(buf), "%d", (int)a.i);
+        } else {
+          snprintf(buf, sizeof(buf), spec.c_str(), a.i);
+        }
+        break;
+    }
+    out += buf;
+  }
+
+  return out;
+}
+
+static void decode_frame(const std::vector<uint8_t> &frame)
+{
+  FrameReader reader(frame);
+
+  uint8_t header = reader.u8();
+  uint32_t token = reader.u32();
+  int level = header & 0x07;
+  int count = header >> 3;
+
+  if (!reader.ok() || level > 6) {
+    printf("?: <bad frame, %d bytes>\n", (int)frame.size());
+    return;
+  }
+
+  if (!token) {
+    uint32_t offset = reader.varint();
+    std::string data = reader.bytes(reader.remaining());
+
+    for (size_t i = 0; i < data.size(); i += 16) {
+      printf("%c: %04X:", level_chars[level], (unsigned)(offset + i));
+      for (size_t j = i; j < i + 16 && j < data.size(); j++) {
+        printf(" %02X", (uint8_t)data[j]);
+      }
+      printf("\n");
+    }
+    return;
+  }
+
+  std::vector<logArg_t> args(count);
+  for (int i = 0; i < count; i += 4) {
+    uint8_t types = reader.u8();
+    for (int j = i; j < i + 4 && j < count; j++) {
+      args[j].type = (types >> (2 * (j - i))) & 0x03;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    switch (args[i].type) {
+      case LOG_ARG_FLOAT:
+        {
+          uint32_t bits = reader.u32();
+          memcpy(&args[i].f, &bits, sizeof(bits));
+        }
+        break;
+      case LOG_ARG_STRING:
+        args[i].str = reader.bytes(reader.varint());
+        break;
+      case LOG_ARG_INT:
+      default:
+        {
+          uint32_t value = reader.varint();
+          args[i].i = (int32_t)((value >> 1) ^ -(value & 1));
+        }
+        break;
+    }
+  }
+
+  if (!reader.ok()) {
+    printf("%c: <truncated frame, token %08X>\n", level_chars[level], token);
+    return;
+  }
+
+  auto it = tokens.find(token);
+  if (it == tokens.end()) {
+    printf("%c: <unknown token %08X, %d args>\n", level_chars[level], token, count);
+    return;
+  }
+
+  printf("%c: %s\n", level_chars[level], format_message(it->second.format, args).c_str());
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s <log_tokens.txt> [capture]\n", argv[0]);
+    return 1;
+  }
+
+  if (!load_tokens(argv[1])) {
+    return 1;
+  }
+
+  FILE *in = stdin;
+  if (argc == 3) {
+    in = fopen(argv[2], "rb");
+    if (!in) {
+      perror(argv[2]);
+      return 1;
+    }
+  }
+
+  // If the capture started in the middle of a frame, the first one comes
+  // out as garbage, and everything after the first delimiter is fine.
+  std::vector<uint8_t> encoded;
+  std::vector<uint8_t> frame;
+  int ch;
+
+  while ((ch = fgetc(in)) != EOF) {
+    if (ch) {
+      encoded.push_back(ch);
+      continue;
+    }
+
+    if (!encoded.empty()) {
+      if (cobs_decode(encoded, frame)) {
+        decode_frame(frame);
+      } else {
+        printf("?: <bad COBS frame, %d bytes>\n", (int)encoded.size());
+      }
+      fflush(stdout);
+    }
+
+    encoded.clear();
+  }
+
+  if (in != stdin) {
+    fclose(in);
+  }
+  return 0;
+}